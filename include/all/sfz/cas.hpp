@@ -0,0 +1,110 @@
+// Copyright (c) 2026 The libsfz Authors
+//
+// This file is part of libsfz, a free software project.  You can redistribute it and/or modify it
+// under the terms of the MIT License.
+
+#ifndef SFZ_CAS_HPP_
+#define SFZ_CAS_HPP_
+
+#include <memory>
+#include <pn/data>
+#include <pn/string>
+#include <sfz/digest.hpp>
+#include <unordered_set>
+#include <vector>
+
+namespace sfz {
+
+class mapped_file;
+
+// How files checked out of a cas_store share storage with the store.
+//
+// CAS_HARDLINK is cheapest, but the resulting file *is* the object in the store, so it must not be
+// modified in place.  If hard-linking isn't possible (e.g. across filesystems), CAS_CLONE is used
+// instead.  CAS_CLONE creates a copy-on-write clone where the filesystem supports it, and
+// otherwise falls back to CAS_COPY.
+enum CasLinkType { CAS_HARDLINK, CAS_CLONE, CAS_COPY };
+
+// A content-addressable store of files, keyed by SHA-1 digest.
+//
+// Objects are stored under `root`/objects, fanned out into subdirectories named after the first
+// byte of their digest, so that "objects/da/39a3ee…" holds content with digest "da39a3ee…".
+// Identical content is stored only once.
+//
+// Trees are stored as manifest objects, which list the relative path and digest of each file in
+// the tree.  The manifest's digest identifies the tree.
+//
+// To find out whether an object is present without touching the filesystem, the store keeps a
+// sorted index of digests in `root`/index, which is mapped into memory rather than read, so
+// that opening a large store is cheap.  Objects added since the index was last written are kept
+// in memory until flush() is called.
+class cas_store {
+  public:
+    // Opens the store at `root`, creating it if necessary.
+    explicit cas_store(pn::string_view root);
+    cas_store(const cas_store&) = delete;
+    ~cas_store();
+
+    const pn::string& root() const { return _root; }
+
+    // @returns             The path at which the object with the given digest is (or would be)
+    //                      stored.
+    pn::string object_path(const sha1::digest& digest) const;
+
+    // @returns             true iff the store contains an object with the given digest.
+    bool contains(const sha1::digest& digest) const;
+
+    // Adds data, the regular file at `path`, or the tree at `path` to the store.  If the store
+    // already contains identical content, then nothing is copied.  Files are added using a
+    // copy-on-write clone where the filesystem supports it.
+    //
+    // @returns             The digest of the data or file, or of the tree's manifest.
+    sha1::digest add(pn::data_view data);
+    sha1::digest add_file(pn::string_view path);
+    sha1::digest add_tree(pn::string_view path);
+
+    // Materializes the object with digest `digest` as a file at `path`, or the tree with manifest
+    // `manifest` as a tree at `path`.  Throws if an object is missing, or if `path` exists.
+    void checkout_file(
+            const sha1::digest& digest, pn::string_view path, CasLinkType type = CAS_CLONE) const;
+    void checkout_tree(
+            const sha1::digest& manifest, pn::string_view path,
+            CasLinkType type = CAS_CLONE) const;
+
+    // Writes objects added since the store was opened to the index.
+    void flush();
+
+    // Rebuilds the index by scanning the objects directory.  This is only necessary if objects
+    // were added by some other means, or if the index was lost.
+    void reindex();
+
+  private:
+    struct key {
+        uint8_t bytes[20];
+        bool    operator<(const key& other) const;
+        bool    operator==(const key& other) const;
+    };
+    struct key_hash {
+        size_t operator()(const key& k) const;
+    };
+
+    static key key_for(const sha1::digest& digest);
+    bool       indexed(const key& k) const;
+    void       write_index(const std::vector<key>& keys);
+    void       load_index();
+
+    // Moves the file at `tmp` into the store as `digest`, unless it is already present.
+    void insert(pn::string_view tmp, const sha1::digest& digest);
+
+    // Returns a fresh path in the store's temporary directory.
+    pn::string tmp_path();
+
+    const pn::string                  _root;
+    std::unique_ptr<mapped_file>      _index;
+    std::unordered_set<key, key_hash> _pending;
+    uint64_t                          _tmp_count;
+};
+
+}  // namespace sfz
+
+#endif  // SFZ_CAS_HPP_
@@ -0,0 +1,78 @@
+// Copyright (c) 2026 The libsfz Authors
+//
+// This file is part of libsfz, a free software project.  You can redistribute it and/or modify it
+// under the terms of the MIT License.
+
+#ifndef SFZ_DELTA_HPP_
+#define SFZ_DELTA_HPP_
+
+#include <stdint.h>
+#include <pn/data>
+#include <pn/string>
+#include <sfz/digest.hpp>
+#include <vector>
+
+namespace sfz {
+
+// Binary deltas between two versions of some data, in the manner of rsync.
+//
+// The basis (old) version is split into fixed-size blocks, and a signature is computed from it,
+// recording a weak rolling checksum and a SHA-1 digest of each block.  The signature alone is
+// sufficient to compute a delta to the target (new) version: the target is scanned with the
+// rolling checksum, and every window whose checksum and digest both match a block of the basis is
+// replaced with a reference to that block.  Any remaining data is included literally.  The delta
+// can then be applied to the basis to reconstruct the target.
+//
+// Signature generation and the scan of the target are both split across threads.
+
+// The default size of a block, in bytes.
+extern const int kDeltaBlockSize;
+
+struct delta_signature {
+    struct block {
+        uint32_t     weak;
+        sha1::digest strong;
+    };
+
+    delta_signature() : block_size{kDeltaBlockSize}, size{0} {}
+    // Deserializes a signature previously serialized by data().
+    explicit delta_signature(pn::data_view data);
+
+    pn::data data() const;
+
+    // The size of each block, and of the basis.  If the size of the basis is not a multiple of
+    // the block size, then the final block is shorter than the others, and only matches the end
+    // of the target.
+    int                block_size;
+    uint64_t           size;
+    std::vector<block> blocks;
+};
+
+// Computes the signature of `basis`.
+delta_signature signature(pn::data_view basis, int block_size = kDeltaBlockSize);
+
+// Computes a delta which transforms the data with signature `basis` into `target`.
+pn::data delta(const delta_signature& basis, pn::data_view target);
+
+// Applies `delta` to `basis`.  Throws if the delta is malformed or does not apply to `basis`.
+//
+// @returns             The target data from which `delta` was computed.
+pn::data patch(pn::data_view basis, pn::data_view delta);
+
+// Equivalents of the above for regular files, which are read through mapped_file.
+delta_signature file_signature(pn::string_view path, int block_size = kDeltaBlockSize);
+pn::data        file_delta(const delta_signature& basis, pn::string_view target_path);
+pn::data        file_delta(pn::string_view basis_path, pn::string_view target_path);
+void patch_file(pn::string_view basis_path, pn::data_view delta, pn::string_view output_path);
+
+// Computes a delta between two trees of regular files.  For each file in `target_path`, the file
+// at the same relative path in `basis_path` (if any) is used as its basis.
+pn::data tree_delta(pn::string_view basis_path, pn::string_view target_path);
+
+// Applies a delta computed by tree_delta() to the tree at `basis_path`, writing the resulting
+// tree to `output_path`, which must not be within `basis_path`.
+void patch_tree(pn::string_view basis_path, pn::data_view delta, pn::string_view output_path);
+
+}  // namespace sfz
+
+#endif  // SFZ_DELTA_HPP_
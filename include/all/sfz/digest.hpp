@@ -8,9 +8,11 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <chrono>
 #include <pn/data>
 #include <pn/output>
 #include <pn/string>
+#include <vector>
 
 namespace sfz {
 
@@ -59,6 +61,14 @@ class sha1 {
     // digest reused.
     digest compute() const;
 
+    // Returns the state derived from previous calls to write(), in a form that can be stored and
+    // passed to restore() later, e.g. to continue hashing in another process.
+    pn::data save() const;
+
+    // Replaces the current state with one returned by save().  Throws if `state` is invalid.
+    // @param [in] state    The result of an earlier call to save().
+    void restore(pn::data_view state);
+
   private:
     // Finishes computation of the digest of the current contents.  After this method is called, it
     // is no longer valid to call update().  The implementation of digest() therefore copies *this
@@ -90,12 +100,161 @@ class sha1 {
 bool operator==(const sha1::digest& lhs, const sha1::digest& rhs);
 bool operator!=(const sha1::digest& lhs, const sha1::digest& rhs);
 
+// Computes the CRC-32C (Castagnoli) checksum of some sequence of bytes.
+//
+// Unlike sha1, this is not a cryptographic hash: it detects accidental corruption, not tampering.
+// Where the CPU supports it, the checksum is computed with the SSE4.2 or ARMv8 CRC32
+// instructions, interleaving three independent streams to hide their latency.
+class crc32c {
+  public:
+    // Creates an instance in initial state.  Calling compute() on a default-initialized object
+    // will result in the checksum of 0 bytes of data.
+    crc32c();
+
+    // Resets the object to its initial state, as if write() had never been called.
+    void reset();
+
+    // Adds data in `input` to the current content.  It is more efficient, though semantically
+    // identical, to add data in larger chunks.
+    // @param [in] input    The data to add to the checksum.
+    void write(pn::data_view input);
+    template <typename... arguments>
+    void write(const arguments&... args) {
+        pn::data d;
+        d.output().write(args...).check();
+        write(pn::data_view{d});
+    }
+
+    // Returns the checksum of the current content.
+    uint32_t compute() const { return ~_crc; }
+
+    // Computes the checksum of the concatenation of two byte sequences.  This allows chunks of a
+    // larger sequence to be checksummed independently (e.g. in parallel) and merged afterwards.
+    //
+    // @param [in] crc1     The checksum of the first sequence.
+    // @param [in] crc2     The checksum of the second sequence.
+    // @param [in] size2    The length, in bytes, of the second sequence.
+    // @returns             The checksum of the first sequence followed by the second.
+    static uint32_t combine(uint32_t crc1, uint32_t crc2, uint64_t size2);
+
+  private:
+    // The current (pre-inverted) value of the checksum being computed.
+    uint32_t _crc;
+};
+
+// How file_digest() treats the content of a file.
+//
+// DIGEST_DENSE hashes the file's content, so the digest is the same as that of a sha1 fed the
+// file's bytes.  Holes in sparse files are hashed from a static block of zeroes, rather than read,
+// but they are still hashed, so the cost is proportional to the size of the file.
+//
+// DIGEST_SPARSE hashes the file's size, plus the index and content of each 64 KiB block which
+// isn't entirely zero.  Blocks within holes are skipped without being hashed, so the cost is
+// proportional to the data actually allocated.  The result doesn't depend on which zeroes are
+// holes and which are stored, but it is a different digest from DIGEST_DENSE.
+enum DigestMode { DIGEST_DENSE, DIGEST_SPARSE };
+
+// A snapshot of the progress of file_digest() or tree_digest().
+struct DigestProgress {
+    uint64_t        bytes;  // Bytes hashed so far.
+    uint64_t        files;  // Files completely hashed so far.
+    pn::string_view path;   // The file being hashed, or the last file hashed.
+
+    // Time spent so far waiting for file content to be read in, and hashing it.  A disk which
+    // can't keep up shows as a high proportion of `io_seconds`.
+    double io_seconds;
+    double compute_seconds;
+};
+
+// Receives progress reports from file_digest() and tree_digest().
+//
+// Reports are made at most once per `interval`, plus once when the digest is complete.  Measuring
+// progress adds some overhead, but only to digests which have an observer.
+class DigestObserver {
+  public:
+    explicit DigestObserver(
+            std::chrono::steady_clock::duration interval = std::chrono::milliseconds(100))
+            : _interval(interval) {}
+    virtual ~DigestObserver();
+
+    std::chrono::steady_clock::duration interval() const { return _interval; }
+
+    virtual void progress(const DigestProgress& progress) const = 0;
+
+  private:
+    const std::chrono::steady_clock::duration _interval;
+};
+
 // Hashes a regular file.
-sha1::digest file_digest(pn::string_view path);
+sha1::digest file_digest(
+        pn::string_view path, DigestMode mode = DIGEST_DENSE,
+        const DigestObserver* observer = nullptr);
 
 // Hashes a tree containing regular files (or symlinks).
+sha1::digest tree_digest(pn::string_view path, const DigestObserver* observer = nullptr);
+
+// Hashes a tree as above, saving checkpoints to the file at `checkpoint` so that an interrupted
+// digest can be resumed.  `checkpoint` must not be within the tree.
+//
+// After a file is hashed, at most once per `interval`, the file's path and the state of the hash
+// are saved.  If `checkpoint` exists when resumable_tree_digest() starts, files are skipped until
+// the saved path is reached, and hashing continues from the saved state after it.  The result is
+// the same as that of an uninterrupted digest, provided the skipped files haven't changed.  If the
+// saved path no longer exists, throws.  `checkpoint` is removed once the digest is complete.
+sha1::digest resumable_tree_digest(
+        pn::string_view path, pn::string_view checkpoint,
+        std::chrono::steady_clock::duration interval = std::chrono::seconds(10),
+        const DigestObserver* observer = nullptr);
+
+// Git object ids.
+//
+// Git identifies each object by the SHA-1 digest of its content, prefixed with a header giving
+// the object's type and size ("blob 12\0").  A tree object lists the mode, name, and id of each
+// entry in a directory, sorted by name (with directories compared as if their name ended in '/').
+namespace git {
+
+// Modes of entries in a tree object.
+enum EntryMode : uint32_t {
+    MODE_FILE       = 0100644,
+    MODE_EXECUTABLE = 0100755,
+    MODE_SYMLINK    = 0120000,
+    MODE_TREE       = 040000,
+    MODE_GITLINK    = 0160000,  // A submodule, identified by its checked-out commit.
+};
+
+struct tree_entry {
+    EntryMode    mode;
+    pn::string   name;
+    sha1::digest id;
+};
+
+// @returns             The id of an object with the given type ("blob", "tree", etc.) and
+//                      content.
+sha1::digest object_digest(pn::string_view type, pn::data_view content);
+
+// @returns             The id of a blob with the given content.
+sha1::digest blob_digest(pn::data_view content);
+
+// @returns             The content of a tree object with the given entries, in any order.
+pn::data tree_object(const std::vector<tree_entry>& entries);
+
+// Hashes a regular file as a blob.
+sha1::digest file_digest(pn::string_view path);
+
+// Hashes a working tree as a tree object, as `git write-tree` would after `git add -A`.  Empty
+// directories are skipped, as is anything named .git, whether it's a directory or a file (as in a
+// linked worktree).  Symlinks are hashed as their targets, not followed.  A directory with its
+// own .git, such as a submodule, is a gitlink to the commit it has checked out, not a tree.
+// Ignore rules are not applied.
+//
+// If `path` is the root of a git checkout, then for files whose stat data matches the entry in
+// .git/index, the blob id cached in the index is reused rather than re-hashing the file.  Entries
+// which are not known to be clean (e.g. modified within the same second that the index was
+// written) are re-hashed, as git itself would.
 sha1::digest tree_digest(pn::string_view path);
 
+}  // namespace git
+
 }  // namespace sfz
 
 #endif  // SFZ_DIGEST_HPP_
@@ -7,7 +7,10 @@
 #define SFZ_ENCODING_HPP_
 
 #include <stdint.h>
+#include <pn/data>
+#include <pn/output>
 #include <pn/string>
+#include <vector>
 
 namespace sfz {
 
@@ -35,6 +38,104 @@ extern const pn::rune kAsciiUnknownCodePoint;
 // @returns             true iff `rune` is a valid code point.
 bool is_valid_code_point(uint32_t rune);
 
+// Identifies invalid code points in an array, as is_valid_code_point() does, but checking several
+// at a time with SIMD where the processor supports it.
+//
+// @param [in] runes    Potential code points to test.
+// @param [in] size     The number of values in `runes`.
+// @returns             The index of the first invalid code point, or `size` if all are valid.
+int validate_code_points(const uint32_t* runes, int size);
+
+// Replaces each invalid code point in an array with kUnknownCodePoint.
+//
+// @param [in,out] runes  Potential code points to check and replace.
+// @param [in] size       The number of values in `runes`.
+// @returns               The number of code points replaced.
+int replace_invalid_code_points(uint32_t* runes, int size);
+
+namespace utf8 {
+
+// Checks that `data` is valid UTF-8, as is required of the contents of a pn::string.
+//
+// Rejects overlong sequences, surrogates, code points above U+10FFFF, and truncated or stray
+// multi-byte sequences.  Uses SIMD where the processor supports it, so validating untrusted input
+// costs much less than decoding it.
+//
+// @param [in] data     Bytes which may be UTF-8.
+// @returns             The offset of the first byte of the first invalid sequence, or
+//                      data.size() if all of `data` is valid.
+int validate(pn::data_view data);
+
+// Counts the code points in `string`, using SIMD where available.
+//
+// @param [in] string   Valid UTF-8.
+// @returns             The number of code points in `string`.
+int count_runes(pn::string_view string);
+
+// The number of code points between the samples of a rune_index.
+const int kRuneIndexInterval = 4096;
+
+// Finds code points in a string by their index, without walking it from the start each time.
+//
+// Built once per string, in linear time, by recording the byte offset of every 4096th code point.
+// A lookup starts from the nearest sample at or before it, and skips the remaining code points a
+// block at a time, so its cost doesn't depend on the length of the string.  The samples take 4
+// bytes per 4096 code points, about 0.1% of the size of ASCII text.
+class rune_index {
+  public:
+    // @param [in] string   Valid UTF-8.  It must outlive the index.
+    explicit rune_index(pn::string_view string);
+
+    // @returns             The number of code points in the string.
+    int size() const { return _size; }
+
+    // @param [in] n        The index of a code point, from 0 to size().
+    // @returns             The byte offset of code point `n`, or the size of the string if `n`
+    //                      is size().
+    // @throws std::runtime_error if `n` is out of range.
+    int offset(int n) const;
+
+    // @param [in] n        The index of a code point, from 0 to size() - 1.
+    // @returns             Code point `n`.
+    // @throws std::runtime_error if `n` is out of range.
+    pn::rune at(int n) const;
+
+    // @param [in] begin    The index of the first code point, from 0 to size().
+    // @param [in] end      The index after the last code point, from `begin` to size().
+    // @returns             The code points from `begin` to `end`.
+    // @throws std::runtime_error if `begin` or `end` is out of range.
+    pn::string_view substr(int begin, int end) const;
+
+  private:
+    pn::string_view  _string;
+    int              _size;
+    std::vector<int> _samples;  // The byte offset of each kRuneIndexInterval-th code point.
+};
+
+}  // namespace utf8
+
+// The progress of a conversion into a caller's buffer.
+//
+// Each encoding has encode_into() and decode_into() functions, which convert as much of their
+// input as fits in `capacity` bytes at `out`, and return how much that was.  They never split a
+// code point, and stop short of the end of the input if the next one wouldn't fit, so calling them
+// again with the rest of the input gives the same result as converting the whole at once.  Room
+// for 4 bytes is always enough to make progress.  They don't allocate.
+//
+// The encode_append() and decode_append() functions append the result to an existing buffer,
+// converting through a buffer on the stack.  They allocate only if `out` has to grow.
+struct transcode_result {
+    int read;     // Bytes of input converted.
+    int written;  // Bytes of output written.
+};
+
+// Each encoding also has functions to measure a conversion without doing it, or allocating:
+//
+//   encoded_length(string) == encode(string).size()
+//   decoded_length(data)   == decode(data).size()
+//   can_encode(string)     is true iff `string` is valid UTF-8, and encode() wouldn't have to
+//                          replace any of its code points.
+
 // ASCII text encoding.
 //
 // This encoding can represent code points in the range [U+00, U+7F].  It does so by representing
@@ -45,6 +146,15 @@ namespace ascii {
 pn::data   encode(pn::string_view string);
 pn::string decode(pn::data_view data);
 
+transcode_result encode_into(pn::string_view string, uint8_t* out, int capacity);
+transcode_result decode_into(pn::data_view data, uint8_t* out, int capacity);
+void             encode_append(pn::string_view string, pn::data* out);
+void             decode_append(pn::data_view data, pn::string* out);
+
+int  encoded_length(pn::string_view string);
+int  decoded_length(pn::data_view data);
+bool can_encode(pn::string_view string);
+
 }  // namespace ascii
 
 // Latin-1 text encoding.
@@ -61,6 +171,15 @@ namespace latin1 {
 pn::data   encode(pn::string_view string);
 pn::string decode(pn::data_view data);
 
+transcode_result encode_into(pn::string_view string, uint8_t* out, int capacity);
+transcode_result decode_into(pn::data_view data, uint8_t* out, int capacity);
+void             encode_append(pn::string_view string, pn::data* out);
+void             decode_append(pn::data_view data, pn::string* out);
+
+int  encoded_length(pn::string_view string);
+int  decoded_length(pn::data_view data);
+bool can_encode(pn::string_view string);
+
 }  // namespace latin1
 
 // MacRoman text encoding.
@@ -77,8 +196,326 @@ namespace macroman {
 pn::data   encode(pn::string_view string);
 pn::string decode(pn::data_view data);
 
+transcode_result encode_into(pn::string_view string, uint8_t* out, int capacity);
+transcode_result decode_into(pn::data_view data, uint8_t* out, int capacity);
+void             encode_append(pn::string_view string, pn::data* out);
+void             decode_append(pn::data_view data, pn::string* out);
+
+int  encoded_length(pn::string_view string);
+int  decoded_length(pn::data_view data);
+bool can_encode(pn::string_view string);
+
 }  // namespace macroman
 
+// Windows-1252 text encoding.
+//
+// This is Latin-1, except that most of the range [0x80, 0x9F], which Latin-1 gives to C1 control
+// codes, instead encodes punctuation and letters such as U+20AC EURO SIGN.  The five bytes in
+// that range that Windows-1252 leaves undefined are decoded as the corresponding C1 controls.
+namespace windows1252 {
+
+pn::data   encode(pn::string_view string);
+pn::string decode(pn::data_view data);
+
+transcode_result encode_into(pn::string_view string, uint8_t* out, int capacity);
+transcode_result decode_into(pn::data_view data, uint8_t* out, int capacity);
+void             encode_append(pn::string_view string, pn::data* out);
+void             decode_append(pn::data_view data, pn::string* out);
+
+int  encoded_length(pn::string_view string);
+int  decoded_length(pn::data_view data);
+bool can_encode(pn::string_view string);
+
+}  // namespace windows1252
+
+// ISO-8859-15 (Latin-9) text encoding.
+//
+// This is Latin-1 with eight code points replaced, adding U+20AC EURO SIGN and letters needed by
+// French, Finnish, and Estonian.
+namespace iso8859_15 {
+
+pn::data   encode(pn::string_view string);
+pn::string decode(pn::data_view data);
+
+transcode_result encode_into(pn::string_view string, uint8_t* out, int capacity);
+transcode_result decode_into(pn::data_view data, uint8_t* out, int capacity);
+void             encode_append(pn::string_view string, pn::data* out);
+void             decode_append(pn::data_view data, pn::string* out);
+
+int  encoded_length(pn::string_view string);
+int  decoded_length(pn::data_view data);
+bool can_encode(pn::string_view string);
+
+}  // namespace iso8859_15
+
+// KOI8-R text encoding.
+//
+// This encoding represents ASCII code points as in ASCII, and Cyrillic letters, box-drawing
+// characters, and a few symbols in the range [0x80, 0xFF].
+namespace koi8r {
+
+pn::data   encode(pn::string_view string);
+pn::string decode(pn::data_view data);
+
+transcode_result encode_into(pn::string_view string, uint8_t* out, int capacity);
+transcode_result decode_into(pn::data_view data, uint8_t* out, int capacity);
+void             encode_append(pn::string_view string, pn::data* out);
+void             decode_append(pn::data_view data, pn::string* out);
+
+int  encoded_length(pn::string_view string);
+int  decoded_length(pn::data_view data);
+bool can_encode(pn::string_view string);
+
+}  // namespace koi8r
+
+// UTF-16 text encodings, little- and big-endian.
+//
+// These encodings can represent any code point.  Code points in the basic multilingual plane are
+// represented as a single 16-bit code unit, and the rest as a pair of surrogate code units.  No
+// byte order mark is written or expected.
+//
+// When decoding, an unpaired surrogate, or a trailing odd byte, is replaced with
+// kUnknownCodePoint.
+namespace utf16le {
+
+pn::data   encode(pn::string_view string);
+pn::string decode(pn::data_view data);
+
+transcode_result encode_into(pn::string_view string, uint8_t* out, int capacity);
+transcode_result decode_into(pn::data_view data, uint8_t* out, int capacity);
+void             encode_append(pn::string_view string, pn::data* out);
+void             decode_append(pn::data_view data, pn::string* out);
+
+int  encoded_length(pn::string_view string);
+int  decoded_length(pn::data_view data);
+bool can_encode(pn::string_view string);
+
+}  // namespace utf16le
+
+namespace utf16be {
+
+pn::data   encode(pn::string_view string);
+pn::string decode(pn::data_view data);
+
+transcode_result encode_into(pn::string_view string, uint8_t* out, int capacity);
+transcode_result decode_into(pn::data_view data, uint8_t* out, int capacity);
+void             encode_append(pn::string_view string, pn::data* out);
+void             decode_append(pn::data_view data, pn::string* out);
+
+int  encoded_length(pn::string_view string);
+int  decoded_length(pn::data_view data);
+bool can_encode(pn::string_view string);
+
+}  // namespace utf16be
+
+// UTF-32 text encoding.
+//
+// This encoding represents each code point as a 32-bit code unit.  As Unicode specifies for
+// UTF-32 without a byte order mark, units are big-endian.
+//
+// When decoding, a unit which isn't a valid code point, or trailing bytes which don't make up a
+// whole unit, are replaced with kUnknownCodePoint.
+namespace utf32 {
+
+pn::data   encode(pn::string_view string);
+pn::string decode(pn::data_view data);
+
+transcode_result encode_into(pn::string_view string, uint8_t* out, int capacity);
+transcode_result decode_into(pn::data_view data, uint8_t* out, int capacity);
+void             encode_append(pn::string_view string, pn::data* out);
+void             decode_append(pn::data_view data, pn::string* out);
+
+int  encoded_length(pn::string_view string);
+int  decoded_length(pn::data_view data);
+bool can_encode(pn::string_view string);
+
+}  // namespace utf32
+
+// Binary-to-text encodings, for digests and other binary data in manifests and logs.  These are
+// the reverse of the text encodings above: encode() turns bytes into text, and decode() turns
+// the text back into bytes.
+//
+// decode() is strict, and throws on anything encode() wouldn't have written: a character
+// outside the alphabet, or a length that isn't a whole number of groups.  In base64, padding
+// must be present and in place, and bits left over after the last byte must be zero, so each
+// value has exactly one encoding.
+//
+// encode_into() and decode_into() convert as much as fits in `capacity` bytes at `out`, like
+// those of the text encodings, but never stop partway through a group of characters, and
+// decode_into() throws on invalid input.  encoded_length() and decoded_length() give the size of
+// the whole result.
+
+// Base64 (RFC 4648, section 4), with padding.
+namespace base64 {
+
+pn::string encode(pn::data_view data);
+pn::data   decode(pn::string_view string);
+
+transcode_result encode_into(pn::data_view data, uint8_t* out, int capacity);
+transcode_result decode_into(pn::string_view string, uint8_t* out, int capacity);
+
+int encoded_length(int size);
+int decoded_length(pn::string_view string);
+
+}  // namespace base64
+
+// Base64 with the URL- and filename-safe alphabet (RFC 4648, section 5), which has "-" and "_" in
+// place of "+" and "/", and without padding.
+namespace base64url {
+
+pn::string encode(pn::data_view data);
+pn::data   decode(pn::string_view string);
+
+transcode_result encode_into(pn::data_view data, uint8_t* out, int capacity);
+transcode_result decode_into(pn::string_view string, uint8_t* out, int capacity);
+
+int encoded_length(int size);
+int decoded_length(pn::string_view string);
+
+}  // namespace base64url
+
+// Hexadecimal, two digits per byte.  Encodes in lowercase, and decodes either case.
+namespace hex {
+
+pn::string encode(pn::data_view data);
+pn::data   decode(pn::string_view string);
+
+transcode_result encode_into(pn::data_view data, uint8_t* out, int capacity);
+transcode_result decode_into(pn::string_view string, uint8_t* out, int capacity);
+
+int encoded_length(int size);
+int decoded_length(pn::string_view string);
+
+}  // namespace hex
+
+// A text encoding that is selected at runtime, such as one named in a file header or on the
+// command line.
+struct text_encoding {
+    const char* name;
+    pn::data (*encode)(pn::string_view string);
+    pn::string (*decode)(pn::data_view data);
+    transcode_result (*encode_into)(pn::string_view string, uint8_t* out, int capacity);
+    transcode_result (*decode_into)(pn::data_view data, uint8_t* out, int capacity);
+    int (*encoded_length)(pn::string_view string);
+    int (*decoded_length)(pn::data_view data);
+
+    // Returns the length of the longest prefix of `data` that decodes the same way regardless of
+    // what follows it, such as the whole code units, less a trailing high surrogate.
+    int (*decodable)(pn::data_view data);
+};
+
+// Finds an encoding by name.  Names are compared without regard to case or punctuation, so
+// "ISO-8859-15", "iso8859_15", and "latin9" all find the same encoding.
+//
+// @param [in] name     The name of an encoding.
+// @returns             The encoding, or nullptr if none has that name.
+const text_encoding* find_encoding(pn::string_view name);
+
+// The number of bytes that detect_encoding() examines.
+const int kDetectionSampleSize = 64 * 1024;
+
+// The result of detect_encoding().
+struct detected_encoding {
+    const text_encoding* encoding;  // nullptr for UTF-8 (or ASCII), which needs no decoding.
+    int                  bom;       // The size of a byte order mark before the text, or 0.
+};
+
+// Guesses the encoding of `data`, such as the contents of a file with no declared encoding.
+//
+// A byte order mark is trusted if present.  Otherwise, zero bytes at alternating offsets suggest
+// UTF-16 or UTF-32 text that is mostly ASCII; valid UTF-8 is taken to be UTF-8; and anything
+// else is taken as Latin-1, Windows-1252, or MacRoman, by which of them its high bytes look most
+// like letters and punctuation in.  Only the first kDetectionSampleSize bytes are examined, so
+// the cost doesn't grow with the size of `data`.
+//
+// @param [in] data     The start of the encoded text, or all of it.
+// @returns             The likely encoding, and the size of its byte order mark.
+detected_encoding detect_encoding(pn::data_view data);
+
+// Converts text using as many threads as the hardware supports, for inputs large enough that
+// converting on one thread would be slow.  The result is the same as encoding.encode(string) or
+// encoding.decode(data).
+//
+// The input is split into pieces where the encoding allows, such as between UTF-8 sequences.
+// Each piece is measured in parallel, and a running total of their lengths gives each piece its
+// place in the output, which is allocated once.  Then each piece is converted in parallel,
+// directly into its place.  Throws if the output would be too large for a pn::data or pn::string.
+pn::data   encode_parallel(const text_encoding& encoding, pn::string_view string);
+pn::string decode_parallel(const text_encoding& encoding, pn::data_view data);
+
+// Converts the file at `src` from one encoding to another, writing the result to `dst`.  Either
+// encoding may be nullptr, for UTF-8, as returned by detect_encoding().
+//
+// The file is read through a memory mapping, and converted a piece at a time through buffers of
+// a fixed size, so memory use doesn't depend on the size of the file.  Throws if `src` can't be
+// read, or `dst` can't be written.
+//
+// @param [in] src      The path to the file to convert.
+// @param [in] dst      The path to write the converted file to.
+// @param [in] from     The encoding of `src`, or nullptr for UTF-8.
+// @param [in] to       The encoding to write `dst` in, or nullptr for UTF-8.
+void transcode_file(
+        pn::string_view src, pn::string_view dst, const text_encoding* from,
+        const text_encoding* to);
+
+// Encodes text incrementally, so that text too large to hold in memory can be encoded in a
+// pipeline.
+//
+// Text is written in chunks of UTF-8, which needn't end on a code point boundary: a multi-byte
+// sequence split between chunks is held until the rest of it is written.  Each chunk is encoded
+// and written to `out` before write() returns, so memory use depends only on the chunk size.
+class encoder {
+  public:
+    // @param [in] encoding The encoding to use.
+    // @param [out] out     Receives the encoded bytes.  It must outlive the encoder.
+    encoder(const text_encoding& encoding, pn::output& out);
+    encoder(const encoder&) = delete;
+
+    // Encodes the next chunk of text.
+    // @param [in] utf8     The next bytes of the UTF-8 text.
+    void write(pn::data_view utf8);
+
+    // Encodes any partial sequence held from the last chunk, as a truncated (invalid) sequence.
+    // Call once the last chunk has been written.
+    void finish();
+
+  private:
+    void emit(pn::data_view utf8);
+
+    const text_encoding& _encoding;
+    pn::output&          _out;
+    uint8_t              _pending[4];  // The start of a sequence split across chunks.
+    int                  _pending_size;
+};
+
+// Decodes text incrementally; the counterpart of encoder.  Decoded text is written to `out` in
+// UTF-8.
+//
+// A code unit or surrogate pair split between chunks is held until the rest of it is written.
+class decoder {
+  public:
+    // @param [in] encoding The encoding to use.
+    // @param [out] out     Receives the decoded text.  It must outlive the decoder.
+    decoder(const text_encoding& encoding, pn::output& out);
+    decoder(const decoder&) = delete;
+
+    // Decodes the next chunk of encoded bytes.
+    // @param [in] data     The next bytes of the encoded text.
+    void write(pn::data_view data);
+
+    // Decodes any partial code unit or surrogate pair held from the last chunk, as invalid.  Call
+    // once the last chunk has been written.
+    void finish();
+
+  private:
+    void emit(pn::data_view data);
+
+    const text_encoding& _encoding;
+    pn::output&          _out;
+    uint8_t              _pending[4];  // The start of a sequence split across chunks.
+    int                  _pending_size;
+};
+
 }  // namespace sfz
 
 #endif  // SFZ_ENCODING_HPP_
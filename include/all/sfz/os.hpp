@@ -42,6 +42,7 @@ pn::string join(pn::string_view root, string_views... segments) {
 void       chdir(pn::string_view path);
 pn::string getcwd();
 void       symlink(pn::string_view content, pn::string_view container);
+pn::string readlink(pn::string_view path);
 
 #ifdef _MSC_VER
 typedef int mkdir_mode_t;
@@ -57,6 +58,16 @@ void unlink(pn::string_view path);
 void rmdir(pn::string_view path);
 void rmtree(pn::string_view path);
 
+void link(pn::string_view existing, pn::string_view path);
+void rename(pn::string_view from, pn::string_view to);
+
+// Creates `to` as a copy-on-write clone of the regular file `from` (a "reflink").  The clone
+// shares storage with `from` until either is modified.
+//
+// @returns             true if the clone was created, or false if the filesystem or platform
+//                      does not support cloning, in which case `to` is not created.
+bool clonefile(pn::string_view from, pn::string_view to);
+
 class TemporaryDirectory {
   public:
     TemporaryDirectory(pn::string_view prefix);
@@ -7,6 +7,8 @@
 #define SFZ_SFZ_HPP_
 
 #include <sfz/args.hpp>
+#include <sfz/cas.hpp>
+#include <sfz/delta.hpp>
 #include <sfz/digest.hpp>
 #include <sfz/encoding.hpp>
 #include <sfz/file.hpp>
@@ -15,5 +17,6 @@
 #include <sfz/os.hpp>
 #include <sfz/range.hpp>
 #include <sfz/string-utils.hpp>
+#include <sfz/tar.hpp>
 
 #endif  // SFZ_SFZ_HPP_
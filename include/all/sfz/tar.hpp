@@ -0,0 +1,116 @@
+// Copyright (c) 2026 The libsfz Authors
+//
+// This file is part of libsfz, a free software project.  You can redistribute it and/or modify it
+// under the terms of the MIT License.
+
+#ifndef SFZ_TAR_HPP_
+#define SFZ_TAR_HPP_
+
+#include <stdint.h>
+#include <memory>
+#include <pn/data>
+#include <pn/output>
+#include <pn/string>
+#include <sfz/digest.hpp>
+#include <vector>
+
+namespace sfz {
+
+class TemporaryDirectory;
+class mapped_file;
+
+// Computes the tree_digest() of the tree that a tar archive would extract to, without extracting
+// it.  The archive is fed to write() in pieces of any size, as it is read from a file, pipe,
+// decompressor, etc.
+//
+// Understands ustar, pax, and GNU archives, including long names and base-256 sizes.  Compressed
+// archives must be decompressed first.
+//
+// tree_digest() hashes files in order of their paths.  While an archive is in that order, its
+// files are hashed as they stream past; any that arrive out of order, and any files after them,
+// are hashed when compute() is called.  Their content isn't kept in memory: tar_digest() rereads
+// it from the mapped archive, and a digester fed with write() spills it to a temporary file.
+// Since a later entry may sort before a file that was already hashed, or link to it, a digester
+// fed with write() also spills the files it hashes as they stream past, but it only reads them
+// back when a later entry needs them.  Memory use depends only on the number of entries.
+//
+// As with tree_digest(), only regular files are hashed; symlinks are followed to files within the
+// archive, and broken ones are ignored.  Throws on anything that tree_digest() would reject, or
+// that can't be resolved without extracting the archive, such as a symlink to a directory, or to
+// a path outside it.
+class tar_digester {
+  public:
+    tar_digester();
+    tar_digester(const tar_digester&) = delete;
+    ~tar_digester();
+
+    // Adds data in `input` to the archive.
+    // @param [in] input    The next bytes of the archive.
+    void write(pn::data_view input);
+
+    // Returns the digest of the archive's tree.  Throws if the archive is incomplete.
+    sha1::digest compute() const;
+
+  private:
+    friend sha1::digest tar_digest(pn::string_view path);
+
+    // Rereads content from `archive`, which must be the whole archive that is passed to write(),
+    // instead of spilling it.
+    explicit tar_digester(const mapped_file& archive);
+
+    enum EntryType { ENTRY_FILE, ENTRY_HARDLINK, ENTRY_SYMLINK };
+    enum State { STATE_HEADER, STATE_BODY, STATE_PADDING, STATE_END };
+
+    struct entry {
+        EntryType  type;
+        pn::string path;
+        pn::string target;  // For links.
+        uint64_t   offset;  // Of the content, in the archive or the spill file.
+        uint64_t   size;
+    };
+
+    void parse_header();
+    void end_body();
+    void spill(pn::data_view body);
+    void hash(sha1& sha, const entry& e, const entry& file) const;
+
+    State    _state;
+    uint8_t  _header[512];  // The header being read.
+    int      _header_size;
+    char     _type;       // The typeflag of the current entry.
+    uint64_t _remaining;  // Bytes left in the current body or padding.
+    uint64_t _padding;    // Bytes of padding after the current body.
+    uint64_t _offset;     // Bytes of the archive read so far.
+
+    // Metadata from pax extended headers or GNU long name entries, which applies to the next
+    // entry.
+    pn::data   _meta;
+    pn::string _next_path;
+    pn::string _next_target;
+    int64_t    _next_size;  // -1 if not given.
+
+    std::vector<entry> _entries;
+
+    // The hash of the files which have streamed past in walk order, which are the first
+    // _checkpoints.size() entries.  After each of them, the state of the hash is saved, in case
+    // a later entry sorts before the next.
+    sha1                  _sha;
+    bool                  _hashing;  // True if the current body is streamed into _sha.
+    std::vector<pn::data> _checkpoints;
+
+    // Where file content is reread from: the archive itself, or a file that it's spilled to,
+    // which is mapped once the archive ends.
+    const mapped_file*                  _archive;
+    const bool                          _spills;
+    std::unique_ptr<TemporaryDirectory> _spill_dir;
+    std::unique_ptr<pn::output>         _spill;
+    uint64_t                            _spill_size;
+    std::unique_ptr<mapped_file>        _spilled;
+};
+
+// Computes the tree_digest() of the tree that the tar archive at `path` would extract to.
+sha1::digest tar_digest(pn::string_view path);
+
+}  // namespace sfz
+
+#endif  // SFZ_TAR_HPP_
@@ -6,8 +6,10 @@
 #ifndef SFZ_FILE_HPP_
 #define SFZ_FILE_HPP_
 
+#include <stdint.h>
 #include <pn/data>
 #include <pn/string>
+#include <vector>
 
 namespace sfz {
 
@@ -17,6 +19,12 @@ namespace sfz {
 // content can be accessed as a pn::data_view or pn::string_view.
 class mapped_file {
   public:
+    // A range of bytes within the file.
+    struct extent {
+        uint64_t offset;
+        uint64_t size;
+    };
+
     // Maps the given file into memory.
     //
     // @param [in] path     The path to the file, relative or absolute.
@@ -29,10 +37,26 @@ class mapped_file {
     // @returns             The path to the mapped file.
     pn::string_view path() const;
 
-    // @returns             The block of data containing the file's contents.
+    // @returns             The size of the file in bytes.
+    uint64_t size() const { return _size; }
+
+    // @returns             The block of data containing the file's contents.  Only usable for
+    //                      files smaller than 2 GiB; read larger ones in pieces with data(offset,
+    //                      size).
     pn::data_view   data() const { return pn::data_view{_data, static_cast<int>(_size)}; }
     pn::string_view string() const { return data().as_string(); }
 
+    // @returns             `size` bytes of the file's contents, starting at `offset`.
+    pn::data_view data(uint64_t offset, int size) const {
+        return pn::data_view{_data + offset, size};
+    }
+
+    // @returns             The extents of the file that hold data, in order.  The gaps between
+    //                      them are holes: ranges of a sparse file that read as zeroes, but aren't
+    //                      backed by storage.  Where holes can't be detected, the whole file is
+    //                      reported as data.
+    std::vector<extent> data_extents() const;
+
   private:
     struct fd {
         int no;
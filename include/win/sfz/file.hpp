@@ -17,8 +17,10 @@
 #pragma pop_macro("NOMINMAX")
 
 
+#include <stdint.h>
 #include <pn/data>
 #include <pn/string>
+#include <vector>
 
 namespace sfz {
 
@@ -28,6 +30,12 @@ namespace sfz {
 // content can be accessed as a pn::data_view or pn::string_view.
 class mapped_file {
   public:
+    // A range of bytes within the file.
+    struct extent {
+        uint64_t offset;
+        uint64_t size;
+    };
+
     // Maps the given file into memory.
     //
     // @param [in] path     The path to the file, relative or absolute.
@@ -40,10 +48,24 @@ class mapped_file {
     // @returns             The path to the mapped file.
     pn::string_view path() const;
 
-    // @returns             The block of data containing the file's contents.
+    // @returns             The size of the file in bytes.
+    uint64_t size() const { return _size; }
+
+    // @returns             The block of data containing the file's contents.  Only usable for
+    //                      files smaller than 2 GiB; read larger ones in pieces with data(offset,
+    //                      size).
     pn::data_view   data() const;
     pn::string_view string() const { return data().as_string(); }
 
+    // @returns             `size` bytes of the file's contents, starting at `offset`.
+    pn::data_view data(uint64_t offset, int size) const;
+
+    // @returns             The extents of the file that hold data, in order.  The gaps between
+    //                      them are holes: ranges of a sparse file that read as zeroes, but aren't
+    //                      backed by storage.  Where holes can't be detected, the whole file is
+    //                      reported as data.
+    std::vector<extent> data_extents() const;
+
   private:
     struct handle {
         HANDLE h;
@@ -53,7 +75,7 @@ class mapped_file {
 
     struct view_of_file {
         LPVOID ptr;
-        view_of_file(pn::string_view path, LPVOID ptr);
+        view_of_file(pn::string_view path, LPVOID ptr, LONGLONG size);
         ~view_of_file();
     };
 
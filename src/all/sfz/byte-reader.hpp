@@ -0,0 +1,54 @@
+// Copyright (c) 2026 The libsfz Authors
+//
+// This file is part of libsfz, a free software project.  You can redistribute it and/or modify it
+// under the terms of the MIT License.
+
+#ifndef SFZ_BYTE_READER_HPP_
+#define SFZ_BYTE_READER_HPP_
+
+#include <stdint.h>
+#include <pn/data>
+#include <stdexcept>
+
+namespace sfz {
+
+// Reads big-endian integers and runs of bytes from the front of a data_view, in the format that
+// pn::output writes them.  Throws if asked to read past the end of the data.
+class byte_reader {
+  public:
+    explicit byte_reader(pn::data_view data) : _data(data) {}
+
+    bool     empty() const { return _data.empty(); }
+    uint64_t remaining() const { return _data.size(); }
+
+    // Reads an unsigned integer which is `bytes` bytes long.
+    uint64_t read(int bytes) {
+        need(bytes);
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; ++i) {
+            value = (value << 8) | _data[i];
+        }
+        _data.shift(bytes);
+        return value;
+    }
+
+    pn::data_view read_data(uint64_t bytes) {
+        need(bytes);
+        pn::data_view result{_data.data(), static_cast<int>(bytes)};
+        _data.shift(bytes);
+        return result;
+    }
+
+  private:
+    void need(uint64_t bytes) const {
+        if (static_cast<uint64_t>(_data.size()) < bytes) {
+            throw std::runtime_error("unexpected end of data");
+        }
+    }
+
+    pn::data_view _data;
+};
+
+}  // namespace sfz
+
+#endif  // SFZ_BYTE_READER_HPP_
@@ -0,0 +1,329 @@
+// Copyright (c) 2026 The libsfz Authors
+//
+// This file is part of libsfz, a free software project.  You can redistribute it and/or modify it
+// under the terms of the MIT License.
+
+#include <sfz/cas.hpp>
+
+#include <string.h>
+#include <algorithm>
+#include <pn/output>
+#include <sfz/byte-reader.hpp>
+#include <sfz/file.hpp>
+#include <sfz/os.hpp>
+#include <sfz/relative-path.hpp>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace sfz {
+
+namespace {
+
+const int kKeySize = 20;
+
+void write_file(pn::string_view path, pn::data_view data) {
+    pn::output out{path, pn::binary};
+    if (!out.c_obj()) {
+        throw std::runtime_error(pn::format("{0}: couldn't open for writing", path).c_str());
+    }
+    out.write(data).check();
+}
+
+void copy_file(pn::string_view from, pn::string_view to) {
+    mapped_file file(from);
+    write_file(to, file.data());
+}
+
+int hex_value(char ch) {
+    if (('0' <= ch) && (ch <= '9')) {
+        return ch - '0';
+    } else if (('a' <= ch) && (ch <= 'f')) {
+        return ch - 'a' + 10;
+    }
+    return -1;
+}
+
+// Parses the 40 hex digits of a digest, as written by sha1::digest::hex().
+bool parse_hex(pn::string_view hex, uint8_t* bytes) {
+    if (hex.size() != 2 * kKeySize) {
+        return false;
+    }
+    for (int i = 0; i < kKeySize; ++i) {
+        int hi = hex_value(hex.data()[2 * i]);
+        int lo = hex_value(hex.data()[2 * i + 1]);
+        if ((hi < 0) || (lo < 0)) {
+            return false;
+        }
+        bytes[i] = (hi << 4) | lo;
+    }
+    return true;
+}
+
+}  // namespace
+
+bool cas_store::key::operator<(const key& other) const {
+    return memcmp(bytes, other.bytes, kKeySize) < 0;
+}
+
+bool cas_store::key::operator==(const key& other) const {
+    return memcmp(bytes, other.bytes, kKeySize) == 0;
+}
+
+// Keys are digests, so any of their bytes are already well mixed.
+size_t cas_store::key_hash::operator()(const key& k) const {
+    size_t hash;
+    memcpy(&hash, k.bytes, sizeof(hash));
+    return hash;
+}
+
+cas_store::cas_store(pn::string_view root) : _root{root.copy()}, _tmp_count{0} {
+    makedirs(path::join(_root, "objects"), 0755);
+    makedirs(path::join(_root, "tmp"), 0755);
+    load_index();
+}
+
+cas_store::~cas_store() {}
+
+pn::string cas_store::object_path(const sha1::digest& digest) const {
+    pn::string hex = digest.hex();
+    return path::join(_root, "objects", hex.substr(0, 2), hex.substr(2));
+}
+
+cas_store::key cas_store::key_for(const sha1::digest& digest) {
+    key k;
+    for (int i = 0; i < 5; ++i) {
+        k.bytes[4 * i]     = digest.d[i] >> 24;
+        k.bytes[4 * i + 1] = digest.d[i] >> 16;
+        k.bytes[4 * i + 2] = digest.d[i] >> 8;
+        k.bytes[4 * i + 3] = digest.d[i];
+    }
+    return k;
+}
+
+bool cas_store::indexed(const key& k) const {
+    if (!_index) {
+        return false;
+    }
+    const key* begin = reinterpret_cast<const key*>(_index->data().data());
+    const key* end   = begin + (_index->data().size() / kKeySize);
+    return std::binary_search(begin, end, k);
+}
+
+bool cas_store::contains(const sha1::digest& digest) const {
+    key k = key_for(digest);
+    return indexed(k) || (_pending.count(k) != 0);
+}
+
+pn::string cas_store::tmp_path() {
+    int64_t count = _tmp_count++;
+    return path::join(_root, "tmp", pn::format("{0}.{1}", getpid(), count));
+}
+
+void cas_store::insert(pn::string_view tmp, const sha1::digest& digest) {
+    pn::string object = object_path(digest);
+    if (path::isfile(object)) {
+        // Present, but not yet indexed; perhaps added by another process.
+        unlink(tmp);
+    } else {
+        makedirs(path::dirname(object), 0755);
+        rename(tmp, object);
+    }
+
+    _pending.insert(key_for(digest));
+}
+
+sha1::digest cas_store::add(pn::data_view data) {
+    sha1 sha;
+    sha.write(data);
+    sha1::digest digest = sha.compute();
+    if (!contains(digest)) {
+        pn::string tmp = tmp_path();
+        write_file(tmp, data);
+        insert(tmp, digest);
+    }
+    return digest;
+}
+
+sha1::digest cas_store::add_file(pn::string_view path) {
+    sha1::digest digest = file_digest(path);
+    if (contains(digest)) {
+        return digest;
+    }
+
+    // The file might change between hashing and copying, so hash the copy too, before it's
+    // committed.  If the copy was cloned, or is still in the page cache, this is cheap.
+    pn::string tmp = tmp_path();
+    if (!clonefile(path, tmp)) {
+        copy_file(path, tmp);
+    }
+    if (file_digest(tmp) != digest) {
+        unlink(tmp);
+        throw std::runtime_error(pn::format("{0}: changed while being added", path).c_str());
+    }
+    insert(tmp, digest);
+    return digest;
+}
+
+sha1::digest cas_store::add_tree(pn::string_view path) {
+    // The manifest lists each file in the tree, in the order walk() visits them.  For each file,
+    // it holds the size and bytes of its UTF-8-encoded path relative to the root, followed by the
+    // 20 bytes of its digest.
+    struct manifestWalker : TreeWalker {
+        void file(pn::string_view path, const Stat&) const {
+            pn::string_view relative = path.substr(prefix_size);
+            sha1::digest    digest   = store->add_file(path);
+            manifest->output().write(static_cast<uint64_t>(relative.size())).check();
+            *manifest += pn::data_view{
+                    reinterpret_cast<const uint8_t*>(relative.data()), relative.size()};
+            *manifest += digest.data();
+        }
+
+        void pre_directory(pn::string_view path, const Stat& stat) const {
+            static_cast<void>(path);
+            static_cast<void>(stat);
+        }
+        void post_directory(pn::string_view path, const Stat& stat) const {
+            static_cast<void>(path);
+            static_cast<void>(stat);
+        }
+        void cycle_directory(pn::string_view path, const Stat&) const {
+            throw std::runtime_error(pn::format("Found directory cycle: {0}.", path).c_str());
+        }
+        void other(pn::string_view path, const Stat&) const {
+            throw std::runtime_error(pn::format("Found non-regular file: {0}", path).c_str());
+        }
+        void broken_symlink(pn::string_view path, const Stat& stat) const {
+            static_cast<void>(path);
+            static_cast<void>(stat);
+        }
+        void symlink(pn::string_view path, const Stat& stat) const {
+            static_cast<void>(path);
+            static_cast<void>(stat);
+        }
+
+        cas_store* store;
+        const int  prefix_size;
+        pn::data*  manifest;
+        manifestWalker(cas_store* store, int prefix_size, pn::data* manifest)
+                : store(store), prefix_size(prefix_size), manifest(manifest) {}
+    };
+    pn::data manifest;
+    walk(path, WALK_LOGICAL, manifestWalker(this, path.size() + 1, &manifest));
+    return add(manifest);
+}
+
+void cas_store::checkout_file(
+        const sha1::digest& digest, pn::string_view path, CasLinkType type) const {
+    pn::string object = object_path(digest);
+    if (!path::isfile(object)) {
+        throw std::runtime_error(pn::format("missing object {0}", digest.hex()).c_str());
+    }
+    if (path::exists(path)) {
+        throw std::runtime_error(pn::format("{0}: already exists", path).c_str());
+    }
+    if (type == CAS_HARDLINK) {
+        try {
+            link(object, path);
+            return;
+        } catch (std::runtime_error&) {
+            // Fall back to cloning; e.g. `path` might be on a different filesystem.
+        }
+    }
+    if ((type != CAS_COPY) && clonefile(object, path)) {
+        return;
+    }
+    copy_file(object, path);
+}
+
+void cas_store::checkout_tree(
+        const sha1::digest& manifest, pn::string_view path, CasLinkType type) const {
+    pn::string object = object_path(manifest);
+    if (!path::isfile(object)) {
+        throw std::runtime_error(pn::format("missing object {0}", manifest.hex()).c_str());
+    }
+    mapped_file file(object);
+    byte_reader in{file.data()};
+    makedirs(path, 0755);
+    while (!in.empty()) {
+        pn::string_view relative = in.read_data(in.read(8)).as_string();
+        sha1::digest    digest{in.read_data(kKeySize)};
+        pn::string      output = join_within(path, relative);
+        makedirs(path::dirname(output), 0755);
+        checkout_file(digest, output, type);
+    }
+}
+
+void cas_store::load_index() {
+    pn::string index = path::join(_root, "index");
+    if (!path::isfile(index)) {
+        _index.reset();
+        return;
+    }
+    _index.reset(new mapped_file(index));
+    if ((_index->data().size() % kKeySize) != 0) {
+        _index.reset();
+        throw std::runtime_error(pn::format("{0}: corrupt index", index).c_str());
+    }
+}
+
+void cas_store::write_index(const std::vector<key>& keys) {
+    pn::data data;
+    for (const key& k : keys) {
+        data += pn::data_view{k.bytes, kKeySize};
+    }
+    pn::string tmp = tmp_path();
+    write_file(tmp, data);
+
+    // Some platforms can't replace a file that is mapped, so unmap it first.
+    _index.reset();
+    rename(tmp, path::join(_root, "index"));
+    _pending.clear();
+    load_index();
+}
+
+void cas_store::flush() {
+    if (_pending.empty()) {
+        return;
+    }
+    std::vector<key> pending(_pending.begin(), _pending.end());
+    std::sort(pending.begin(), pending.end());
+    std::vector<key> keys;
+    if (_index) {
+        const key* begin = reinterpret_cast<const key*>(_index->data().data());
+        const key* end   = begin + (_index->data().size() / kKeySize);
+        keys.reserve((end - begin) + pending.size());
+        std::merge(begin, end, pending.begin(), pending.end(), std::back_inserter(keys));
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    } else {
+        keys = std::move(pending);
+    }
+    write_index(keys);
+}
+
+void cas_store::reindex() {
+    std::vector<key> keys;
+    pn::string       objects = path::join(_root, "objects");
+    for (const auto& dir : scandir(objects)) {
+        if ((dir.st.st_mode & S_IFMT) != S_IFDIR) {
+            continue;
+        }
+        for (const auto& file : scandir(path::join(objects, pn::string_view{dir.name}))) {
+            pn::string hex = dir.name.copy();
+            hex += file.name;
+            key k;
+            if (parse_hex(hex, k.bytes)) {
+                keys.push_back(k);
+            }
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    write_index(keys);
+}
+
+}  // namespace sfz
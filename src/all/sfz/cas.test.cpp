@@ -0,0 +1,172 @@
+// Copyright (c) 2026 The libsfz Authors
+//
+// This file is part of libsfz, a free software project.  You can redistribute it and/or modify it
+// under the terms of the MIT License.
+
+#include <sfz/cas.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <pn/output>
+#include <sfz/file.hpp>
+#include <sfz/os.hpp>
+#include <stdexcept>
+
+using testing::Eq;
+using testing::Ne;
+using testing::NotNull;
+
+namespace sfz {
+namespace {
+
+using CasTest = ::testing::Test;
+
+pn::data_view bytes(pn::string_view s) {
+    return pn::data_view{reinterpret_cast<const uint8_t*>(s.data()), s.size()};
+}
+
+void write_file(pn::string_view path, pn::data_view data) {
+    makedirs(path::dirname(path), 0700);
+    pn::output out{path, pn::binary};
+    ASSERT_THAT(out.c_obj(), NotNull());
+    ASSERT_THAT(out.write(data), Eq(true));
+}
+
+pn::data read_file(pn::string_view path) {
+    mapped_file file(path);
+    return file.data().copy();
+}
+
+TEST_F(CasTest, Dedupe) {
+    TemporaryDirectory dir("cas-test");
+    cas_store          store(path::join(dir.path(), "store"));
+
+    pn::string a = path::join(dir.path(), "a");
+    pn::string b = path::join(dir.path(), "b");
+    write_file(a, bytes("same content"));
+    write_file(b, bytes("same content"));
+
+    sha1::digest digest = store.add_file(a);
+    EXPECT_THAT(store.add_file(b), Eq(digest));
+    EXPECT_THAT(store.add(bytes("same content")), Eq(digest));
+    EXPECT_THAT(digest, Eq(file_digest(a)));
+    EXPECT_THAT(store.contains(digest), Eq(true));
+    EXPECT_THAT(path::isfile(store.object_path(digest)), Eq(true));
+
+    int objects = 0;
+    for (const auto& fanout : scandir(path::join(dir.path(), "store", "objects"))) {
+        for (const auto& object : scandir(
+                     path::join(dir.path(), "store", "objects", pn::string_view{fanout.name}))) {
+            static_cast<void>(object);
+            ++objects;
+        }
+    }
+    EXPECT_THAT(objects, Eq(1));
+}
+
+TEST_F(CasTest, Index) {
+    TemporaryDirectory dir("cas-test");
+    pn::string         root = path::join(dir.path(), "store");
+
+    sha1::digest a, b;
+    {
+        cas_store store(root);
+        a = store.add(bytes("a"));
+        store.flush();
+        b = store.add(bytes("b"));
+        EXPECT_THAT(store.contains(a), Eq(true));
+        EXPECT_THAT(store.contains(b), Eq(true));
+    }
+
+    // `b` was never flushed, so it is stored but not indexed until the index is rebuilt.
+    cas_store store(root);
+    EXPECT_THAT(store.contains(a), Eq(true));
+    EXPECT_THAT(store.contains(b), Eq(false));
+    store.reindex();
+    EXPECT_THAT(store.contains(a), Eq(true));
+    EXPECT_THAT(store.contains(b), Eq(true));
+    EXPECT_THAT(store.contains(sha1{}.compute()), Eq(false));
+
+    // Objects added again are indexed only once.
+    sha1::digest c = store.add(bytes("c"));
+    store.add(bytes("c"));
+    store.add(bytes("a"));
+    store.flush();
+    EXPECT_THAT(read_file(path::join(root, "index")).size(), Eq(3 * 20));
+    EXPECT_THAT(cas_store(root).contains(c), Eq(true));
+}
+
+TEST_F(CasTest, Tree) {
+    TemporaryDirectory dir("cas-test");
+    cas_store          store(path::join(dir.path(), "store"));
+    pn::string         input = path::join(dir.path(), "input");
+    write_file(path::join(input, "a"), bytes("a"));
+    write_file(path::join(input, "b/c"), bytes("c"));
+    write_file(path::join(input, "b/d"), bytes("a"));
+    write_file(path::join(input, "b/e/f"), pn::data{});
+
+    sha1::digest manifest = store.add_tree(input);
+    EXPECT_THAT(store.contains(manifest), Eq(true));
+    EXPECT_THAT(store.add_tree(input), Eq(manifest));
+
+    for (CasLinkType type : {CAS_HARDLINK, CAS_CLONE, CAS_COPY}) {
+        pn::string output =
+                path::join(dir.path(), pn::format("output{0}", static_cast<int>(type)));
+        store.checkout_tree(manifest, output, type);
+        EXPECT_THAT(tree_digest(output), Eq(tree_digest(input)));
+        EXPECT_THAT(read_file(path::join(output, "b/d")), Eq(bytes("a")));
+    }
+
+    // Checking out over existing files, or a missing object, fails.
+    sha1 missing;
+    missing.write(bytes("missing"));
+    EXPECT_THROW(
+            store.checkout_tree(manifest, path::join(dir.path(), "output0")), std::runtime_error);
+    EXPECT_THROW(
+            store.checkout_file(missing.compute(), path::join(dir.path(), "missing")),
+            std::runtime_error);
+}
+
+// Paths in a manifest might have been tampered with, and must not reach outside the checkout.
+TEST_F(CasTest, TreeEscape) {
+    TemporaryDirectory dir("cas-test");
+    cas_store          store(path::join(dir.path(), "store"));
+    sha1::digest       digest = store.add(bytes("escaped"));
+
+    for (pn::string_view relative : {"../escape", "a/../../escape", "/tmp/escape", ""}) {
+        pn::data manifest;
+        manifest.output().write(static_cast<uint64_t>(relative.size())).check();
+        manifest += bytes(relative);
+        manifest += digest.data();
+        EXPECT_THROW(
+                store.checkout_tree(store.add(manifest), path::join(dir.path(), "output")),
+                std::runtime_error)
+                << relative;
+        rmtree(path::join(dir.path(), "output"));
+    }
+    EXPECT_THAT(path::exists(path::join(dir.path(), "escape")), Eq(false));
+}
+
+#ifndef _WIN32
+TEST_F(CasTest, Hardlink) {
+    TemporaryDirectory dir("cas-test");
+    cas_store          store(path::join(dir.path(), "store"));
+    sha1::digest       digest = store.add(bytes("linked"));
+
+    pn::string linked = path::join(dir.path(), "linked");
+    pn::string copied = path::join(dir.path(), "copied");
+    store.checkout_file(digest, linked, CAS_HARDLINK);
+    store.checkout_file(digest, copied, CAS_COPY);
+
+    Stat object, link, copy;
+    ASSERT_THAT(stat(store.object_path(digest).c_str(), &object), Eq(0));
+    ASSERT_THAT(stat(linked.c_str(), &link), Eq(0));
+    ASSERT_THAT(stat(copied.c_str(), &copy), Eq(0));
+    EXPECT_THAT(link.st_ino, Eq(object.st_ino));
+    EXPECT_THAT(copy.st_ino, Ne(object.st_ino));
+    EXPECT_THAT(file_digest(copied), Eq(digest));
+}
+#endif
+
+}  // namespace
+}  // namespace sfz
@@ -0,0 +1,449 @@
+// Copyright (c) 2026 The libsfz Authors
+//
+// This file is part of libsfz, a free software project.  You can redistribute it and/or modify it
+// under the terms of the MIT License.
+
+#include <sfz/delta.hpp>
+
+#include <string.h>
+#include <algorithm>
+#include <pn/output>
+#include <sfz/byte-reader.hpp>
+#include <sfz/file.hpp>
+#include <sfz/os.hpp>
+#include <sfz/parallel.hpp>
+#include <sfz/relative-path.hpp>
+#include <stdexcept>
+#include <utility>
+
+namespace sfz {
+
+const int kDeltaBlockSize = 2048;
+
+namespace {
+
+// Opcodes in a serialized delta.  A delta begins with the block size (uint32_t) and the size of
+// the target (uint64_t), and is followed by a sequence of operations:
+//
+//   kCopy:     uint64_t first block, uint64_t block count.
+//   kLiteral:  uint64_t size, followed by that many bytes of data.
+//   kEnd:      20 bytes of the SHA-1 digest of the target.  Nothing may follow.
+const uint8_t kCopy    = 'c';
+const uint8_t kLiteral = 'l';
+const uint8_t kEnd     = 'e';
+
+// Don't bother splitting work across threads in pieces smaller than this.
+const size_t kMinBlocksPerThread = 256;
+const size_t kMinBytesPerThread  = 1 << 20;
+
+// The weak checksum used by rsync.  It is the pair of 16-bit sums
+//
+//   a = x[0] + x[1] + ... + x[n-1]
+//   b = n*x[0] + (n-1)*x[1] + ... + 1*x[n-1]
+//
+// which can be updated in constant time as a window slides through the data.
+class rolling_checksum {
+  public:
+    rolling_checksum(const uint8_t* data, size_t size) : _a{0}, _b{0}, _size{uint32_t(size)} {
+        for (size_t i = 0; i < size; ++i) {
+            _a += data[i];
+            _b += _a;
+        }
+    }
+
+    // Removes `out` from the front of the window and appends `in` to the back.
+    void roll(uint8_t out, uint8_t in) {
+        _a += in - out;
+        _b += _a - (_size * out);
+    }
+
+    uint32_t value() const { return (_a & 0xffff) | (_b << 16); }
+
+  private:
+    uint32_t _a, _b;
+    uint32_t _size;
+};
+
+sha1::digest strong_digest(const uint8_t* data, size_t size) {
+    sha1 sha;
+    sha.write(pn::data_view{data, static_cast<int>(size)});
+    return sha.compute();
+}
+
+// Indexes the full blocks of a signature by weak checksum.  Most positions in the target match no
+// block at all, so a bitmap over the low bits of the checksum is consulted first.
+class block_index {
+  public:
+    explicit block_index(const delta_signature& sig) : _sig(sig), _filter(kFilterSize / 8) {
+        const size_t full_blocks = sig.size / sig.block_size;
+        _entries.reserve(full_blocks);
+        for (size_t i = 0; i < full_blocks; ++i) {
+            uint32_t weak = sig.blocks[i].weak;
+            _entries.push_back(entry{weak, i});
+            _filter[(weak % kFilterSize) / 8] |= 1 << (weak % 8);
+        }
+        std::sort(_entries.begin(), _entries.end());
+    }
+
+    // Returns the index of a block matching the `size` bytes at `data`, whose weak checksum is
+    // `weak`, or -1 if there is none.
+    int64_t find(uint32_t weak, const uint8_t* data, size_t size) const {
+        if (!(_filter[(weak % kFilterSize) / 8] & (1 << (weak % 8)))) {
+            return -1;
+        }
+        auto it = std::lower_bound(_entries.begin(), _entries.end(), entry{weak, 0});
+        if ((it == _entries.end()) || (it->weak != weak)) {
+            return -1;
+        }
+        sha1::digest strong = strong_digest(data, size);
+        for (; (it != _entries.end()) && (it->weak == weak); ++it) {
+            if (_sig.blocks[it->block].strong == strong) {
+                return it->block;
+            }
+        }
+        return -1;
+    }
+
+  private:
+    static const uint32_t kFilterSize = 1 << 20;
+
+    struct entry {
+        uint32_t weak;
+        size_t   block;
+        bool     operator<(const entry& other) const {
+            return (weak < other.weak) || ((weak == other.weak) && (block < other.block));
+        }
+    };
+
+    const delta_signature& _sig;
+    std::vector<entry>     _entries;
+    std::vector<uint8_t>   _filter;
+};
+
+struct match {
+    uint64_t offset;  // in the target
+    uint64_t block;   // in the basis
+};
+
+// Scans target windows beginning in [begin, end) for blocks of the basis.  Windows may extend
+// past `end`.  After a match, scanning resumes at the end of the matched window, as rsync does.
+void find_matches(
+        const block_index& index, size_t block_size, pn::data_view target, size_t begin,
+        size_t end, std::vector<match>* matches) {
+    const uint8_t* data = target.data();
+    const size_t   size = target.size();
+    size_t         pos  = begin;
+    while ((pos < end) && (pos + block_size <= size)) {
+        rolling_checksum weak(data + pos, block_size);
+        while (true) {
+            int64_t block = index.find(weak.value(), data + pos, block_size);
+            if (block >= 0) {
+                matches->push_back(match{pos, static_cast<uint64_t>(block)});
+                pos += block_size;
+                break;
+            }
+            if ((pos + 1 >= end) || (pos + block_size >= size)) {
+                return;
+            }
+            weak.roll(data[pos], data[pos + block_size]);
+            ++pos;
+        }
+    }
+}
+
+// Serializes a delta of `target`.  Matches must be added in order of their offsets; the data
+// between them is included literally, and runs of consecutive blocks are coalesced.
+class delta_writer {
+  public:
+    delta_writer(pn::data_view target, size_t block_size)
+            : _target(target), _pos{0}, _copy_block{0}, _copy_count{0} {
+        _out.output().write(static_cast<uint32_t>(block_size), uint64_t(target.size())).check();
+    }
+
+    // @returns             The offset in the target up to which the delta has been written.
+    uint64_t pos() const { return _pos; }
+
+    // Adds a copy of `block`, which is `size` bytes long, to be placed at `offset` in the target.
+    void copy(uint64_t offset, uint64_t block, uint64_t size) {
+        if ((_copy_count == 0) || (offset != _pos) || (block != _copy_block + _copy_count)) {
+            flush_copy();
+            write_literal(offset);
+            _copy_block = block;
+        }
+        ++_copy_count;
+        _pos = offset + size;
+    }
+
+    pn::data finish() {
+        flush_copy();
+        write_literal(_target.size());
+        sha1 sha;
+        sha.write(_target);
+        _out.output().write(kEnd).check();
+        _out += sha.compute().data();
+        return std::move(_out);
+    }
+
+  private:
+    void flush_copy() {
+        if (_copy_count > 0) {
+            _out.output().write(kCopy, _copy_block, _copy_count).check();
+            _copy_count = 0;
+        }
+    }
+
+    void write_literal(uint64_t end) {
+        if (_pos < end) {
+            _out.output().write(kLiteral, end - _pos).check();
+            _out += pn::data_view{_target.data() + _pos, static_cast<int>(end - _pos)};
+            _pos = end;
+        }
+    }
+
+    pn::data_view _target;
+    pn::data      _out;
+    uint64_t      _pos;
+    uint64_t      _copy_block, _copy_count;
+};
+
+void write_file(pn::string_view path, pn::data_view data) {
+    pn::output out{path, pn::binary};
+    if (!out.c_obj()) {
+        throw std::runtime_error(pn::format("{0}: couldn't open for writing", path).c_str());
+    }
+    out.write(data).check();
+}
+
+}  // namespace
+
+delta_signature::delta_signature(pn::data_view data) {
+    byte_reader in{data};
+    block_size = in.read(4);
+    if (block_size <= 0) {
+        throw std::runtime_error("invalid delta signature block size");
+    }
+    size           = in.read(8);
+    uint64_t count = (size + block_size - 1) / block_size;
+    if (count > in.remaining() / 24) {
+        throw std::runtime_error("delta signature is truncated");
+    }
+    blocks.resize(count);
+    for (block& b : blocks) {
+        b.weak   = in.read(4);
+        b.strong = sha1::digest{in.read_data(20)};
+    }
+    if (!in.empty()) {
+        throw std::runtime_error("trailing data after delta signature");
+    }
+}
+
+pn::data delta_signature::data() const {
+    pn::data out;
+    out.output().write(static_cast<uint32_t>(block_size), size).check();
+    for (const block& b : blocks) {
+        out.output().write(b.weak).check();
+        out += b.strong.data();
+    }
+    return out;
+}
+
+delta_signature signature(pn::data_view basis, int block_size) {
+    if (block_size <= 0) {
+        throw std::runtime_error(pn::format("invalid block size {0}", block_size).c_str());
+    }
+    delta_signature sig;
+    sig.block_size = block_size;
+    sig.size       = basis.size();
+    sig.blocks.resize((sig.size + block_size - 1) / block_size);
+    parallel_for(sig.blocks.size(), kMinBlocksPerThread, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const uint8_t* data = basis.data() + (i * block_size);
+            const size_t   size = std::min<size_t>(block_size, sig.size - (i * block_size));
+            sig.blocks[i].weak   = rolling_checksum{data, size}.value();
+            sig.blocks[i].strong = strong_digest(data, size);
+        }
+    });
+    return sig;
+}
+
+pn::data delta(const delta_signature& basis, pn::data_view target) {
+    const size_t size       = target.size();
+    const size_t block_size = basis.block_size;
+
+    // Scan pieces of the target independently.  Each piece's scan may run into the next piece, in
+    // which case the latter's matches that overlap it are dropped below.  This costs at most a
+    // block's worth of matching per piece, compared to a sequential scan.
+    std::vector<std::vector<match>> pieces;
+    if ((basis.size >= block_size) && (size >= block_size)) {
+        block_index index{basis};
+        size_t      count = (size + kMinBytesPerThread - 1) / kMinBytesPerThread;
+        pieces.resize(count);
+        parallel_for(count, 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                find_matches(
+                        index, block_size, target, i * kMinBytesPerThread,
+                        std::min(size, (i + 1) * kMinBytesPerThread), &pieces[i]);
+            }
+        });
+    }
+
+    delta_writer out{target, block_size};
+    for (const std::vector<match>& piece : pieces) {
+        for (const match& m : piece) {
+            if (m.offset >= out.pos()) {
+                out.copy(m.offset, m.block, block_size);
+            }
+        }
+    }
+
+    // The final block of the basis may be partial.  If so, it can still match the end of the
+    // target.  This is common, and important for unchanged files.
+    const size_t tail = basis.size % block_size;
+    if ((tail > 0) && (size - out.pos() >= tail)) {
+        const uint8_t* data = target.data() + size - tail;
+        if ((rolling_checksum{data, tail}.value() == basis.blocks.back().weak) &&
+            (strong_digest(data, tail) == basis.blocks.back().strong)) {
+            out.copy(size - tail, basis.blocks.size() - 1, tail);
+        }
+    }
+    return out.finish();
+}
+
+pn::data patch(pn::data_view basis, pn::data_view delta) {
+    byte_reader in{delta};
+    uint64_t    block_size = in.read(4);
+    uint64_t    size       = in.read(8);
+    if (block_size == 0) {
+        throw std::runtime_error("invalid delta block size");
+    }
+
+    pn::data out;
+    while (true) {
+        uint8_t op = in.read(1);
+        if (op == kCopy) {
+            uint64_t first = in.read(8);
+            uint64_t count = in.read(8);
+            uint64_t limit = (basis.size() + block_size - 1) / block_size;
+            if ((first > limit) || (count > limit - first)) {
+                throw std::runtime_error("delta refers to blocks outside of basis");
+            }
+            uint64_t begin = first * block_size;
+            uint64_t end   = std::min<uint64_t>((first + count) * block_size, basis.size());
+            out += pn::data_view{basis.data() + begin, static_cast<int>(end - begin)};
+        } else if (op == kLiteral) {
+            out += in.read_data(in.read(8));
+        } else if (op == kEnd) {
+            break;
+        } else {
+            throw std::runtime_error(pn::format("invalid delta opcode {0}", int{op}).c_str());
+        }
+        if (static_cast<uint64_t>(out.size()) > size) {
+            throw std::runtime_error("delta output exceeds target size");
+        }
+    }
+
+    sha1::digest expected{in.read_data(20)};
+    if (!in.empty()) {
+        throw std::runtime_error("trailing data after delta");
+    }
+    sha1 sha;
+    sha.write(out);
+    if ((static_cast<uint64_t>(out.size()) != size) || (sha.compute() != expected)) {
+        throw std::runtime_error("delta does not apply to basis");
+    }
+    return out;
+}
+
+delta_signature file_signature(pn::string_view path, int block_size) {
+    mapped_file file(path);
+    return signature(file.data(), block_size);
+}
+
+pn::data file_delta(const delta_signature& basis, pn::string_view target_path) {
+    mapped_file target(target_path);
+    return delta(basis, target.data());
+}
+
+pn::data file_delta(pn::string_view basis_path, pn::string_view target_path) {
+    return file_delta(file_signature(basis_path), target_path);
+}
+
+void patch_file(pn::string_view basis_path, pn::data_view delta, pn::string_view output_path) {
+    mapped_file basis(basis_path);
+    write_file(output_path, patch(basis.data(), delta));
+}
+
+pn::data tree_delta(pn::string_view basis_path, pn::string_view target_path) {
+    // For each file in the target, write the size and bytes of its UTF-8-encoded path relative to
+    // the root, followed by the size and bytes of its delta.
+    struct deltaWalker : TreeWalker {
+        void file(pn::string_view path, const Stat&) const {
+            pn::string_view relative = path.substr(prefix_size);
+            pn::string      basis    = path::join(basis_path, relative);
+
+            delta_signature sig;
+            if (path::isfile(basis)) {
+                sig = file_signature(basis);
+            }
+            pn::data file = file_delta(sig, path);
+
+            out->output().write(static_cast<uint64_t>(relative.size())).check();
+            *out += pn::data_view{
+                    reinterpret_cast<const uint8_t*>(relative.data()), relative.size()};
+            out->output().write(static_cast<uint64_t>(file.size())).check();
+            *out += file;
+        }
+
+        void pre_directory(pn::string_view path, const Stat& stat) const {
+            static_cast<void>(path);
+            static_cast<void>(stat);
+        }
+        void post_directory(pn::string_view path, const Stat& stat) const {
+            static_cast<void>(path);
+            static_cast<void>(stat);
+        }
+        void cycle_directory(pn::string_view path, const Stat&) const {
+            throw std::runtime_error(pn::format("Found directory cycle: {0}.", path).c_str());
+        }
+        void other(pn::string_view path, const Stat&) const {
+            throw std::runtime_error(pn::format("Found non-regular file: {0}", path).c_str());
+        }
+        void broken_symlink(pn::string_view path, const Stat& stat) const {
+            static_cast<void>(path);
+            static_cast<void>(stat);
+        }
+        void symlink(pn::string_view path, const Stat& stat) const {
+            static_cast<void>(path);
+            static_cast<void>(stat);
+        }
+
+        pn::string_view basis_path;
+        const int       prefix_size;
+        pn::data*       out;
+        deltaWalker(pn::string_view basis_path, int prefix_size, pn::data* out)
+                : basis_path(basis_path), prefix_size(prefix_size), out(out) {}
+    };
+    pn::data out;
+    walk(target_path, WALK_LOGICAL, deltaWalker(basis_path, target_path.size() + 1, &out));
+    return out;
+}
+
+void patch_tree(pn::string_view basis_path, pn::data_view delta, pn::string_view output_path) {
+    byte_reader in{delta};
+    makedirs(output_path, 0755);
+    while (!in.empty()) {
+        pn::string_view relative = in.read_data(in.read(8)).as_string();
+        pn::data_view   file     = in.read_data(in.read(8));
+        pn::string      basis    = join_within(basis_path, relative);
+        pn::string      output   = join_within(output_path, relative);
+
+        makedirs(path::dirname(output), 0755);
+        if (path::isfile(basis)) {
+            patch_file(basis, file, output);
+        } else {
+            write_file(output, patch(pn::data_view{}, file));
+        }
+    }
+}
+
+}  // namespace sfz
@@ -0,0 +1,187 @@
+// Copyright (c) 2026 The libsfz Authors
+//
+// This file is part of libsfz, a free software project.  You can redistribute it and/or modify it
+// under the terms of the MIT License.
+
+#include <sfz/delta.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <pn/output>
+#include <sfz/digest.hpp>
+#include <sfz/os.hpp>
+#include <sfz/range.hpp>
+#include <stdexcept>
+
+using testing::Eq;
+using testing::Le;
+using testing::Lt;
+using testing::NotNull;
+
+namespace sfz {
+namespace {
+
+using DeltaTest = ::testing::Test;
+
+// Generates `size` bytes of pseudo-random data, determined by `seed`.
+pn::data random_data(int size, uint32_t seed) {
+    pn::data data;
+    for (int i : range(size)) {
+        static_cast<void>(i);
+        seed         = (seed * 1103515245) + 12345;
+        uint8_t byte = seed >> 16;
+        data += pn::data_view{&byte, 1};
+    }
+    return data;
+}
+
+pn::data concat(std::initializer_list<pn::data_view> parts) {
+    pn::data data;
+    for (pn::data_view part : parts) {
+        data += part;
+    }
+    return data;
+}
+
+pn::data_view slice(pn::data_view data, int begin, int end) {
+    return pn::data_view{data.data() + begin, end - begin};
+}
+
+// An unchanged target should be expressed entirely in terms of the basis.
+TEST_F(DeltaTest, Identical) {
+    pn::data basis = random_data(100000, 1);
+    pn::data d     = delta(signature(basis), basis);
+    EXPECT_THAT(d.size(), Lt(100));
+    EXPECT_THAT(patch(basis, d), Eq(pn::data_view{basis}));
+}
+
+// Edits at arbitrary offsets should cost about a block each, plus the edit itself.
+TEST_F(DeltaTest, Edits) {
+    pn::data basis  = random_data(100000, 2);
+    pn::data insert = random_data(100, 3);
+    pn::data target = concat({
+            slice(basis, 0, 10000),
+            insert,
+            slice(basis, 10000, 50000),
+            slice(basis, 50100, 90000),
+            insert,
+            slice(basis, 90050, 100000),
+    });
+
+    pn::data d = delta(signature(basis, 1024), target);
+    EXPECT_THAT(d.size(), Le(4 * 1024 + 2 * 100 + 200));
+    EXPECT_THAT(patch(basis, d), Eq(pn::data_view{target}));
+}
+
+// A target large enough to be scanned in several pieces should still round-trip.
+TEST_F(DeltaTest, Large) {
+    pn::data basis  = random_data(3 << 20, 4);
+    pn::data target = concat({
+            slice(basis, 1 << 19, 3 << 20),
+            random_data(5000, 5),
+            slice(basis, 0, 1 << 19),
+    });
+
+    pn::data d = delta(signature(basis), target);
+    EXPECT_THAT(d.size(), Lt(5000 + 4 * kDeltaBlockSize));
+    EXPECT_THAT(patch(basis, d), Eq(pn::data_view{target}));
+}
+
+TEST_F(DeltaTest, Empty) {
+    pn::data empty;
+    pn::data data = random_data(5000, 6);
+    EXPECT_THAT(patch(empty, delta(signature(empty), data)), Eq(pn::data_view{data}));
+    EXPECT_THAT(patch(data, delta(signature(data), empty)), Eq(pn::data_view{empty}));
+    EXPECT_THAT(patch(empty, delta(signature(empty), empty)), Eq(pn::data_view{empty}));
+}
+
+TEST_F(DeltaTest, SignatureData) {
+    pn::data        basis = random_data(10000, 7);
+    delta_signature sig   = signature(basis, 1000);
+    ASSERT_THAT(sig.blocks.size(), Eq<size_t>(10));
+
+    delta_signature copy{sig.data()};
+    EXPECT_THAT(copy.block_size, Eq(1000));
+    ASSERT_THAT(copy.blocks.size(), Eq<size_t>(10));
+    for (int i : range(10)) {
+        EXPECT_THAT(copy.blocks[i].weak, Eq(sig.blocks[i].weak));
+        EXPECT_THAT(copy.blocks[i].strong, Eq(sig.blocks[i].strong));
+    }
+
+    pn::data target = random_data(10000, 8);
+    EXPECT_THAT(delta(copy, target), Eq(pn::data_view{delta(sig, target)}));
+}
+
+// A delta applied to the wrong basis, or a damaged delta, should be rejected.
+TEST_F(DeltaTest, Invalid) {
+    pn::data basis  = random_data(10000, 9);
+    pn::data target = concat({slice(basis, 5000, 10000), slice(basis, 0, 5000)});
+    pn::data d      = delta(signature(basis, 1000), target);
+
+    EXPECT_THROW(patch(random_data(10000, 10), d), std::runtime_error);
+    EXPECT_THROW(patch(slice(basis, 0, 5000), d), std::runtime_error);
+    EXPECT_THROW(patch(basis, slice(d, 0, d.size() - 1)), std::runtime_error);
+}
+
+#ifndef _WIN32
+TEST_F(DeltaTest, Tree) {
+    TemporaryDirectory dir("delta-test");
+    pn::string         basis  = path::join(dir.path(), "basis");
+    pn::string         target = path::join(dir.path(), "target");
+    pn::string         output = path::join(dir.path(), "output");
+
+    const struct {
+        pn::string_view path;
+        pn::data        basis, target;
+    } files[] = {
+            {"unchanged", random_data(10000, 11), random_data(10000, 11)},
+            {"changed/a", random_data(10000, 12), random_data(10000, 13)},
+            {"changed/b", random_data(10000, 14), random_data(12000, 14)},
+            {"added", pn::data{}, random_data(100, 15)},
+            {"removed", random_data(100, 16), pn::data{}},
+            {"empty", pn::data{}, pn::data{}},
+    };
+    for (const auto& file : files) {
+        for (const auto& side : {std::make_pair(&basis, &file.basis),
+                                 std::make_pair(&target, &file.target)}) {
+            if (side.second->empty() && (file.path != "empty")) {
+                continue;
+            }
+            pn::string path = path::join(*side.first, file.path);
+            makedirs(path::dirname(path), 0700);
+            pn::output out{path, pn::binary};
+            ASSERT_THAT(out.c_obj(), NotNull());
+            ASSERT_THAT(out.write(*side.second), Eq(true));
+        }
+    }
+
+    pn::data d = tree_delta(basis, target);
+    EXPECT_THAT(d.size(), Lt(10000 + 2000 + kDeltaBlockSize + 1000));
+    patch_tree(basis, d, output);
+    EXPECT_THAT(tree_digest(output), Eq(tree_digest(target)));
+    EXPECT_THAT(path::exists(path::join(output, "removed")), Eq(false));
+}
+
+// Paths in a tree delta come from untrusted input, and must not reach outside the basis or output.
+TEST_F(DeltaTest, TreeEscape) {
+    TemporaryDirectory dir("delta-test");
+    pn::string         basis  = path::join(dir.path(), "basis");
+    pn::string         output = path::join(dir.path(), "output");
+    makedirs(basis, 0700);
+
+    pn::data file = delta(signature(pn::data{}, 1000), random_data(100, 17));
+    for (pn::string_view relative :
+         {"../escape", "a/../../escape", "/tmp/escape", "", ".", "a/.."}) {
+        pn::data d;
+        d.output().write(static_cast<uint64_t>(relative.size())).check();
+        d += pn::data_view{reinterpret_cast<const uint8_t*>(relative.data()), relative.size()};
+        d.output().write(static_cast<uint64_t>(file.size())).check();
+        d += file;
+        EXPECT_THROW(patch_tree(basis, d, output), std::runtime_error) << relative;
+    }
+    EXPECT_THAT(path::exists(path::join(dir.path(), "escape")), Eq(false));
+}
+#endif
+
+}  // namespace
+}  // namespace sfz
@@ -5,13 +5,30 @@
 
 #include <sfz/digest.hpp>
 
+#include <stdio.h>
 #include <string.h>
+#include <algorithm>
 #include <limits>
+#include <memory>
 #include <pn/input>
+#include <sfz/byte-reader.hpp>
 #include <sfz/encoding.hpp>
 #include <sfz/file.hpp>
 #include <sfz/os.hpp>
+#include <sfz/relative-path.hpp>
+#include <sfz/walk-order.hpp>
 #include <stdexcept>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SFZ_CRC32C_X86 1
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32) && \
+        (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define SFZ_CRC32C_ARM 1
+#include <arm_acle.h>
+#endif
 
 using std::numeric_limits;
 
@@ -57,6 +74,32 @@ sha1::digest sha1::compute() const {
     return copy._intermediate;
 }
 
+pn::data sha1::save() const {
+    pn::data state;
+    state.output()
+            .write(_intermediate.d[0], _intermediate.d[1], _intermediate.d[2], _intermediate.d[3],
+                   _intermediate.d[4], _size,
+                   pn::data_view{_message_block, _message_block_index})
+            .check();
+    return state;
+}
+
+void sha1::restore(pn::data_view state) {
+    byte_reader in{state};
+    digest      intermediate;
+    for (uint32_t& d : intermediate.d) {
+        d = in.read(4);
+    }
+    uint64_t size = in.read(8);
+    if (((size % 8) != 0) || (((size / 8) % 64) != in.remaining())) {
+        throw std::runtime_error("invalid sha1 state");
+    }
+    _intermediate        = intermediate;
+    _size                = size;
+    _message_block_index = in.remaining();
+    memcpy(_message_block, in.read_data(in.remaining()).data(), _message_block_index);
+}
+
 void sha1::finish() {
     _message_block[_message_block_index++] = 0x80;
     if (_message_block_index > 56) {
@@ -170,31 +213,354 @@ pn::string sha1::digest::hex() const {
     return pn::string_view{buf, 40}.copy();
 }
 
-sha1::digest file_digest(pn::string_view path) {
+namespace {
+
+const uint64_t kSparseBlockSize = 64 * 1024;
+
+// Files may be larger than a pn::data_view can represent, so they are viewed, and passed to
+// sha1::write(), in pieces of at most this size.
+const uint64_t kMaxPiece = 1 << 30;
+
+// Holes are hashed from here, instead of from the mapped file.  This avoids faulting in a page of
+// zeroes for each page of a hole, and in any case, the kernel may need to read metadata from disk
+// to discover that a page is a hole.
+const uint8_t kZeroes[64 * 1024] = {};
+
+// Files smaller than this aren't checked for holes; it would take longer than reading them.
+const uint64_t kMinSparseFileSize = 64 * 1024;
+
+// Progress is measured and reported in chunks of this size.
+const int kMeterChunkSize = 1 << 20;
+
+// The smallest page size of any supported platform.
+const int kMinPageSize = 4096;
+
+std::vector<mapped_file::extent> data_extents(const mapped_file& file) {
+    uint64_t size = file.size();
+    if (size < kMinSparseFileSize) {
+        return {{0, size}};
+    }
+    return file.data_extents();
+}
+
+// Calls `f(data, hole)` with consecutive pieces of the bytes of `file` in [begin, end).
+// `extents` are the file's data extents.  Pieces within holes are views of kZeroes, and have
+// `hole` set to true.
+template <typename function>
+void visit(
+        const mapped_file& file, const std::vector<mapped_file::extent>& extents, uint64_t begin,
+        uint64_t end, const function& f) {
+    // Find the first extent that ends after `begin`.
+    auto it = std::upper_bound(
+            extents.begin(), extents.end(), begin,
+            [](uint64_t offset, const mapped_file::extent& e) {
+                return offset < (e.offset + e.size);
+            });
+    while (begin < end) {
+        uint64_t data_begin = (it == extents.end()) ? end : std::min(it->offset, end);
+        if (begin < data_begin) {
+            uint64_t size = std::min<uint64_t>(data_begin - begin, sizeof(kZeroes));
+            f(pn::data_view{kZeroes, static_cast<int>(size)}, true);
+            begin += size;
+            continue;
+        }
+        uint64_t data_end = std::min(it->offset + it->size, end);
+        uint64_t size     = std::min(data_end - begin, kMaxPiece);
+        f(file.data(begin, static_cast<int>(size)), false);
+        begin += size;
+        if (begin == (it->offset + it->size)) {
+            ++it;
+        }
+    }
+}
+
+pn::data_view as_bytes(pn::string_view s) {
+    return pn::data_view{reinterpret_cast<const uint8_t*>(s.data()), s.size()};
+}
+
+bool is_zero(pn::data_view data) {
+    const uint8_t* p = data.data();
+    return data.empty() || ((p[0] == 0) && (memcmp(p, p + 1, data.size() - 1) == 0));
+}
+
+// Measures the progress of a digest, and reports it to a DigestObserver.
+//
+// To tell time spent reading from time spent hashing, content is hashed in chunks, and each
+// chunk is faulted in by touching each of its pages before it's hashed.
+class progress_meter {
+  public:
+    explicit progress_meter(const DigestObserver& observer)
+            : _observer(observer),
+              _next_report{clock::now() + observer.interval()},
+              _bytes{0},
+              _files{0},
+              _io{0},
+              _compute{0} {}
+
+    void start_file(pn::string_view path) { _path = path.copy(); }
+
+    void end_file() {
+        ++_files;
+        clock::time_point now = clock::now();
+        if (now >= _next_report) {
+            report(now);
+        }
+    }
+
+    void finish() { report(clock::now()); }
+
+    void write(sha1& sha, pn::data_view data, bool hole) {
+        while (!data.empty()) {
+            pn::data_view chunk{data.data(), std::min(data.size(), kMeterChunkSize)};
+            data = pn::data_view{data.data() + chunk.size(), data.size() - chunk.size()};
+
+            clock::time_point start = clock::now();
+            if (!hole) {
+                touch(chunk);
+            }
+            clock::time_point read = clock::now();
+            sha.write(chunk);
+            clock::time_point hashed = clock::now();
+
+            _io += read - start;
+            _compute += hashed - read;
+            _bytes += chunk.size();
+            if (hashed >= _next_report) {
+                report(hashed);
+            }
+        }
+    }
+
+    // Checking for zeroes is almost all reading, so it counts as I/O.
+    bool is_zero(pn::data_view data, bool hole) {
+        if (hole) {
+            return true;
+        }
+        clock::time_point start  = clock::now();
+        bool              result = sfz::is_zero(data);
+        _io += clock::now() - start;
+        return result;
+    }
+
+  private:
+    typedef std::chrono::steady_clock clock;
+
+    static void touch(pn::data_view data) {
+        const volatile uint8_t* p   = data.data();
+        uint8_t                 sum = 0;
+        for (int i = 0; i < data.size(); i += kMinPageSize) {
+            sum ^= p[i];
+        }
+        static_cast<void>(sum);
+    }
+
+    void report(clock::time_point now) {
+        DigestProgress progress;
+        progress.bytes           = _bytes;
+        progress.files           = _files;
+        progress.path            = _path;
+        progress.io_seconds      = std::chrono::duration<double>(_io).count();
+        progress.compute_seconds = std::chrono::duration<double>(_compute).count();
+        _observer.progress(progress);
+        _next_report = now + _observer.interval();
+    }
+
+    const DigestObserver& _observer;
+    clock::time_point     _next_report;
+    pn::string            _path;
+    uint64_t              _bytes;
+    uint64_t              _files;
+    clock::duration       _io;
+    clock::duration       _compute;
+};
+
+// Hashes `data` into `sha`, through `meter` if there is one.
+void write(sha1& sha, pn::data_view data, bool hole, progress_meter* meter) {
+    if (meter) {
+        meter->write(sha, data, hole);
+    } else {
+        sha.write(data);
+    }
+}
+
+void write_dense(sha1& sha, const mapped_file& file, progress_meter* meter) {
+    visit(file, data_extents(file), 0, file.size(),
+          [&sha, meter](pn::data_view data, bool hole) { write(sha, data, hole, meter); });
+}
+
+void write_sparse(sha1& sha, const mapped_file& file, progress_meter* meter) {
+    const uint64_t size    = file.size();
+    const auto     extents = data_extents(file);
+    sha.write<uint64_t>(size);
+
+    // Consider only the blocks that overlap some extent, in order, and each at most once.
+    uint64_t next = 0;
+    for (const mapped_file::extent& e : extents) {
+        uint64_t first = std::max(next, e.offset / kSparseBlockSize);
+        uint64_t last  = (e.offset + e.size + kSparseBlockSize - 1) / kSparseBlockSize;
+        for (uint64_t block = first; block < last; ++block) {
+            uint64_t begin = block * kSparseBlockSize;
+            uint64_t end   = std::min(begin + kSparseBlockSize, size);
+            bool     zero  = true;
+            visit(file, extents, begin, end, [&zero, meter](pn::data_view data, bool hole) {
+                zero = zero && (meter ? meter->is_zero(data, hole) : (hole || is_zero(data)));
+            });
+            if (!zero) {
+                sha.write<uint64_t>(block);
+                visit(file, extents, begin, end, [&sha, meter](pn::data_view data, bool hole) {
+                    write(sha, data, hole, meter);
+                });
+            }
+        }
+        next = std::max(next, last);
+    }
+}
+
+}  // namespace
+
+DigestObserver::~DigestObserver() {}
+
+sha1::digest file_digest(pn::string_view path, DigestMode mode, const DigestObserver* observer) {
+    std::unique_ptr<progress_meter> meter;
+    if (observer) {
+        meter.reset(new progress_meter(*observer));
+        meter->start_file(path);
+    }
+
     mapped_file file(path);
     sha1        sha;
-    sha.write(file.data());
+    switch (mode) {
+        case DIGEST_DENSE: write_dense(sha, file, meter.get()); break;
+        case DIGEST_SPARSE: write_sparse(sha, file, meter.get()); break;
+    }
+
+    if (meter) {
+        meter->end_file();
+        meter->finish();
+    }
     return sha.compute();
 }
 
-sha1::digest tree_digest(pn::string_view path) {
+namespace {
+
+// Tags the start of a tree_digest() checkpoint file.
+const uint32_t kCheckpointMagic = 0x73667a63;  // "sfzc"
+
+// Saves and loads the progress of a tree_digest().
+//
+// A checkpoint holds the root of the tree being hashed, the path of the last file hashed, relative
+// to the root, and the state of the hash after that file.
+class tree_checkpoint {
+  public:
+    tree_checkpoint(
+            pn::string_view root, pn::string_view path,
+            std::chrono::steady_clock::duration interval)
+            : _root{root.copy()},
+              _path{path.copy()},
+              _interval{interval},
+              _next_save{clock::now() + interval} {}
+
+    // If a checkpoint was saved, restores `sha` to the saved state and returns the path of the
+    // last file hashed.  Otherwise, returns an empty path.
+    pn::string load(sha1& sha) const {
+        if (!path::exists(_path)) {
+            return pn::string{};
+        }
+        mapped_file file(_path);
+        byte_reader in{file.data()};
+        if ((in.remaining() < 4) || (in.read(4) != kCheckpointMagic)) {
+            throw std::runtime_error(pn::format("{0}: not a checkpoint", _path).c_str());
+        }
+        pn::string_view root = read_path(in);
+        if (root != _root) {
+            throw std::runtime_error(
+                    pn::format("{0}: checkpoint is for {1}, not {2}", _path, root, _root).c_str());
+        }
+        pn::string last = read_path(in).copy();
+        sha.restore(in.read_data(in.remaining()));
+        return last;
+    }
+
+    // Saves a checkpoint after hashing the file at `last`, if one is due.
+    void file_done(pn::string_view last, const sha1& sha) {
+        clock::time_point now = clock::now();
+        if (now < _next_save) {
+            return;
+        }
+        pn::data data;
+        data.output()
+                .write(kCheckpointMagic, static_cast<uint64_t>(_root.size()), as_bytes(_root),
+                       static_cast<uint64_t>(last.size()), as_bytes(last), sha.save())
+                .check();
+
+        // Replace the previous checkpoint atomically, so an interruption leaves one or the other.
+        pn::string tmp = pn::format("{0}.tmp", _path);
+        {
+            pn::output out{tmp, pn::binary};
+            if (!out.c_obj()) {
+                throw std::runtime_error(
+                        pn::format("{0}: couldn't open for writing", tmp).c_str());
+            }
+            out.write(data).check();
+        }
+        rename(tmp, _path);
+        _next_save = clock::now() + _interval;
+    }
+
+    void remove() const {
+        if (path::exists(_path)) {
+            unlink(_path);
+        }
+    }
+
+  private:
+    typedef std::chrono::steady_clock clock;
+
+    static pn::string_view read_path(byte_reader& in) {
+        pn::data_view bytes = in.read_data(in.read(8));
+        return pn::string_view{reinterpret_cast<const char*>(bytes.data()), bytes.size()};
+    }
+
+    const pn::string      _root;
+    const pn::string      _path;
+    const clock::duration _interval;
+    clock::time_point     _next_save;
+};
+
+sha1::digest digest_tree(
+        pn::string_view path, tree_checkpoint* checkpoint, const DigestObserver* observer) {
     if (!path::isdir(path)) {
-        return file_digest(path);
+        return file_digest(path, DIGEST_DENSE, observer);
     }
     struct digestWalker : TreeWalker {
         // For files, hash the size and bytes of their UTF-8-encoded path, followed by the size and
         // bytes of the file content.  We don't worry about the mode or owner of the file, just as
         // we wouldn't if taking the digest of a file.
         void file(pn::string_view path, const Stat&) const {
-            pn::data_view path_bytes{
-                    reinterpret_cast<const uint8_t*>(path.data() + prefix_size),
-                    path.size() - prefix_size};
-            sha.write<uint64_t>(path_bytes.size());
-            sha.write(path_bytes);
+            pn::string_view relative = path.substr(prefix_size);
+
+            // Files up to the checkpoint were hashed before the digest was interrupted.  They're
+            // found by their path, not its order, which may differ between platforms.
+            if (skipping) {
+                skipping = (relative != resume_after);
+                return;
+            }
 
+            sha.write<uint64_t>(relative.size());
+            sha.write(as_bytes(relative));
+
+            if (meter) {
+                meter->start_file(path);
+            }
             mapped_file file(path);
-            sha.write<uint64_t>(file.data().size());
-            sha.write(file.data());
+            sha.write<uint64_t>(file.size());
+            write_dense(sha, file, meter);
+            if (meter) {
+                meter->end_file();
+            }
+            if (checkpoint) {
+                checkpoint->file_done(relative, sha);
+            }
         }
 
         // Ignore empty directories.  Directories which are not empty will be included in the
@@ -229,19 +595,657 @@ sha1::digest tree_digest(pn::string_view path) {
             static_cast<void>(stat);
         }
 
-        sha1&     sha;
-        const int prefix_size;
-        digestWalker(sha1& sha, int prefix_size) : sha(sha), prefix_size(prefix_size) {}
+        sha1&            sha;
+        const int        prefix_size;
+        pn::string_view  resume_after;
+        mutable bool     skipping;
+        tree_checkpoint* checkpoint;
+        progress_meter*  meter;
+        digestWalker(
+                sha1& sha, int prefix_size, pn::string_view resume_after,
+                tree_checkpoint* checkpoint, progress_meter* meter)
+                : sha(sha),
+                  prefix_size(prefix_size),
+                  resume_after(resume_after),
+                  skipping(!resume_after.empty()),
+                  checkpoint(checkpoint),
+                  meter(meter) {}
     };
-    sha1 sha;
-    walk(path, WALK_LOGICAL, digestWalker(sha, path.size() + 1));
+    std::unique_ptr<progress_meter> meter;
+    if (observer) {
+        meter.reset(new progress_meter(*observer));
+    }
+    sha1       sha;
+    pn::string resume_after;
+    if (checkpoint) {
+        resume_after = checkpoint->load(sha);
+    }
+    digestWalker walker(sha, path.size() + 1, resume_after, checkpoint, meter.get());
+    walk(path, WALK_LOGICAL, walker);
+    if (walker.skipping) {
+        pn::string missing = path::join(path, pn::string_view{resume_after});
+        throw std::runtime_error(pn::format("{0}: checkpoint file is missing", missing).c_str());
+    }
+    if (meter) {
+        meter->finish();
+    }
     return sha.compute();
 }
 
+}  // namespace
+
+sha1::digest tree_digest(pn::string_view path, const DigestObserver* observer) {
+    return digest_tree(path, nullptr, observer);
+}
+
+sha1::digest resumable_tree_digest(
+        pn::string_view path, pn::string_view checkpoint,
+        std::chrono::steady_clock::duration interval, const DigestObserver* observer) {
+    tree_checkpoint saver(path, checkpoint, interval);
+    sha1::digest    digest = digest_tree(path, &saver, observer);
+    saver.remove();
+    return digest;
+}
+
 bool operator==(const sha1::digest& lhs, const sha1::digest& rhs) {
     return memcmp(lhs.d, rhs.d, 5 * sizeof(uint32_t)) == 0;
 }
 
 bool operator!=(const sha1::digest& lhs, const sha1::digest& rhs) { return !(lhs == rhs); }
 
+namespace {
+
+// The CRC-32C polynomial, in reversed bit order.  In this representation, the most-significant
+// bit of a 32-bit word is the coefficient of x^0, and the least-significant is that of x^31.
+const uint32_t kCrc32cPoly = 0x82f63b78;
+
+// Multiplies `a` by `b` modulo the CRC-32C polynomial.
+inline uint32_t crc32c_multmodp(uint32_t a, uint32_t b) {
+    uint32_t p = 0;
+    for (uint32_t m = uint32_t{1} << 31; m != 0; m >>= 1) {
+        if (a & m) {
+            p ^= b;
+        }
+        b = (b & 1) ? ((b >> 1) ^ kCrc32cPoly) : (b >> 1);
+    }
+    return p;
+}
+
+// Computes x^n modulo the CRC-32C polynomial.  Multiplying a checksum by x^(8*k) is equivalent
+// to appending `k` zero bytes to the data it was computed from.
+uint32_t crc32c_xnmodp(uint64_t n) {
+    uint32_t p      = uint32_t{1} << 31;  // x^0
+    uint32_t square = uint32_t{1} << 30;  // x^1, x^2, x^4, ...
+    for (; n != 0; n >>= 1) {
+        if (n & 1) {
+            p = crc32c_multmodp(square, p);
+        }
+        square = crc32c_multmodp(square, square);
+    }
+    return p;
+}
+
+// Lookup tables for the portable implementation, which processes 8 bytes per step ("slicing by
+// 8").  table[0] is the classic byte-at-a-time table; table[k] advances table[0] by k more bytes.
+struct crc32c_tables {
+    uint32_t table[8][256];
+
+    crc32c_tables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 1) ? ((crc >> 1) ^ kCrc32cPoly) : (crc >> 1);
+            }
+            table[0][i] = crc;
+        }
+        for (int k = 1; k < 8; ++k) {
+            for (int i = 0; i < 256; ++i) {
+                table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+            }
+        }
+    }
+};
+
+uint32_t crc32c_portable(uint32_t crc, const uint8_t* p, size_t n) {
+    static const crc32c_tables tables;
+    const auto&                t = tables.table;
+    for (; n >= 8; n -= 8, p += 8) {
+        uint32_t lo = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t{p[3]} << 24));
+        uint32_t hi = p[4] | (p[5] << 8) | (p[6] << 16) | (uint32_t{p[7]} << 24);
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    }
+    for (; n > 0; --n, ++p) {
+        crc = t[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(SFZ_CRC32C_X86) || defined(SFZ_CRC32C_ARM)
+
+#ifdef SFZ_CRC32C_X86
+
+#define SFZ_CRC32C_TARGET __attribute__((target("sse4.2,pclmul")))
+
+bool crc32c_hardware_available() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul");
+}
+
+SFZ_CRC32C_TARGET inline uint32_t crc32c_u8(uint32_t crc, uint8_t byte) {
+    return _mm_crc32_u8(crc, byte);
+}
+
+SFZ_CRC32C_TARGET inline uint32_t crc32c_u64(uint32_t crc, uint64_t word) {
+    return _mm_crc32_u64(crc, word);
+}
+
+// The carry-less product of two reversed 32-bit polynomials is a reversed 63-bit polynomial,
+// which the crc32 instruction then reduces, multiplying by another x^33 in the process.  Shift
+// constants are therefore computed as x^(8*n - 33) rather than x^(8*n).
+const uint64_t kCrc32cShiftBias = 33;
+
+SFZ_CRC32C_TARGET inline uint32_t crc32c_shift(uint32_t crc, uint32_t shift) {
+    __m128i product =
+            _mm_clmulepi64_si128(_mm_cvtsi32_si128(crc), _mm_cvtsi32_si128(shift), 0x00);
+    return _mm_crc32_u64(0, _mm_cvtsi128_si64(product));
+}
+
+#else  // SFZ_CRC32C_ARM
+
+#define SFZ_CRC32C_TARGET
+
+bool crc32c_hardware_available() { return true; }
+
+inline uint32_t crc32c_u8(uint32_t crc, uint8_t byte) { return __crc32cb(crc, byte); }
+inline uint32_t crc32c_u64(uint32_t crc, uint64_t word) { return __crc32cd(crc, word); }
+
+// Shifting is done in software.  It happens once per 3 lanes, so its cost is amortized.
+const uint64_t kCrc32cShiftBias = 0;
+
+inline uint32_t crc32c_shift(uint32_t crc, uint32_t shift) {
+    return crc32c_multmodp(shift, crc);
+}
+
+#endif  // SFZ_CRC32C_X86
+
+// The crc32 instructions have a latency of 3 cycles but a throughput of 1 per cycle, so a single
+// dependency chain uses only a third of the available throughput.  Instead, split the input into
+// three adjacent lanes, checksum them independently, and shift each lane's checksum past the
+// lanes that follow it before combining them.
+const size_t kCrc32cLongLane  = 8192;
+const size_t kCrc32cShortLane = 256;
+
+struct crc32c_shifts {
+    uint32_t long1, long2, short1, short2;
+
+    crc32c_shifts()
+            : long1(crc32c_xnmodp(8 * kCrc32cLongLane - kCrc32cShiftBias)),
+              long2(crc32c_xnmodp(16 * kCrc32cLongLane - kCrc32cShiftBias)),
+              short1(crc32c_xnmodp(8 * kCrc32cShortLane - kCrc32cShiftBias)),
+              short2(crc32c_xnmodp(16 * kCrc32cShortLane - kCrc32cShiftBias)) {}
+};
+
+inline uint64_t load_u64(const uint8_t* p) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+// Consumes as many groups of three `lane`-byte lanes as possible from the front of `*data`.
+SFZ_CRC32C_TARGET uint32_t crc32c_lanes(
+        uint32_t crc, const uint8_t** data, size_t* size, size_t lane, uint32_t shift1,
+        uint32_t shift2) {
+    const uint8_t* p = *data;
+    size_t         n = *size;
+    for (; n >= 3 * lane; n -= 3 * lane) {
+        uint32_t       crc0 = crc, crc1 = 0, crc2 = 0;
+        const uint8_t* end  = p + lane;
+        for (; p != end; p += 8) {
+            crc0 = crc32c_u64(crc0, load_u64(p));
+            crc1 = crc32c_u64(crc1, load_u64(p + lane));
+            crc2 = crc32c_u64(crc2, load_u64(p + 2 * lane));
+        }
+        crc = crc32c_shift(crc0, shift2) ^ crc32c_shift(crc1, shift1) ^ crc2;
+        p += 2 * lane;
+    }
+    *data = p;
+    *size = n;
+    return crc;
+}
+
+SFZ_CRC32C_TARGET uint32_t crc32c_hardware(uint32_t crc, const uint8_t* p, size_t n) {
+    static const crc32c_shifts shifts;
+    for (; (n > 0) && (reinterpret_cast<uintptr_t>(p) & 7); --n, ++p) {
+        crc = crc32c_u8(crc, *p);
+    }
+    crc = crc32c_lanes(crc, &p, &n, kCrc32cLongLane, shifts.long1, shifts.long2);
+    crc = crc32c_lanes(crc, &p, &n, kCrc32cShortLane, shifts.short1, shifts.short2);
+    for (; n >= 8; n -= 8, p += 8) {
+        crc = crc32c_u64(crc, load_u64(p));
+    }
+    for (; n > 0; --n, ++p) {
+        crc = crc32c_u8(crc, *p);
+    }
+    return crc;
+}
+
+#undef SFZ_CRC32C_TARGET
+
+#endif  // SFZ_CRC32C_X86 || SFZ_CRC32C_ARM
+
+uint32_t crc32c_update(uint32_t crc, const uint8_t* p, size_t n) {
+#if defined(SFZ_CRC32C_X86) || defined(SFZ_CRC32C_ARM)
+    static const bool hardware = crc32c_hardware_available();
+    if (hardware) {
+        return crc32c_hardware(crc, p, n);
+    }
+#endif
+    return crc32c_portable(crc, p, n);
+}
+
+}  // namespace
+
+crc32c::crc32c() { reset(); }
+
+void crc32c::reset() { _crc = 0xffffffff; }
+
+void crc32c::write(pn::data_view input) {
+    _crc = crc32c_update(_crc, input.data(), input.size());
+}
+
+uint32_t crc32c::combine(uint32_t crc1, uint32_t crc2, uint64_t size2) {
+    return crc32c_multmodp(crc32c_xnmodp(8 * size2), crc1) ^ crc2;
+}
+
+namespace git {
+
+namespace {
+
+void write_header(sha1& sha, pn::string_view type, uint64_t size) {
+    const uint8_t nul = 0;
+    sha.write(as_bytes(pn::format("{0} {1}", type, static_cast<int64_t>(size))));
+    sha.write(pn::data_view{&nul, 1});
+}
+
+// Compares entries in the order of a tree object.
+bool entry_less(const tree_entry* lhs, const tree_entry* rhs) {
+    pn::string_view a = lhs->name, b = rhs->name;
+    int             n = std::min(a.size(), b.size());
+    int             c = memcmp(a.data(), b.data(), n);
+    if (c != 0) {
+        return c < 0;
+    }
+    uint8_t a_end = (a.size() > n) ? a.data()[n] : (lhs->mode == MODE_TREE) ? '/' : 0;
+    uint8_t b_end = (b.size() > n) ? b.data()[n] : (rhs->mode == MODE_TREE) ? '/' : 0;
+    return a_end < b_end;
+}
+
+// An entry in .git/index, with the stat data that git recorded for the file.
+struct index_entry {
+    pn::string   path;
+    uint32_t     ctime_s, ctime_ns, mtime_s, mtime_ns, ino, mode, size;
+    sha1::digest id;
+};
+
+// Reads a NUL-terminated path.
+pn::string read_path(byte_reader& in) {
+    pn::data path;
+    while (uint8_t ch = in.read(1)) {
+        path += pn::data_view{&ch, 1};
+    }
+    return pn::data_view{path}.as_string().copy();
+}
+
+// Reads the entries of a git index (versions 2 through 4), in sorted order by path.  Unmerged
+// entries and intent-to-add entries have no usable blob id, so they're omitted.
+std::vector<index_entry> read_index(pn::string_view path, const mapped_file& file) {
+    byte_reader in{file.data()};
+    if (in.read(4) != 0x44495243) {  // "DIRC"
+        throw std::runtime_error(pn::format("{0}: not a git index", path).c_str());
+    }
+    const uint64_t version = in.read(4);
+    if ((version < 2) || (version > 4)) {
+        pn::string message = pn::format(
+                "{0}: unsupported index version {1}", path, static_cast<int64_t>(version));
+        throw std::runtime_error(message.c_str());
+    }
+    const uint64_t count = in.read(4);
+
+    std::vector<index_entry> entries;
+    pn::string               previous;
+    for (uint64_t i = 0; i < count; ++i) {
+        index_entry e;
+        e.ctime_s  = in.read(4);
+        e.ctime_ns = in.read(4);
+        e.mtime_s  = in.read(4);
+        e.mtime_ns = in.read(4);
+        in.read(4);  // dev
+        e.ino  = in.read(4);
+        e.mode = in.read(4);
+        in.read(8);  // uid, gid
+        e.size = in.read(4);
+        e.id   = sha1::digest{in.read_data(20)};
+
+        const uint64_t flags    = in.read(2);
+        const bool     extended = (version >= 3) && (flags & 0x4000);
+        const uint64_t extra    = extended ? in.read(2) : 0;
+        const bool     stage    = (flags & 0x3000) != 0;
+        const bool     ita      = (extra & 0x2000) != 0;
+
+        if (version == 4) {
+            // The path is the previous path, minus some number of bytes, plus a suffix.
+            uint64_t c     = in.read(1);
+            uint64_t strip = c & 0x7f;
+            while (c & 0x80) {
+                c     = in.read(1);
+                strip = ((strip + 1) << 7) | (c & 0x7f);
+            }
+            if (strip > static_cast<uint64_t>(previous.size())) {
+                throw std::runtime_error(pn::format("{0}: corrupt index", path).c_str());
+            }
+            e.path = previous.substr(0, previous.size() - strip).copy();
+            e.path += read_path(in);
+        } else {
+            // The path is padded with 1-8 NULs, to a multiple of 8 bytes from the start of the
+            // entry, which has 62 bytes of fixed-size fields (64, if extended).
+            e.path    = read_path(in);
+            int fixed = extended ? 64 : 62;
+            in.read_data(7 - ((fixed + e.path.size()) % 8));
+        }
+        previous = e.path.copy();
+
+        if (!stage && !ita) {
+            entries.push_back(std::move(e));
+        }
+    }
+    return entries;
+}
+
+// Orders index entries by path, bytewise, as git does.
+bool path_less(const index_entry& e, pn::string_view path) {
+    pn::string_view a = e.path;
+    int             c = memcmp(a.data(), path.data(), std::min(a.size(), path.size()));
+    return (c < 0) || ((c == 0) && (a.size() < path.size()));
+}
+
+// Returns true if `st` matches the stat data recorded in `e`, so that the file can be assumed to
+// be unchanged since git hashed it.  `index_st` is the stat data of the index itself.
+bool is_clean(const index_entry& e, const Stat& st, EntryMode mode, const Stat& index_st) {
+#ifdef _WIN32
+    // Windows doesn't provide inode numbers or sub-second times through stat().
+    static_cast<void>(e);
+    static_cast<void>(st);
+    static_cast<void>(mode);
+    static_cast<void>(index_st);
+    return false;
+#else
+#ifdef __APPLE__
+    const struct timespec& mtime       = st.st_mtimespec;
+    const struct timespec& ctime       = st.st_ctimespec;
+    const struct timespec& index_mtime = index_st.st_mtimespec;
+#else
+    const struct timespec& mtime       = st.st_mtim;
+    const struct timespec& ctime       = st.st_ctim;
+    const struct timespec& index_mtime = index_st.st_mtim;
+#endif
+    if ((e.mode != mode) || (e.size != static_cast<uint32_t>(st.st_size)) ||
+        (e.ino != static_cast<uint32_t>(st.st_ino)) ||
+        (e.mtime_s != static_cast<uint32_t>(mtime.tv_sec)) ||
+        (e.ctime_s != static_cast<uint32_t>(ctime.tv_sec))) {
+        return false;
+    }
+
+    // Git records nanoseconds only if built to; if it didn't, compare seconds only.
+    if ((e.mtime_ns && (e.mtime_ns != static_cast<uint32_t>(mtime.tv_nsec))) ||
+        (e.ctime_ns && (e.ctime_ns != static_cast<uint32_t>(ctime.tv_nsec)))) {
+        return false;
+    }
+
+    // A file modified in the same second the index was written may have changed after git
+    // hashed it, without changing its stat data ("racy git").
+    return static_cast<uint32_t>(index_mtime.tv_sec) > e.mtime_s;
+#endif
+}
+
+// Stats `path` into `st`, as walk() does on each platform.
+bool stat_path(pn::string_view path, Stat* st) {
+#ifdef _WIN32
+    return _wstat(path.cpp_wstr().c_str(), st) == 0;
+#else
+    return stat(path.copy().c_str(), st) == 0;
+#endif
+}
+
+// Reads the first line of a file, such as HEAD, without its line ending.
+pn::string read_line(pn::string_view path) {
+    mapped_file     file(path);
+    pn::string_view text = file.string();
+    int             size = 0;
+    while ((size < text.size()) && (text.data()[size] != '\n') && (text.data()[size] != '\r')) {
+        ++size;
+    }
+    return text.substr(0, size).copy();
+}
+
+// Looks `ref` up in the packed-refs file of the repository at `git_dir`, whose lines are an
+// object id and a ref name, separated by a space.
+bool find_packed_ref(pn::string_view git_dir, pn::string_view ref, pn::string* id) {
+    const pn::string path = path::join(git_dir, "packed-refs");
+    if (!path::isfile(path)) {
+        return false;
+    }
+    mapped_file     file(path);
+    pn::string_view text = file.string();
+    for (int begin = 0, end = 0; begin < text.size(); begin = end + 1) {
+        for (end = begin; (end < text.size()) && (text.data()[end] != '\n'); ++end) {
+        }
+        pn::string_view line = text.substr(begin, end - begin);
+        if ((line.size() == (41 + ref.size())) && (line.substr(41) == ref)) {
+            *id = line.substr(0, 40).copy();
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns the commit that the checkout at `path` has checked out, by which git records a
+// submodule in a tree.  `path`/.git is either the git directory, or a file giving its path.
+sha1::digest head_commit(pn::string_view path) {
+    pn::string git_dir = path::join(path, ".git");
+    if (!path::isdir(git_dir)) {
+        const pn::string line = read_line(git_dir);
+        if (line.substr(0, 8) != "gitdir: ") {
+            throw std::runtime_error(pn::format("{0}: not a git directory", git_dir).c_str());
+        }
+        const pn::string_view target   = line.substr(8);
+        const bool            absolute = !path::splitdrive(target).first.empty() ||
+                                         (!target.empty() && is_path_separator(target.data()[0]));
+        git_dir = absolute ? target.copy() : path::join(path, target);
+    }
+
+    // Refs may be shared with the main worktree, through a commondir file.
+    pn::string       common_dir  = git_dir.copy();
+    const pn::string common_path = path::join(git_dir, "commondir");
+    if (path::isfile(common_path)) {
+        common_dir = path::join(git_dir, pn::string_view{read_line(common_path)});
+    }
+
+    pn::string id = read_line(path::join(git_dir, "HEAD"));
+    for (int depth = 0; id.substr(0, 5) == "ref: "; ++depth) {
+        const pn::string      name = id.substr(5).copy();
+        const pn::string_view ref{name};
+        if (depth == 5) {
+            throw std::runtime_error(pn::format("{0}: too many levels of refs", ref).c_str());
+        } else if (path::isfile(path::join(git_dir, ref))) {
+            id = read_line(path::join(git_dir, ref));
+        } else if (path::isfile(path::join(common_dir, ref))) {
+            id = read_line(path::join(common_dir, ref));
+        } else if (!find_packed_ref(common_dir, ref, &id)) {
+            throw std::runtime_error(pn::format("{0}: no commit checked out", path).c_str());
+        }
+    }
+    if (id.size() != 40) {
+        throw std::runtime_error(pn::format("{0}: invalid HEAD", path).c_str());
+    }
+    return sha1::digest{hex::decode(id)};
+}
+
+}  // namespace
+
+sha1::digest object_digest(pn::string_view type, pn::data_view content) {
+    sha1 sha;
+    write_header(sha, type, content.size());
+    sha.write(content);
+    return sha.compute();
+}
+
+sha1::digest blob_digest(pn::data_view content) { return object_digest("blob", content); }
+
+pn::data tree_object(const std::vector<tree_entry>& entries) {
+    std::vector<const tree_entry*> sorted;
+    sorted.reserve(entries.size());
+    for (const tree_entry& e : entries) {
+        sorted.push_back(&e);
+    }
+    std::sort(sorted.begin(), sorted.end(), entry_less);
+
+    pn::data content;
+    for (const tree_entry* e : sorted) {
+        char mode[16];
+        snprintf(mode, sizeof(mode), "%o ", static_cast<unsigned int>(e->mode));
+        const uint8_t nul = 0;
+        content += as_bytes(mode);
+        content += as_bytes(e->name);
+        content += pn::data_view{&nul, 1};
+        content += e->id.data();
+    }
+    return content;
+}
+
+sha1::digest file_digest(pn::string_view path) {
+    mapped_file file(path);
+    sha1        sha;
+    write_header(sha, "blob", file.size());
+    write_dense(sha, file, nullptr);
+    return sha.compute();
+}
+
+sha1::digest tree_digest(pn::string_view path) {
+    if (!path::isdir(path)) {
+        throw std::runtime_error(pn::format("{0}: not a directory", path).c_str());
+    }
+
+    std::vector<index_entry> index;
+    Stat                     index_st;
+    pn::string               index_path = path::join(path, ".git", "index");
+    if (path::isfile(index_path) && stat_path(index_path, &index_st)) {
+        mapped_file file(index_path);
+        index = read_index(index_path, file);
+    }
+
+    struct gitWalker : TreeWalker {
+        // Each directory being visited has a frame, to which its entries are added.  When a
+        // directory is complete, its tree is hashed and added to its parent's frame.
+        void pre_directory(pn::string_view path, const Stat&) const {
+            if (skip || is_dot_git(path)) {
+                ++skip;
+                return;
+            } else if (!frames.empty() && path::exists(path::join(path, ".git"))) {
+                // Git records a nested checkout, such as a submodule, as a gitlink to the commit
+                // it has checked out, and doesn't look inside.
+                add(MODE_GITLINK, path, head_commit(path));
+                ++skip;
+                return;
+            }
+            frames.emplace_back();
+        }
+
+        void post_directory(pn::string_view path, const Stat&) const {
+            if (skip) {
+                --skip;
+                return;
+            }
+            std::vector<tree_entry> entries = std::move(frames.back());
+            frames.pop_back();
+            sha1::digest id = object_digest("tree", tree_object(entries));
+            if (frames.empty()) {
+                *root_id = id;
+            } else if (!entries.empty()) {
+                // Git doesn't store empty trees, except at the root.
+                add(MODE_TREE, path, id);
+            }
+        }
+
+        void file(pn::string_view path, const Stat& st) const {
+            if (skip || is_dot_git(path)) {
+                return;
+            }
+            EntryMode mode = (st.st_mode & 0100) ? MODE_EXECUTABLE : MODE_FILE;  // u+x
+            if (const index_entry* e = cached(path, st, mode)) {
+                add(mode, path, e->id);
+            } else {
+                add(mode, path, file_digest(path));
+            }
+        }
+
+        void symlink(pn::string_view path, const Stat&) const {
+            if (skip || is_dot_git(path)) {
+                return;
+            }
+            add(MODE_SYMLINK, path, blob_digest(as_bytes(readlink(path))));
+        }
+        void broken_symlink(pn::string_view path, const Stat& st) const { symlink(path, st); }
+
+        // Git skips sockets, FIFOs, and devices, and can't see cycles without following links.
+        void other(pn::string_view path, const Stat& stat) const {
+            static_cast<void>(path);
+            static_cast<void>(stat);
+        }
+        void cycle_directory(pn::string_view path, const Stat& stat) const {
+            static_cast<void>(path);
+            static_cast<void>(stat);
+        }
+
+        // Git ignores anything named .git, whatever its type.
+        static bool is_dot_git(pn::string_view path) { return path::basename(path) == ".git"; }
+
+        void add(EntryMode mode, pn::string_view path, const sha1::digest& id) const {
+            frames.back().push_back(tree_entry{mode, path::basename(path).copy(), id});
+        }
+
+        // Returns the index entry for `path`, if its stat data shows it to be unchanged.
+        const index_entry* cached(pn::string_view path, const Stat& st, EntryMode mode) const {
+            pn::string_view relative = path.substr(prefix_size);
+            auto it = std::lower_bound(index.begin(), index.end(), relative, path_less);
+            if ((it == index.end()) || (pn::string_view{it->path} != relative) ||
+                !is_clean(*it, st, mode, index_st)) {
+                return nullptr;
+            }
+            return &*it;
+        }
+
+        const std::vector<index_entry>&              index;
+        const Stat&                                  index_st;
+        const int                                    prefix_size;
+        sha1::digest*                                root_id;
+        mutable std::vector<std::vector<tree_entry>> frames;
+        mutable int                                  skip;
+        gitWalker(
+                const std::vector<index_entry>& index, const Stat& index_st, int prefix_size,
+                sha1::digest* root_id)
+                : index(index),
+                  index_st(index_st),
+                  prefix_size(prefix_size),
+                  root_id(root_id),
+                  skip(0) {}
+    };
+
+    sha1::digest id;
+    walk(path, WALK_PHYSICAL, gitWalker(index, index_st, path.size() + 1, &id));
+    return id;
+}
+
+}  // namespace git
+
 }  // namespace sfz
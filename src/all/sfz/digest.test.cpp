@@ -7,13 +7,24 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <cstring>
 #include <sfz/digest.hpp>
 #include <sfz/file.hpp>
 #include <sfz/os.hpp>
 #include <sfz/range.hpp>
+#include <stdexcept>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/time.h>
+#include <unistd.h>
+#endif
 
 using testing::Eq;
+using testing::Ge;
+using testing::Gt;
+using testing::Ne;
 using testing::NotNull;
 
 namespace sfz {
@@ -209,6 +220,119 @@ TEST_F(Sha1Test, Print) {
     EXPECT_THAT(kEmptyDigest.hex(), Eq("da39a3ee5e6b4b0d3255bfef95601890afd80709"));
 }
 
+TEST_F(Sha1Test, SaveRestore) {
+    pn::string_view input =
+            "The quick brown fox jumps over the lazy dog, "
+            "and then over the lazy dog again, and again";
+    sha1            expected;
+    expected.write(pn::data_view{reinterpret_cast<const uint8_t*>(input.data()), input.size()});
+
+    for (int split : {0, 1, 63, 64, 65, input.size()}) {
+        sha1 first;
+        first.write(pn::data_view{reinterpret_cast<const uint8_t*>(input.data()), split});
+        pn::data state = first.save();
+
+        sha1 second;
+        second.write(pn::data_view{reinterpret_cast<const uint8_t*>("junk"), 4});
+        second.restore(state);
+        second.write(pn::data_view{
+                reinterpret_cast<const uint8_t*>(input.data()) + split, input.size() - split});
+        EXPECT_THAT(second.compute(), Eq(expected.compute())) << split;
+    }
+
+    sha1     sha;
+    pn::data state = sha.save();
+    EXPECT_THROW(sha.restore(pn::data_view{state.data(), state.size() - 1}), std::runtime_error);
+    state += pn::data_view{reinterpret_cast<const uint8_t*>("x"), 1};
+    EXPECT_THROW(sha.restore(state), std::runtime_error);
+}
+
+using Crc32cTest = ::testing::Test;
+
+// Builds a deterministic, non-repeating-looking input of `size` bytes.
+pn::data crc32c_input(int size) {
+    pn::data data;
+    for (int i : range(size)) {
+        uint8_t byte = (i * 31) ^ (i >> 7);
+        data += pn::data_view{&byte, 1};
+    }
+    return data;
+}
+
+// The empty string should have a checksum of 0.
+TEST_F(Crc32cTest, Empty) {
+    crc32c crc;
+    EXPECT_THAT(crc.compute(), Eq(0x00000000u));
+}
+
+// Check values from RFC 3720, section B.4, and the customary "123456789" check value.
+TEST_F(Crc32cTest, KnownValues) {
+    uint8_t bytes[32];
+
+    crc32c crc;
+    memset(bytes, 0x00, 32);
+    crc.write(pn::data_view{bytes, 32});
+    EXPECT_THAT(crc.compute(), Eq(0x8a9136aau));
+
+    crc.reset();
+    memset(bytes, 0xff, 32);
+    crc.write(pn::data_view{bytes, 32});
+    EXPECT_THAT(crc.compute(), Eq(0x62a8ab43u));
+
+    crc.reset();
+    for (int i : range(32)) {
+        bytes[i] = i;
+    }
+    crc.write(pn::data_view{bytes, 32});
+    EXPECT_THAT(crc.compute(), Eq(0x46dd794eu));
+
+    crc.reset();
+    for (int i : range(32)) {
+        bytes[i] = 31 - i;
+    }
+    crc.write(pn::data_view{bytes, 32});
+    EXPECT_THAT(crc.compute(), Eq(0x113fdb5cu));
+
+    crc.reset();
+    crc.write("123456789");
+    EXPECT_THAT(crc.compute(), Eq(0xe3069283u));
+}
+
+// A long input is split into interleaved lanes internally; the result must not depend on how the
+// input was split, or on its alignment.
+TEST_F(Crc32cTest, Long) {
+    const pn::data input = crc32c_input(100000);
+
+    crc32c whole;
+    whole.write(input);
+    EXPECT_THAT(whole.compute(), Eq(0x7f545ed6u));
+
+    crc32c bytewise;
+    for (uint8_t byte : input) {
+        bytewise.write(pn::data_view{&byte, 1});
+    }
+    EXPECT_THAT(bytewise.compute(), Eq(0x7f545ed6u));
+
+    crc32c unaligned;
+    unaligned.write(pn::data_view{input.data(), 3});
+    unaligned.write(pn::data_view{input.data() + 3, input.size() - 3});
+    EXPECT_THAT(unaligned.compute(), Eq(0x7f545ed6u));
+}
+
+// Checksums of adjacent chunks can be combined into the checksum of the whole.
+TEST_F(Crc32cTest, Combine) {
+    const pn::data input = crc32c_input(100000);
+    for (int split : {0, 1, 7, 256, 8192, 50000, 99999, 100000}) {
+        crc32c first, second;
+        first.write(pn::data_view{input.data(), split});
+        second.write(pn::data_view{input.data() + split, input.size() - split});
+        EXPECT_THAT(
+                crc32c::combine(first.compute(), second.compute(), input.size() - split),
+                Eq(0x7f545ed6u))
+                << split;
+    }
+}
+
 struct TreeData {
     const char*  path;
     const char*  data;
@@ -274,6 +398,340 @@ TEST_F(Sha1Test, TreeDigest) {
     }
     EXPECT_THAT(tree_digest(dir.path()), Eq(kTreeDigest));
 }
+
+// Writes `size` bytes to `path`: zero, apart from `segments`.  If `sparse`, the zeroes are left
+// as holes, where the filesystem supports them.
+void write_sparse_file(
+        pn::string_view path, uint64_t size,
+        const std::vector<std::pair<uint64_t, pn::string_view>>& segments, bool sparse) {
+    int fd = open(path.copy().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    ASSERT_THAT(fd, Ge(0));
+    if (!sparse) {
+        const uint8_t zeroes[4096] = {};
+        for (uint64_t offset = 0; offset < size; offset += sizeof(zeroes)) {
+            size_t n = std::min<uint64_t>(size - offset, sizeof(zeroes));
+            ASSERT_THAT(pwrite(fd, zeroes, n, offset), Eq<ssize_t>(n));
+        }
+    }
+    for (const auto& segment : segments) {
+        ASSERT_THAT(
+                pwrite(fd, segment.second.data(), segment.second.size(), segment.first),
+                Eq<ssize_t>(segment.second.size()));
+    }
+    ASSERT_THAT(ftruncate(fd, size), Eq(0));
+    close(fd);
+}
+
+TEST_F(Sha1Test, SparseFile) {
+    TemporaryDirectory dir("sha1-test");
+    pn::string         sparse = pn::format("{0}/sparse", dir.path());
+    pn::string         dense  = pn::format("{0}/dense", dir.path());
+    pn::string         zeroes = pn::format("{0}/zeroes", dir.path());
+    pn::string         holes  = pn::format("{0}/holes", dir.path());
+
+    const uint64_t                                    size     = 4 << 20;
+    std::vector<std::pair<uint64_t, pn::string_view>> segments = {
+            {1 << 20, "data in the middle"},
+            {(3 << 20) + 65530, "data across a block boundary"},
+            {size - 4, "end"},
+    };
+    write_sparse_file(sparse, size, segments, true);
+    write_sparse_file(dense, size, segments, false);
+    write_sparse_file(zeroes, size, {}, false);
+    write_sparse_file(holes, size, {}, true);
+
+    // In dense mode, holes hash the same as zeroes.
+    sha1        expected;
+    mapped_file dense_file(dense);
+    expected.write(dense_file.data());
+    EXPECT_THAT(file_digest(sparse), Eq(expected.compute()));
+    EXPECT_THAT(file_digest(dense), Eq(expected.compute()));
+    EXPECT_THAT(file_digest(holes), Eq(file_digest(zeroes)));
+
+    // In sparse mode, the digest doesn't depend on how the zeroes are stored either, but it
+    // does depend on the size and content.
+    EXPECT_THAT(file_digest(sparse, DIGEST_SPARSE), Eq(file_digest(dense, DIGEST_SPARSE)));
+    EXPECT_THAT(file_digest(holes, DIGEST_SPARSE), Eq(file_digest(zeroes, DIGEST_SPARSE)));
+    EXPECT_THAT(file_digest(sparse, DIGEST_SPARSE), Ne(file_digest(sparse)));
+    EXPECT_THAT(
+            file_digest(sparse, DIGEST_SPARSE), Ne(file_digest(holes, DIGEST_SPARSE)));
+    write_sparse_file(holes, size + 1, {}, true);
+    EXPECT_THAT(
+            file_digest(holes, DIGEST_SPARSE), Ne(file_digest(zeroes, DIGEST_SPARSE)));
+}
+
+// Files too large for a pn::data_view are hashed in pieces.  Only the block with data is read in
+// sparse mode, so the file can be large without the test being slow.
+TEST_F(Sha1Test, LargeFile) {
+    TemporaryDirectory dir("sha1-test");
+    pn::string         path = pn::format("{0}/large", dir.path());
+
+    const uint64_t size   = (5ull << 30) + 3;
+    const uint64_t offset = (4ull << 30) + 5;
+    write_sparse_file(path, size, {{offset, "end"}}, true);
+
+    uint8_t block[64 * 1024] = {};
+    memcpy(block + (offset % sizeof(block)), "end", 3);
+    sha1 expected;
+    expected.write<uint64_t>(size);
+    expected.write<uint64_t>(offset / sizeof(block));
+    expected.write(pn::data_view{block, sizeof(block)});
+    EXPECT_THAT(file_digest(path, DIGEST_SPARSE), Eq(expected.compute()));
+}
+
+// Records every report it receives.
+class RecordingObserver : public DigestObserver {
+  public:
+    RecordingObserver() : DigestObserver(std::chrono::steady_clock::duration::zero()) {}
+
+    void progress(const DigestProgress& progress) const {
+        reports.push_back({progress.bytes, progress.files, progress.path.copy(),
+                           progress.io_seconds, progress.compute_seconds});
+    }
+
+    struct report {
+        uint64_t   bytes;
+        uint64_t   files;
+        pn::string path;
+        double     io_seconds;
+        double     compute_seconds;
+    };
+    mutable std::vector<report> reports;
+};
+
+TEST_F(Sha1Test, Progress) {
+    TemporaryDirectory dir("sha1-test");
+
+    uint64_t total = 0;
+    for (const TreeData& tree_data : kTreeData) {
+        pn::string      path = pn::format("{0}/{1}", dir.path(), tree_data.path);
+        pn::string_view data = tree_data.data;
+        makedirs(path::dirname(path), 0700);
+        pn::output out = pn::output{path, pn::binary};
+        ASSERT_THAT(out.c_obj(), NotNull());
+        ASSERT_THAT(out.write(data), Eq(true));
+        total += data.size();
+    }
+
+    // With no rate limit, each file is reported at least as it completes.
+    RecordingObserver observer;
+    EXPECT_THAT(tree_digest(dir.path(), &observer), Eq(kTreeDigest));
+    uint64_t files = 0;
+    for (const auto& report : observer.reports) {
+        EXPECT_THAT(report.files, testing::AnyOf(Eq(files), Eq(files + 1)));
+        files = report.files;
+    }
+    EXPECT_THAT(observer.reports.back().bytes, Eq(total));
+    EXPECT_THAT(observer.reports.back().files, Eq<uint64_t>(5));
+    EXPECT_THAT(
+            pn::string_view{observer.reports.back().path}.substr(0, dir.path().size()),
+            Eq(pn::string_view{dir.path()}));
+
+    // Large files are reported while they're being hashed.
+    pn::string large = pn::format("{0}/large", dir.path());
+    write_sparse_file(large, 3 << 20, {{0, "a"}, {2 << 20, "b"}}, false);
+    observer.reports.clear();
+    EXPECT_THAT(file_digest(large, DIGEST_DENSE, &observer), Eq(file_digest(large)));
+    ASSERT_THAT(observer.reports.size(), Ge<size_t>(4));
+    for (int i : range<int>(1, observer.reports.size())) {
+        EXPECT_THAT(observer.reports[i].bytes, Ge(observer.reports[i - 1].bytes));
+        EXPECT_THAT(observer.reports[i].io_seconds, Ge(observer.reports[i - 1].io_seconds));
+    }
+    EXPECT_THAT(observer.reports.back().bytes, Eq<uint64_t>(3 << 20));
+    EXPECT_THAT(observer.reports.back().files, Eq<uint64_t>(1));
+    EXPECT_THAT(observer.reports.back().compute_seconds, Gt(0.0));
+}
+
+// Interrupts a digest once `files` files have been hashed.
+class InterruptingObserver : public DigestObserver {
+  public:
+    explicit InterruptingObserver(uint64_t files)
+            : DigestObserver(std::chrono::steady_clock::duration::zero()), _files(files) {}
+
+    void progress(const DigestProgress& progress) const {
+        if (progress.files >= _files) {
+            throw std::runtime_error("interrupted");
+        }
+    }
+
+  private:
+    const uint64_t _files;
+};
+
+TEST_F(Sha1Test, Checkpoint) {
+    TemporaryDirectory dir("sha1-test");
+    pn::string         tree       = pn::format("{0}/tree", dir.path());
+    pn::string         checkpoint = pn::format("{0}/checkpoint", dir.path());
+    for (const TreeData& tree_data : kTreeData) {
+        pn::string      path = pn::format("{0}/{1}", tree, tree_data.path);
+        pn::string_view data = tree_data.data;
+        makedirs(path::dirname(path), 0700);
+        pn::output out = pn::output{path, pn::binary};
+        ASSERT_THAT(out.c_obj(), NotNull());
+        ASSERT_THAT(out.write(data), Eq(true));
+    }
+    const auto every_file = std::chrono::steady_clock::duration::zero();
+
+    // Without an interruption, the checkpoint is cleaned up.
+    EXPECT_THAT(resumable_tree_digest(tree, checkpoint, every_file), Eq(kTreeDigest));
+    EXPECT_THAT(path::exists(checkpoint), Eq(false));
+
+    // An interrupted digest can be resumed.  The second file is hashed, but the digest is
+    // interrupted before the checkpoint after it, so only the first file is skipped.
+    InterruptingObserver interrupt(2);
+    EXPECT_THROW(
+            resumable_tree_digest(tree, checkpoint, every_file, &interrupt), std::runtime_error);
+    ASSERT_THAT(path::isfile(checkpoint), Eq(true));
+    EXPECT_THROW(resumable_tree_digest(dir.path(), checkpoint, every_file), std::runtime_error);
+
+    RecordingObserver observer;
+    EXPECT_THAT(resumable_tree_digest(tree, checkpoint, every_file, &observer), Eq(kTreeDigest));
+    EXPECT_THAT(observer.reports.back().files, Eq<uint64_t>(4));
+    EXPECT_THAT(path::exists(checkpoint), Eq(false));
+
+    // A checkpoint after a file that has since been removed can't be resumed.
+    EXPECT_THROW(
+            resumable_tree_digest(tree, checkpoint, every_file, &interrupt), std::runtime_error);
+    unlink(pn::format("{0}/beowulf", tree));
+    EXPECT_THROW(resumable_tree_digest(tree, checkpoint, every_file), std::runtime_error);
+
+    // A checkpoint that isn't one is rejected.
+    pn::output{checkpoint, pn::binary}.write(pn::string_view{"garbage"}).check();
+    EXPECT_THROW(resumable_tree_digest(tree, checkpoint), std::runtime_error);
+}
+
+using GitTest = ::testing::Test;
+
+pn::data_view bytes(pn::string_view s) {
+    return pn::data_view{reinterpret_cast<const uint8_t*>(s.data()), s.size()};
+}
+
+void write_file(pn::string_view path, pn::data_view data) {
+    makedirs(path::dirname(path), 0700);
+    pn::output out = pn::output{path, pn::binary};
+    ASSERT_THAT(out.c_obj(), NotNull());
+    ASSERT_THAT(out.write(data), Eq(true));
+}
+
+TEST_F(GitTest, Objects) {
+    const sha1::digest kEmptyBlob{0xe69de29b, 0xb2d1d643, 0x4b8b29ae, 0x775ad8c2, 0xe48c5391};
+    const sha1::digest kHelloBlob{0xce013625, 0x030ba8db, 0xa906f756, 0x967f9e9c, 0xa394464a};
+    const sha1::digest kEmptyTree{0x4b825dc6, 0x42cb6eb9, 0xa060e54b, 0xf8d69288, 0xfbee4904};
+    EXPECT_THAT(git::blob_digest(pn::data_view{}), Eq(kEmptyBlob));
+    EXPECT_THAT(git::blob_digest(bytes("hello\n")), Eq(kHelloBlob));
+    EXPECT_THAT(git::object_digest("tree", pn::data_view{}), Eq(kEmptyTree));
+
+    TemporaryDirectory dir("git-test");
+    write_file(pn::format("{0}/hello", dir.path()), bytes("hello\n"));
+    EXPECT_THAT(git::file_digest(pn::format("{0}/hello", dir.path())), Eq(kHelloBlob));
+    EXPECT_THAT(git::tree_digest(dir.path()), Ne(kEmptyTree));
+    unlink(pn::format("{0}/hello", dir.path()));
+    EXPECT_THAT(git::tree_digest(dir.path()), Eq(kEmptyTree));
+}
+
+// Matches `git write-tree` after `git add -A` in the same tree.
+TEST_F(GitTest, Tree) {
+    TemporaryDirectory dir("git-test");
+    write_file(pn::format("{0}/a", dir.path()), bytes("hello\n"));
+    write_file(pn::format("{0}/b/c/d", dir.path()), bytes("x"));
+    write_file(pn::format("{0}/run", dir.path()), bytes("#!/bin/sh\n"));
+    write_file(pn::format("{0}/é", dir.path()), bytes("é"));
+    write_file(pn::format("{0}/.git/HEAD", dir.path()), bytes("ref: refs/heads/master\n"));
+    chmod(pn::format("{0}/run", dir.path()).c_str(), 0755);
+    symlink("a", pn::format("{0}/link", dir.path()));
+    makedirs(pn::format("{0}/empty", dir.path()), 0700);
+
+    const sha1::digest expected{0xc739651e, 0x923ef944, 0x9a0619f6, 0x294b3def, 0x9445737e};
+    EXPECT_THAT(git::tree_digest(dir.path()), Eq(expected));
+}
+
+// Anything named .git is skipped, and a directory with its own .git is a gitlink to the commit
+// it has checked out, whether its refs are loose or packed, or in a separate git directory.
+TEST_F(GitTest, Gitlinks) {
+    const sha1::digest kDetached{0x01234567, 0x89abcdef, 0x01234567, 0x89abcdef, 0x01234567};
+    const sha1::digest kPacked{0xfedcba98, 0x76543210, 0xfedcba98, 0x76543210, 0xfedcba98};
+    const sha1::digest kLoose{0x11111111, 0x22222222, 0x33333333, 0x44444444, 0x55555555};
+
+    TemporaryDirectory dir("git-test");
+    pn::string         tree = pn::format("{0}/tree", dir.path());
+    write_file(pn::format("{0}/a", tree), bytes("hello\n"));
+    write_file(pn::format("{0}/.git", tree), bytes("gitdir: /nowhere\n"));
+    write_file(pn::format("{0}/detached/.git/HEAD", tree), bytes(kDetached.hex()));
+    write_file(pn::format("{0}/detached/file", tree), bytes("not hashed"));
+    write_file(pn::format("{0}/loose/.git/HEAD", tree), bytes("ref: refs/heads/main\n"));
+    write_file(pn::format("{0}/loose/.git/refs/heads/main", tree), bytes(kLoose.hex()));
+    write_file(pn::format("{0}/packed/.git", tree), bytes("gitdir: ../../modules/packed\n"));
+    write_file(pn::format("{0}/modules/packed/HEAD", dir.path()), bytes("ref: refs/heads/main\n"));
+    write_file(
+            pn::format("{0}/modules/packed/packed-refs", dir.path()),
+            bytes(pn::format(
+                    "# pack-refs with: peeled\n{0} refs/heads/mainline\n{1} refs/heads/main\n",
+                    kLoose.hex(), kPacked.hex())));
+
+    std::vector<git::tree_entry> entries;
+    entries.push_back({git::MODE_FILE, pn::string{"a"}, git::blob_digest(bytes("hello\n"))});
+    entries.push_back({git::MODE_GITLINK, pn::string{"detached"}, kDetached});
+    entries.push_back({git::MODE_GITLINK, pn::string{"loose"}, kLoose});
+    entries.push_back({git::MODE_GITLINK, pn::string{"packed"}, kPacked});
+    EXPECT_THAT(
+            git::tree_digest(tree), Eq(git::object_digest("tree", git::tree_object(entries))));
+
+    // A checkout with no commit can't be recorded.
+    write_file(pn::format("{0}/unborn/.git/HEAD", tree), bytes("ref: refs/heads/main\n"));
+    EXPECT_THROW(git::tree_digest(tree), std::runtime_error);
+}
+
+// Writes a version 2 index, with a single entry for `path`, taking its stat data from the file.
+void write_index(
+        pn::string_view root, pn::string_view path, const sha1::digest& id, uint32_t size_delta,
+        int64_t index_mtime_delta) {
+    Stat st;
+    ASSERT_THAT(stat(pn::format("{0}/{1}", root, path).c_str(), &st), Eq(0));
+
+    pn::data   index;
+    pn::output out = index.output();
+    out.write(bytes("DIRC"), static_cast<uint32_t>(2), static_cast<uint32_t>(1));
+    out.write(
+            static_cast<uint32_t>(st.st_ctime), static_cast<uint32_t>(0),
+            static_cast<uint32_t>(st.st_mtime), static_cast<uint32_t>(0),
+            static_cast<uint32_t>(st.st_dev), static_cast<uint32_t>(st.st_ino),
+            static_cast<uint32_t>(0100644), static_cast<uint32_t>(st.st_uid),
+            static_cast<uint32_t>(st.st_gid), static_cast<uint32_t>(st.st_size + size_delta));
+    out.write(id.data(), static_cast<uint16_t>(path.size()), bytes(path));
+    for (int i = (62 + path.size()) % 8; i < 8; ++i) {
+        out.write(static_cast<uint8_t>(0));
+    }
+    out.write(sha1{}.compute().data());  // Checksum; not checked.
+
+    pn::string index_path = pn::format("{0}/.git/index", root);
+    write_file(index_path, index);
+    struct timeval times[2] = {{static_cast<time_t>(st.st_mtime + index_mtime_delta), 0},
+                               {static_cast<time_t>(st.st_mtime + index_mtime_delta), 0}};
+    ASSERT_THAT(utimes(index_path.c_str(), times), Eq(0));
+}
+
+// When the index says a file is unchanged, its cached blob id is used, even if it's wrong.
+TEST_F(GitTest, Index) {
+    TemporaryDirectory dir("git-test");
+    write_file(pn::format("{0}/a", dir.path()), bytes("hello\n"));
+
+    std::vector<git::tree_entry> entries;
+    entries.push_back({git::MODE_FILE, pn::string{"a"}, git::blob_digest(bytes("hello\n"))});
+    const sha1::digest actual = git::object_digest("tree", git::tree_object(entries));
+    entries[0].id             = git::blob_digest(bytes("goodbye\n"));
+    const sha1::digest cached = git::object_digest("tree", git::tree_object(entries));
+
+    write_index(dir.path(), "a", entries[0].id, 0, 10);
+    EXPECT_THAT(git::tree_digest(dir.path()), Eq(cached));
+
+    // The size differs, so the file is re-hashed.
+    write_index(dir.path(), "a", entries[0].id, 1, 10);
+    EXPECT_THAT(git::tree_digest(dir.path()), Eq(actual));
+
+    // The index was written in the same second the file was modified, so the entry is racy.
+    write_index(dir.path(), "a", entries[0].id, 0, 0);
+    EXPECT_THAT(git::tree_digest(dir.path()), Eq(actual));
+}
 #endif
 
 }  // namespace
@@ -0,0 +1,179 @@
+// Copyright (c) 2026 The libsfz Authors
+//
+// This file is part of libsfz, a free software project.  You can redistribute it and/or modify it
+// under the terms of the MIT License.
+
+// Measures the throughput of each codec, encoding and decoding, over inputs of several sizes and
+// mixes of ASCII and non-ASCII text.  Prints the results as JSON, one record per measurement:
+//
+//   {"simd": true, "results": [
+//     {"codec": "latin1", "direction": "encode", "mix": "ascii", "size": 16, "mb_per_s": 812.5},
+//     ...
+//   ]}
+//
+// "size" is the size of the text, in UTF-8; throughput is measured in bytes of input, which for
+// decoding is the encoded text.  The encoding-bench-scalar build is the same, but with SIMD paths
+// compiled out of the codecs, and "simd": false.
+//
+// Usage: encoding-bench [--max-size=BYTES] [--min-time=SECONDS]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <pn/data>
+#include <pn/string>
+#include <sfz/args.hpp>
+#include <sfz/encoding.hpp>
+#include <stdexcept>
+#include <vector>
+
+namespace sfz {
+namespace {
+
+const struct {
+    const char* name;  // As in the results.
+    const char* encoding;
+} kCodecs[] = {
+        {"ascii", "us-ascii"},         {"latin1", "iso-8859-1"},
+        {"macroman", "macroman"},      {"windows1252", "windows-1252"},
+        {"iso8859_15", "iso-8859-15"}, {"koi8r", "koi8-r"},
+        {"utf16le", "utf-16le"},       {"utf16be", "utf-16be"},
+        {"utf32", "utf-32"},
+};
+
+// The share of characters in each mix which aren't ASCII, in percent.  The random mix is
+// uniformly random bytes instead of text, which is mostly invalid in every encoding.
+const struct {
+    const char* name;
+    int         non_ascii;
+} kMixes[] = {
+        {"ascii", 0}, {"non_ascii_1", 1}, {"non_ascii_50", 50}, {"non_ascii_100", 100},
+        {"random", -1},
+};
+
+// Non-ASCII characters for the mixes: Latin-1, Cyrillic, the euro sign, CJK, and an emoji, to
+// cover each length of UTF-8 sequence, and characters that each codec can and can't encode.
+const char* const kNonAscii[] = {"\u00e9", "\u00fc", "\u00df", "\u043f",
+                                 "\u0440", "\u20ac", "\u4e2d", "\U0001f600"};
+
+// A small, fast, deterministic generator, so that each run measures the same inputs.
+class xorshift {
+  public:
+    uint32_t next() {
+        _state ^= _state << 13;
+        _state ^= _state >> 7;
+        _state ^= _state << 17;
+        return _state;
+    }
+
+  private:
+    uint64_t _state = 0x9e3779b97f4a7c15ull;
+};
+
+// Returns `size` bytes of input for a mix: UTF-8 text, or random bytes.
+pn::string make_input(int non_ascii, int size) {
+    xorshift   random;
+    pn::string input;
+    while (input.size() < size) {
+        const uint32_t r = random.next();
+        if (non_ascii < 0) {
+            const char byte = static_cast<char>(r);
+            input += pn::string_view{&byte, 1};
+        } else if (static_cast<int>(r % 100) < non_ascii) {
+            input += kNonAscii[(r >> 8) % (sizeof(kNonAscii) / sizeof(kNonAscii[0]))];
+        } else {
+            const char ch = ' ' + ((r >> 8) % 95);
+            input += pn::string_view{&ch, 1};
+        }
+    }
+    // The last character may have gone over; cut it short, as a chunk of a larger text would be.
+    return pn::string_view{input}.substr(0, size).copy();
+}
+
+pn::data_view bytes_of(pn::string_view string) {
+    return pn::data_view{reinterpret_cast<const uint8_t*>(string.data()), string.size()};
+}
+
+// Returns the throughput of `fn`, in MB/s of its `size` bytes of input, repeating it for at least
+// `min_time` seconds.
+template <typename Function>
+double measure(int size, double min_time, const Function& fn) {
+    typedef std::chrono::steady_clock clock;
+    const clock::time_point           start = clock::now();
+    int64_t                           bytes = 0;
+    double                            elapsed;
+    do {
+        fn();
+        bytes += size;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    } while (elapsed < min_time);
+    return (bytes / 1e6) / elapsed;
+}
+
+void print_result(
+        bool* first, const char* codec, const char* direction, const char* mix, int size,
+        double mb_per_s) {
+    printf("%s\n    {\"codec\": \"%s\", \"direction\": \"%s\", \"mix\": \"%s\", \"size\": %d, "
+           "\"mb_per_s\": %.1f}",
+           *first ? "" : ",", codec, direction, mix, size, mb_per_s);
+    *first = false;
+    fflush(stdout);
+}
+
+void run(int argc, char* const* argv) {
+    int    max_size = 256 << 20;
+    double min_time = 0.1;
+
+    args::callbacks callbacks;
+    callbacks.long_option = [&](
+            pn::string_view opt, const args::callbacks::get_value_f& get_value) {
+        if (opt == "max-size") {
+            args::integer_option(get_value(), &max_size);
+        } else if (opt == "min-time") {
+            args::float_option(get_value(), &min_time);
+        } else {
+            return false;
+        }
+        return true;
+    };
+    args::parse(argc - 1, argv + 1, callbacks);
+
+#if defined(SFZ_ENCODING_SCALAR)
+    printf("{\"simd\": false, \"results\": [");
+#else
+    printf("{\"simd\": true, \"results\": [");
+#endif
+    bool first = true;
+    for (const auto& mix : kMixes) {
+        for (int64_t size = 16; size <= max_size; size *= 16) {
+            const pn::string text = make_input(mix.non_ascii, static_cast<int>(size));
+            for (const auto& codec : kCodecs) {
+                const text_encoding& encoding = *find_encoding(codec.encoding);
+                print_result(
+                        &first, codec.name, "encode", mix.name, text.size(),
+                        measure(text.size(), min_time, [&] { encoding.encode(text); }));
+
+                // Decode what the text encodes to, or for the random mix, the random bytes.
+                const pn::data data = (mix.non_ascii < 0) ? bytes_of(text).copy()
+                                                          : encoding.encode(text);
+                print_result(
+                        &first, codec.name, "decode", mix.name, text.size(),
+                        measure(data.size(), min_time, [&] { encoding.decode(data); }));
+            }
+        }
+    }
+    printf("\n]}\n");
+}
+
+}  // namespace
+}  // namespace sfz
+
+int main(int argc, char* const* argv) {
+    try {
+        sfz::run(argc, argv);
+    } catch (std::exception& e) {
+        fprintf(stderr, "%s: %s\n", argv[0], e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -5,15 +5,222 @@
 
 #include <sfz/encoding.hpp>
 
+#include <string.h>
 #include <algorithm>
+#include <array>
+#include <limits>
+#include <memory>
+#include <numeric>
 #include <pn/data>
+#include <pn/output>
 #include <pn/string>
+#include <sfz/file.hpp>
+#include <sfz/parallel.hpp>
 #include <sfz/range.hpp>
+#include <stdexcept>
+#include <vector>
+
+// SFZ_ENCODING_SCALAR builds the portable code only, so that encoding-bench can compare it.
+#if defined(SFZ_ENCODING_SCALAR)
+#elif defined(__SSE2__) || defined(_M_X64)
+#define SFZ_ENCODING_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define SFZ_ENCODING_NEON 1
+#include <arm_neon.h>
+#endif
+
+// SSE2 is all that x86-64 guarantees; newer instruction sets are used if the processor has them.
+#if defined(SFZ_ENCODING_SCALAR)
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SFZ_ENCODING_X86_DISPATCH 1
+#define SFZ_TARGET(isa) __attribute__((target(isa)))
+#include <immintrin.h>
+#endif
 
 namespace sfz {
 
 namespace {
 
+// Returns the length of the longest prefix of [data, data + size) in which no byte has its high
+// bit set.  Checks 32 bytes at a time with SIMD where available, then 8 at a time, then singly.
+int ascii_prefix(const uint8_t* data, int size) {
+    int i = 0;
+#if defined(SFZ_ENCODING_SSE2)
+    for (; (i + 32) <= size; i += 32) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16));
+        if (_mm_movemask_epi8(_mm_or_si128(lo, hi)) != 0) {
+            break;
+        }
+    }
+#elif defined(SFZ_ENCODING_NEON)
+    for (; (i + 32) <= size; i += 32) {
+        uint8x16_t lo = vld1q_u8(data + i);
+        uint8x16_t hi = vld1q_u8(data + i + 16);
+        if (vmaxvq_u8(vorrq_u8(lo, hi)) >= 0x80) {
+            break;
+        }
+    }
+#endif
+    for (; (i + 8) <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        if ((word & 0x8080808080808080ull) != 0) {
+            break;
+        }
+    }
+    while ((i < size) && (data[i] < 0x80)) {
+        ++i;
+    }
+    return i;
+}
+
+// Returns the number of bytes in [data, data + size) which have their high bit set.  Counts 8
+// bytes at a time, by gathering their high bits into the low bit of each byte and summing the
+// bytes with a multiply.
+int count_high_bytes(const uint8_t* data, int size) {
+    int count = 0;
+    int i     = 0;
+    for (; (i + 8) <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        count += (((word & 0x8080808080808080ull) >> 7) * 0x0101010101010101ull) >> 56;
+    }
+    for (; i < size; ++i) {
+        count += data[i] >> 7;
+    }
+    return count;
+}
+
+// Returns the number of bytes in [data, data + size) from `low` to `high`, inclusive.  Compares 16
+// bytes at a time with SIMD where available, keeping a count in each lane, which is summed every
+// 255 blocks, before it can overflow.
+int count_bytes_in(const uint8_t* data, int size, uint8_t low, uint8_t high) {
+    int count = 0;
+    int i     = 0;
+#if defined(SFZ_ENCODING_SSE2)
+    // SSE2 only compares signed bytes, so flip the high bit of each to compare them unsigned.
+    const __m128i flip = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i lo   = _mm_set1_epi8(static_cast<char>(low ^ 0x80));
+    const __m128i hi   = _mm_set1_epi8(static_cast<char>(high ^ 0x80));
+    const __m128i zero = _mm_setzero_si128();
+    while ((i + 16) <= size) {
+        __m128i counts = zero;
+        for (int end = std::min(size - 15, i + (255 * 16)); i < end; i += 16) {
+            const __m128i v = _mm_xor_si128(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), flip);
+            const __m128i out = _mm_or_si128(_mm_cmplt_epi8(v, lo), _mm_cmpgt_epi8(v, hi));
+            counts            = _mm_sub_epi8(counts, _mm_cmpeq_epi8(out, zero));
+        }
+        const __m128i sums = _mm_sad_epu8(counts, zero);
+        count += _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+    }
+#elif defined(SFZ_ENCODING_NEON)
+    const uint8x16_t lo = vdupq_n_u8(low);
+    const uint8x16_t hi = vdupq_n_u8(high);
+    while ((i + 16) <= size) {
+        uint8x16_t counts = vdupq_n_u8(0);
+        for (int end = std::min(size - 15, i + (255 * 16)); i < end; i += 16) {
+            const uint8x16_t v = vld1q_u8(data + i);
+            counts             = vsubq_u8(counts, vandq_u8(vcgeq_u8(v, lo), vcleq_u8(v, hi)));
+        }
+        count += vaddlvq_u8(counts);
+    }
+#endif
+    for (; i < size; ++i) {
+        count += (low <= data[i]) && (data[i] <= high);
+    }
+    return count;
+}
+
+inline const uint8_t* bytes_of(pn::string_view string) {
+    return reinterpret_cast<const uint8_t*>(string.data());
+}
+
+// Returns the length of the UTF-8 sequence that starts with `lead`, from 1 to 4.  Continuation
+// bytes, which can't start a sequence, count as sequences of 1.
+inline int utf8_sequence_length(uint8_t lead) {
+    return (lead >= 0xf0) ? 4 : (lead >= 0xe0) ? 3 : (lead >= 0xc0) ? 2 : 1;
+}
+
+inline bool is_continuation(uint8_t byte) { return (byte & 0xc0) == 0x80; }
+
+// Returns the length of the sequence at the start of [in, in + size): a lead byte, and as many of
+// the continuation bytes after it as it calls for.  Any other byte is a sequence of its own.
+//
+// This is how codecs step over invalid UTF-8: each such sequence is replaced once, and the input
+// can be split before any of them without changing the result.
+inline int utf8_span(const uint8_t* in, int size) {
+    const int end    = std::min(utf8_sequence_length(in[0]), size);
+    int       length = 1;
+    while ((length < end) && is_continuation(in[length])) {
+        ++length;
+    }
+    return length;
+}
+
+// Writes `rune` to `out` in UTF-8.
+// @returns             The number of bytes written, from 1 to 4.
+int write_utf8(uint32_t rune, uint8_t* out) {
+    if (rune < 0x80) {
+        out[0] = rune;
+        return 1;
+    } else if (rune < 0x800) {
+        out[0] = 0xc0 | (rune >> 6);
+        out[1] = 0x80 | (rune & 0x3f);
+        return 2;
+    } else if (rune < 0x10000) {
+        out[0] = 0xe0 | (rune >> 12);
+        out[1] = 0x80 | ((rune >> 6) & 0x3f);
+        out[2] = 0x80 | (rune & 0x3f);
+        return 3;
+    }
+    out[0] = 0xf0 | (rune >> 18);
+    out[1] = 0x80 | ((rune >> 12) & 0x3f);
+    out[2] = 0x80 | ((rune >> 6) & 0x3f);
+    out[3] = 0x80 | (rune & 0x3f);
+    return 4;
+}
+
+// Reads a code point from `in`, which must start with a valid UTF-8 sequence.  The inverse of
+// write_utf8().
+// @returns             The number of bytes read, from 1 to 4.
+inline int read_utf8(const uint8_t* in, uint32_t* rune) {
+    if (in[0] < 0x80) {
+        *rune = in[0];
+        return 1;
+    } else if (in[0] < 0xe0) {
+        *rune = ((in[0] & 0x1f) << 6) | (in[1] & 0x3f);
+        return 2;
+    } else if (in[0] < 0xf0) {
+        *rune = ((in[0] & 0x0f) << 12) | ((in[1] & 0x3f) << 6) | (in[2] & 0x3f);
+        return 3;
+    }
+    *rune = ((in[0] & 0x07) << 18) | ((in[1] & 0x3f) << 12) | ((in[2] & 0x3f) << 6) |
+            (in[3] & 0x3f);
+    return 4;
+}
+
+// Converts into a pn::data or pn::string of `bound` bytes, the most that `convert(out)` writes
+// through its raw pointer, then shrinks it to the size that `convert` returns.  Each codec bounds
+// its output up front, so the result is allocated once, and nothing is copied.
+template <typename Convert>
+pn::data convert_to_data(int bound, const Convert& convert) {
+    pn::data data;
+    data.resize(bound);
+    data.resize(convert(data.data()));
+    return data;
+}
+
+template <typename Convert>
+pn::string convert_to_string(int bound, const Convert& convert) {
+    pn::string string;
+    string.resize(bound);
+    string.resize(convert(reinterpret_cast<uint8_t*>(string.data())));
+    return string;
+}
+
 // Identifies surrogate code points.
 //
 // UTF-16 represents code points outside the basic multilingual plane (plane 0) with a pair of
@@ -33,226 +240,3385 @@ const pn::rune kAsciiUnknownCodePoint{0x00003f};  // QUESTION MARK.
 
 bool is_valid_code_point(uint32_t rune) { return (rune <= 0x10ffff) && (!is_surrogate(rune)); }
 
-namespace ascii {
+namespace {
 
-pn::data encode(pn::string_view string) {
-    pn::data out;
-    for (pn::rune r : string) {
-        uint8_t byte = kAsciiUnknownCodePoint.value();
-        if (r.value() < 0x80) {
-            byte = r.value();
+// The code point validators check 16 or 32 values per block: a vector of 4 or 8 lanes at a time,
+// unrolled 4 times, since the check itself is only a few instructions.  A block with an invalid
+// value is rechecked singly, to find which.
+
+int validate_code_points_scalar(const uint32_t* runes, int size, int i) {
+    while ((i < size) && is_valid_code_point(runes[i])) {
+        ++i;
+    }
+    return i;
+}
+
+#if defined(SFZ_ENCODING_SSE2)
+
+// Returns a mask of the lanes in `v` which are above U+10FFFF or surrogates.
+inline __m128i sse2_invalid_code_points(__m128i v) {
+    const __m128i too_large = _mm_cmpgt_epi32(_mm_srli_epi32(v, 16), _mm_set1_epi32(0x10));
+    const __m128i surrogate = _mm_cmpeq_epi32(
+            _mm_and_si128(v, _mm_set1_epi32(static_cast<int>(0xfffff800u))),
+            _mm_set1_epi32(0xd800));
+    return _mm_or_si128(too_large, surrogate);
+}
+
+int validate_code_points_sse2(const uint32_t* runes, int size) {
+    int i = 0;
+    for (; (i + 16) <= size; i += 16) {
+        const __m128i* const v       = reinterpret_cast<const __m128i*>(runes + i);
+        const __m128i        invalid = _mm_or_si128(
+                _mm_or_si128(
+                        sse2_invalid_code_points(_mm_loadu_si128(v)),
+                        sse2_invalid_code_points(_mm_loadu_si128(v + 1))),
+                _mm_or_si128(
+                        sse2_invalid_code_points(_mm_loadu_si128(v + 2)),
+                        sse2_invalid_code_points(_mm_loadu_si128(v + 3))));
+        if (_mm_movemask_epi8(invalid) != 0) {
+            break;
         }
-        out += pn::data_view{&byte, 1};
     }
-    return out;
+    return validate_code_points_scalar(runes, size, i);
 }
 
-pn::string decode(pn::data_view data) {
-    pn::string out;
-    for (uint8_t byte : data) {
-        if (byte < 0x80) {
-            out += pn::rune{byte};
-        } else {
-            out += pn::rune{kUnknownCodePoint};
+#endif
+
+#if defined(SFZ_ENCODING_X86_DISPATCH)
+
+// As sse2_invalid_code_points(), with AVX2.
+SFZ_TARGET("avx2") inline __m256i avx2_invalid_code_points(__m256i v) {
+    const __m256i too_large =
+            _mm256_cmpgt_epi32(_mm256_srli_epi32(v, 16), _mm256_set1_epi32(0x10));
+    const __m256i surrogate = _mm256_cmpeq_epi32(
+            _mm256_and_si256(v, _mm256_set1_epi32(static_cast<int>(0xfffff800u))),
+            _mm256_set1_epi32(0xd800));
+    return _mm256_or_si256(too_large, surrogate);
+}
+
+SFZ_TARGET("avx2") int validate_code_points_avx2(const uint32_t* runes, int size) {
+    int i = 0;
+    for (; (i + 32) <= size; i += 32) {
+        const __m256i* const v       = reinterpret_cast<const __m256i*>(runes + i);
+        const __m256i        invalid = _mm256_or_si256(
+                _mm256_or_si256(
+                        avx2_invalid_code_points(_mm256_loadu_si256(v)),
+                        avx2_invalid_code_points(_mm256_loadu_si256(v + 1))),
+                _mm256_or_si256(
+                        avx2_invalid_code_points(_mm256_loadu_si256(v + 2)),
+                        avx2_invalid_code_points(_mm256_loadu_si256(v + 3))));
+        if (!_mm256_testz_si256(invalid, invalid)) {
+            break;
         }
     }
-    return out;
+    return validate_code_points_scalar(runes, size, i);
 }
 
-}  // namespace ascii
+#elif defined(SFZ_ENCODING_NEON)
 
-namespace latin1 {
+// As sse2_invalid_code_points(), with NEON.
+inline uint32x4_t neon_invalid_code_points(uint32x4_t v) {
+    return vorrq_u32(
+            vcgtq_u32(v, vdupq_n_u32(0x10ffff)),
+            vceqq_u32(vandq_u32(v, vdupq_n_u32(0xfffff800)), vdupq_n_u32(0xd800)));
+}
 
-pn::data encode(pn::string_view string) {
-    pn::data out;
-    for (pn::rune r : string) {
-        uint8_t byte = '?';
-        if (r.value() < 0x100) {
-            byte = r.value();
+int validate_code_points_neon(const uint32_t* runes, int size) {
+    int i = 0;
+    for (; (i + 16) <= size; i += 16) {
+        const uint32x4_t invalid = vorrq_u32(
+                vorrq_u32(
+                        neon_invalid_code_points(vld1q_u32(runes + i)),
+                        neon_invalid_code_points(vld1q_u32(runes + i + 4))),
+                vorrq_u32(
+                        neon_invalid_code_points(vld1q_u32(runes + i + 8)),
+                        neon_invalid_code_points(vld1q_u32(runes + i + 12))));
+        if (vmaxvq_u32(invalid) != 0) {
+            break;
         }
-        out += pn::data_view{&byte, 1};
     }
-    return out;
+    return validate_code_points_scalar(runes, size, i);
 }
 
-pn::string decode(pn::data_view data) {
-    pn::string out;
-    for (uint8_t byte : data) {
-        out += pn::rune{byte};
+#endif
+
+typedef int (*validate_code_points_function)(const uint32_t* runes, int size);
+
+int validate_code_points_portable(const uint32_t* runes, int size) {
+#if defined(SFZ_ENCODING_SSE2)
+    return validate_code_points_sse2(runes, size);
+#elif defined(SFZ_ENCODING_NEON)
+    return validate_code_points_neon(runes, size);
+#else
+    return validate_code_points_scalar(runes, size, 0);
+#endif
+}
+
+validate_code_points_function select_validate_code_points() {
+#if defined(SFZ_ENCODING_X86_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return validate_code_points_avx2;
     }
-    return out;
+#endif
+    return validate_code_points_portable;
 }
 
-}  // namespace latin1
+}  // namespace
 
-namespace macroman {
+int validate_code_points(const uint32_t* runes, int size) {
+    static const validate_code_points_function impl = select_validate_code_points();
+    return impl(runes, size);
+}
+
+int replace_invalid_code_points(uint32_t* runes, int size) {
+    int replaced = 0;
+    for (int i = validate_code_points(runes, size); i < size;
+         i += 1 + validate_code_points(runes + i + 1, size - i - 1)) {
+        runes[i] = kUnknownCodePoint.value();
+        ++replaced;
+    }
+    return replaced;
+}
+
+namespace utf8 {
 
 namespace {
 
-uint16_t kMacRomanSupplement[0x80] = {
-        0x00C4,  // LATIN CAPITAL LETTER A WITH DIAERESIS
-        0x00C5,  // LATIN CAPITAL LETTER A WITH RING ABOVE
-        0x00C7,  // LATIN CAPITAL LETTER C WITH CEDILLA
-        0x00C9,  // LATIN CAPITAL LETTER E WITH ACUTE
-        0x00D1,  // LATIN CAPITAL LETTER N WITH TILDE
-        0x00D6,  // LATIN CAPITAL LETTER O WITH DIAERESIS
-        0x00DC,  // LATIN CAPITAL LETTER U WITH DIAERESIS
-        0x00E1,  // LATIN SMALL LETTER A WITH ACUTE
-        0x00E0,  // LATIN SMALL LETTER A WITH GRAVE
-        0x00E2,  // LATIN SMALL LETTER A WITH CIRCUMFLEX
-        0x00E4,  // LATIN SMALL LETTER A WITH DIAERESIS
-        0x00E3,  // LATIN SMALL LETTER A WITH TILDE
-        0x00E5,  // LATIN SMALL LETTER A WITH RING ABOVE
-        0x00E7,  // LATIN SMALL LETTER C WITH CEDILLA
-        0x00E9,  // LATIN SMALL LETTER E WITH ACUTE
-        0x00E8,  // LATIN SMALL LETTER E WITH GRAVE
-        0x00EA,  // LATIN SMALL LETTER E WITH CIRCUMFLEX
-        0x00EB,  // LATIN SMALL LETTER E WITH DIAERESIS
-        0x00ED,  // LATIN SMALL LETTER I WITH ACUTE
-        0x00EC,  // LATIN SMALL LETTER I WITH GRAVE
-        0x00EE,  // LATIN SMALL LETTER I WITH CIRCUMFLEX
-        0x00EF,  // LATIN SMALL LETTER I WITH DIAERESIS
-        0x00F1,  // LATIN SMALL LETTER N WITH TILDE
-        0x00F3,  // LATIN SMALL LETTER O WITH ACUTE
-        0x00F2,  // LATIN SMALL LETTER O WITH GRAVE
-        0x00F4,  // LATIN SMALL LETTER O WITH CIRCUMFLEX
-        0x00F6,  // LATIN SMALL LETTER O WITH DIAERESIS
-        0x00F5,  // LATIN SMALL LETTER O WITH TILDE
-        0x00FA,  // LATIN SMALL LETTER U WITH ACUTE
-        0x00F9,  // LATIN SMALL LETTER U WITH GRAVE
-        0x00FB,  // LATIN SMALL LETTER U WITH CIRCUMFLEX
-        0x00FC,  // LATIN SMALL LETTER U WITH DIAERESIS
-        0x2020,  // DAGGER
-        0x00B0,  // DEGREE SIGN
-        0x00A2,  // CENT SIGN
-        0x00A3,  // POUND SIGN
-        0x00A7,  // SECTION SIGN
-        0x2022,  // BULLET
-        0x00B6,  // PILCROW SIGN
-        0x00DF,  // LATIN SMALL LETTER SHARP S
-        0x00AE,  // REGISTERED SIGN
-        0x00A9,  // COPYRIGHT SIGN
-        0x2122,  // TRADE MARK SIGN
-        0x00B4,  // ACUTE ACCENT
-        0x00A8,  // DIAERESIS
-        0x2260,  // NOT EQUAL TO
-        0x00C6,  // LATIN CAPITAL LETTER AE
-        0x00D8,  // LATIN CAPITAL LETTER O WITH STROKE
-        0x221E,  // INFINITY
-        0x00B1,  // PLUS-MINUS SIGN
-        0x2264,  // LESS-THAN OR EQUAL TO
-        0x2265,  // GREATER-THAN OR EQUAL TO
-        0x00A5,  // YEN SIGN
-        0x00B5,  // MICRO SIGN
-        0x2202,  // PARTIAL DIFFERENTIAL
-        0x2211,  // N-ARY SUMMATION
-        0x220F,  // N-ARY PRODUCT
-        0x03C0,  // GREEK SMALL LETTER PI
-        0x222B,  // INTEGRAL
-        0x00AA,  // FEMININE ORDINAL INDICATOR
-        0x00BA,  // MASCULINE ORDINAL INDICATOR
-        0x03A9,  // GREEK CAPITAL LETTER OMEGA
-        0x00E6,  // LATIN SMALL LETTER AE
-        0x00F8,  // LATIN SMALL LETTER O WITH STROKE
-        0x00BF,  // INVERTED QUESTION MARK
-        0x00A1,  // INVERTED EXCLAMATION MARK
-        0x00AC,  // NOT SIGN
-        0x221A,  // SQUARE ROOT
-        0x0192,  // LATIN SMALL LETTER F WITH HOOK
-        0x2248,  // ALMOST EQUAL TO
-        0x2206,  // INCREMENT
-        0x00AB,  // LEFT-POINTING DOUBLE ANGLE QUOTATION MARK
-        0x00BB,  // RIGHT-POINTING DOUBLE ANGLE QUOTATION MARK
-        0x2026,  // HORIZONTAL ELLIPSIS
-        0x00A0,  // NO-BREAK SPACE
-        0x00C0,  // LATIN CAPITAL LETTER A WITH GRAVE
-        0x00C3,  // LATIN CAPITAL LETTER A WITH TILDE
-        0x00D5,  // LATIN CAPITAL LETTER O WITH TILDE
-        0x0152,  // LATIN CAPITAL LIGATURE OE
-        0x0153,  // LATIN SMALL LIGATURE OE
-        0x2013,  // EN DASH
-        0x2014,  // EM DASH
-        0x201C,  // LEFT DOUBLE QUOTATION MARK
-        0x201D,  // RIGHT DOUBLE QUOTATION MARK
-        0x2018,  // LEFT SINGLE QUOTATION MARK
-        0x2019,  // RIGHT SINGLE QUOTATION MARK
-        0x00F7,  // DIVISION SIGN
-        0x25CA,  // LOZENGE
-        0x00FF,  // LATIN SMALL LETTER Y WITH DIAERESIS
-        0x0178,  // LATIN CAPITAL LETTER Y WITH DIAERESIS
-        0x2044,  // FRACTION SLASH
-        0x20AC,  // EURO SIGN
-        0x2039,  // SINGLE LEFT-POINTING ANGLE QUOTATION MARK
-        0x203A,  // SINGLE RIGHT-POINTING ANGLE QUOTATION MARK
-        0xFB01,  // LATIN SMALL LIGATURE FI
-        0xFB02,  // LATIN SMALL LIGATURE FL
-        0x2021,  // DOUBLE DAGGER
-        0x00B7,  // MIDDLE DOT
-        0x201A,  // SINGLE LOW-9 QUOTATION MARK
-        0x201E,  // DOUBLE LOW-9 QUOTATION MARK
-        0x2030,  // PER MILLE SIGN
-        0x00C2,  // LATIN CAPITAL LETTER A WITH CIRCUMFLEX
-        0x00CA,  // LATIN CAPITAL LETTER E WITH CIRCUMFLEX
-        0x00C1,  // LATIN CAPITAL LETTER A WITH ACUTE
-        0x00CB,  // LATIN CAPITAL LETTER E WITH DIAERESIS
-        0x00C8,  // LATIN CAPITAL LETTER E WITH GRAVE
-        0x00CD,  // LATIN CAPITAL LETTER I WITH ACUTE
-        0x00CE,  // LATIN CAPITAL LETTER I WITH CIRCUMFLEX
-        0x00CF,  // LATIN CAPITAL LETTER I WITH DIAERESIS
-        0x00CC,  // LATIN CAPITAL LETTER I WITH GRAVE
-        0x00D3,  // LATIN CAPITAL LETTER O WITH ACUTE
-        0x00D4,  // LATIN CAPITAL LETTER O WITH CIRCUMFLEX
-        0xF8FF,  // Apple logo
-        0x00D2,  // LATIN CAPITAL LETTER O WITH GRAVE
-        0x00DA,  // LATIN CAPITAL LETTER U WITH ACUTE
-        0x00DB,  // LATIN CAPITAL LETTER U WITH CIRCUMFLEX
-        0x00D9,  // LATIN CAPITAL LETTER U WITH GRAVE
-        0x0131,  // LATIN SMALL LETTER DOTLESS I
-        0x02C6,  // MODIFIER LETTER CIRCUMFLEX ACCENT
-        0x02DC,  // SMALL TILDE
-        0x00AF,  // MACRON
-        0x02D8,  // BREVE
-        0x02D9,  // DOT ABOVE
-        0x02DA,  // RING ABOVE
-        0x00B8,  // CEDILLA
-        0x02DD,  // DOUBLE ACUTE ACCENT
-        0x02DB,  // OGONEK
-        0x02C7,  // CARON
-};
+// Finds the first invalid sequence at or after `start`.  Everything before `start` must be valid,
+// except that it may end partway through a sequence; if so, checking starts from its lead byte.
+int validate_from(const uint8_t* data, int size, int start) {
+    int i = start;
+    for (int j = start - 1; (j >= 0) && (j >= (start - 3)); --j) {
+        if (!is_continuation(data[j])) {
+            i = j;
+            break;
+        }
+    }
 
-}  // namespace
+    while (true) {
+        i += ascii_prefix(data + i, size - i);
+        if (i == size) {
+            return size;
+        }
 
-pn::data encode(pn::string_view string) {
-    pn::data out;
-    for (pn::rune r : string) {
-        uint8_t byte = '?';
-        if (r.value() < 0x80) {
-            byte = r.value();
+        // The lead byte determines the length, and the range of the second byte.  The narrower
+        // ranges exclude overlong sequences, surrogates, and code points above U+10FFFF.
+        const uint8_t lead = data[i];
+        int           length;
+        uint8_t       low = 0x80, high = 0xbf;
+        if ((0xc2 <= lead) && (lead <= 0xdf)) {
+            length = 2;
+        } else if ((0xe0 <= lead) && (lead <= 0xef)) {
+            length = 3;
+            low    = (lead == 0xe0) ? 0xa0 : 0x80;
+            high   = (lead == 0xed) ? 0x9f : 0xbf;
+        } else if ((0xf0 <= lead) && (lead <= 0xf4)) {
+            length = 4;
+            low    = (lead == 0xf0) ? 0x90 : 0x80;
+            high   = (lead == 0xf4) ? 0x8f : 0xbf;
         } else {
-            for (int i : range(0x80)) {
-                if (r.value() == kMacRomanSupplement[i]) {
-                    byte = 0x80 + i;
-                    break;
-                }
+            return i;
+        }
+        if (((size - i) < length) || (data[i + 1] < low) || (high < data[i + 1])) {
+            return i;
+        }
+        for (int k = 2; k < length; ++k) {
+            if (!is_continuation(data[i + k])) {
+                return i;
             }
         }
-        out += pn::data_view{&byte, 1};
+        i += length;
     }
-    return out;
 }
 
-pn::string decode(pn::data_view data) {
-    pn::string out;
-    for (uint8_t byte : data) {
-        if (byte < 0x80) {
-            out += pn::rune{byte};
-        } else {
-            out += pn::rune{kMacRomanSupplement[byte - 0x80]};
+int validate_scalar(const uint8_t* data, int size) { return validate_from(data, size, 0); }
+
+#if defined(SFZ_ENCODING_X86_DISPATCH) || defined(SFZ_ENCODING_NEON)
+
+// SIMD validation follows Keiser and Lemire, "Validating UTF-8 In Less Than One Instruction Per
+// Byte".  Each pair of adjacent bytes is classified by looking up three of its nibbles in the
+// tables below; each lookup gives the set of errors that the pair might be, and the pair is
+// invalid if all three agree on one.  Separately, the bytes two and three places after a 3- or
+// 4-byte lead must be continuations; this is checked against kTwoConts, which the tables give
+// for every pair of continuation bytes.
+//
+// Blocks are checked whole.  Once one fails, validate_from() pinpoints the error.
+enum : uint8_t {
+    kTooShort     = 1 << 0,  // 11______ 0_______ or 11______ 11______
+    kTooLong      = 1 << 1,  // 0_______ 10______
+    kOverlong3    = 1 << 2,  // 11100000 100_____
+    kTooLarge     = 1 << 3,  // 11110100 1001____, 11110100 101_____, or 11110101+ 10______
+    kSurrogate    = 1 << 4,  // 11101101 101_____
+    kOverlong2    = 1 << 5,  // 1100000_ 10______
+    kOverlong4    = 1 << 6,  // 11110000 1000____
+    kTooLarge1000 = 1 << 6,  // 11110101+ 1000____
+    kTwoConts     = 1 << 7,  // 10______ 10______
+    kCarry        = kTooShort | kTooLong | kTwoConts,
+};
+
+// Indexed by the high nibble of the first byte of a pair.
+alignas(16) const uint8_t kByte1High[16] = {
+        kTooLong,
+        kTooLong,
+        kTooLong,
+        kTooLong,
+        kTooLong,
+        kTooLong,
+        kTooLong,
+        kTooLong,
+        kTwoConts,
+        kTwoConts,
+        kTwoConts,
+        kTwoConts,
+        kTooShort | kOverlong2,
+        kTooShort,
+        kTooShort | kOverlong3 | kSurrogate,
+        kTooShort | kTooLarge | kTooLarge1000 | kOverlong4,
+};
+
+// Indexed by the low nibble of the first byte of a pair.
+alignas(16) const uint8_t kByte1Low[16] = {
+        kCarry | kOverlong3 | kOverlong2 | kOverlong4,
+        kCarry | kOverlong2,
+        kCarry,
+        kCarry,
+        kCarry | kTooLarge,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000 | kSurrogate,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+};
+
+// Indexed by the high nibble of the second byte of a pair.
+alignas(16) const uint8_t kByte2High[16] = {
+        kTooShort,
+        kTooShort,
+        kTooShort,
+        kTooShort,
+        kTooShort,
+        kTooShort,
+        kTooShort,
+        kTooShort,
+        kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge1000 | kOverlong4,
+        kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge,
+        kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+        kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+        kTooShort,
+        kTooShort,
+        kTooShort,
+        kTooShort,
+};
+
+// A block is incomplete if it ends partway through a sequence: that is, if one of its last three
+// bytes is a lead byte, and the end of the block comes before the end of its sequence.  Any byte
+// greater than this, at the same place from the end, is such a lead byte.
+alignas(32) const uint8_t kIncomplete[32] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xef, 0xdf, 0xbf,
+};
+
+#endif  // defined(SFZ_ENCODING_X86_DISPATCH) || defined(SFZ_ENCODING_NEON)
+
+#if defined(SFZ_ENCODING_X86_DISPATCH)
+
+SFZ_TARGET("ssse3") inline __m128i ssse3_lookup(const uint8_t* table, __m128i index) {
+    return _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(table)), index);
+}
+
+// Returns a vector which is nonzero where the bytes of `input` are invalid, given that `prev`
+// holds the 16 bytes before it.
+SFZ_TARGET("ssse3") inline __m128i ssse3_errors(__m128i input, __m128i prev) {
+    const __m128i nibble  = _mm_set1_epi8(0x0f);
+    const __m128i prev1   = _mm_alignr_epi8(input, prev, 15);
+    const __m128i special = _mm_and_si128(
+            _mm_and_si128(
+                    ssse3_lookup(kByte1High, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                    ssse3_lookup(kByte1Low, _mm_and_si128(prev1, nibble))),
+            ssse3_lookup(kByte2High, _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+
+    // Saturating subtraction leaves the high bit set only after a 3- or 4-byte lead.
+    const __m128i prev2  = _mm_alignr_epi8(input, prev, 14);
+    const __m128i prev3  = _mm_alignr_epi8(input, prev, 13);
+    const __m128i must23 = _mm_and_si128(
+            _mm_or_si128(
+                    _mm_subs_epu8(prev2, _mm_set1_epi8(0xe0 - 0x80)),
+                    _mm_subs_epu8(prev3, _mm_set1_epi8(0xf0 - 0x80))),
+            _mm_set1_epi8(static_cast<char>(0x80)));
+    return _mm_xor_si128(must23, special);
+}
+
+SFZ_TARGET("ssse3") int validate_ssse3(const uint8_t* data, int size) {
+    const __m128i zero       = _mm_setzero_si128();
+    const __m128i incomplete = _mm_load_si128(reinterpret_cast<const __m128i*>(kIncomplete + 16));
+    __m128i       prev       = zero;
+    int           i          = 0;
+    for (; (i + 16) <= size; i += 16) {
+        const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        // ASCII is only invalid if it interrupts a sequence from the previous block.
+        const __m128i errors = (_mm_movemask_epi8(input) == 0)
+                                       ? _mm_subs_epu8(prev, incomplete)
+                                       : ssse3_errors(input, prev);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(errors, zero)) != 0xffff) {
+            break;
         }
+        prev = input;
     }
-    return out;
+    return validate_from(data, size, i);
 }
 
-}  // namespace macroman
+SFZ_TARGET("avx2") inline __m256i avx2_lookup(const uint8_t* table, __m256i index) {
+    return _mm256_shuffle_epi8(
+            _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(table))),
+            index);
+}
+
+// As ssse3_errors(), for 32 bytes.  Byte shifts work within 128-bit lanes, so the bytes before
+// each lane are first gathered into one vector.
+SFZ_TARGET("avx2") inline __m256i avx2_errors(__m256i input, __m256i prev) {
+    const __m256i nibble  = _mm256_set1_epi8(0x0f);
+    const __m256i before  = _mm256_permute2x128_si256(prev, input, 0x21);
+    const __m256i prev1   = _mm256_alignr_epi8(input, before, 15);
+    const __m256i special = _mm256_and_si256(
+            _mm256_and_si256(
+                    avx2_lookup(kByte1High, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                    avx2_lookup(kByte1Low, _mm256_and_si256(prev1, nibble))),
+            avx2_lookup(kByte2High, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+
+    const __m256i prev2  = _mm256_alignr_epi8(input, before, 14);
+    const __m256i prev3  = _mm256_alignr_epi8(input, before, 13);
+    const __m256i must23 = _mm256_and_si256(
+            _mm256_or_si256(
+                    _mm256_subs_epu8(prev2, _mm256_set1_epi8(0xe0 - 0x80)),
+                    _mm256_subs_epu8(prev3, _mm256_set1_epi8(0xf0 - 0x80))),
+            _mm256_set1_epi8(static_cast<char>(0x80)));
+    return _mm256_xor_si256(must23, special);
+}
+
+SFZ_TARGET("avx2") int validate_avx2(const uint8_t* data, int size) {
+    const __m256i incomplete = _mm256_load_si256(reinterpret_cast<const __m256i*>(kIncomplete));
+    __m256i       prev       = _mm256_setzero_si256();
+    int           i          = 0;
+    for (; (i + 32) <= size; i += 32) {
+        const __m256i input  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const __m256i errors = (_mm256_movemask_epi8(input) == 0)
+                                       ? _mm256_subs_epu8(prev, incomplete)
+                                       : avx2_errors(input, prev);
+        if (!_mm256_testz_si256(errors, errors)) {
+            break;
+        }
+        prev = input;
+    }
+    return validate_from(data, size, i);
+}
+
+#elif defined(SFZ_ENCODING_NEON)
+
+// As ssse3_errors(), with NEON.
+inline uint8x16_t neon_errors(uint8x16_t input, uint8x16_t prev) {
+    const uint8x16_t prev1   = vextq_u8(prev, input, 15);
+    const uint8x16_t special = vandq_u8(
+            vandq_u8(
+                    vqtbl1q_u8(vld1q_u8(kByte1High), vshrq_n_u8(prev1, 4)),
+                    vqtbl1q_u8(vld1q_u8(kByte1Low), vandq_u8(prev1, vdupq_n_u8(0x0f)))),
+            vqtbl1q_u8(vld1q_u8(kByte2High), vshrq_n_u8(input, 4)));
+
+    const uint8x16_t prev2  = vextq_u8(prev, input, 14);
+    const uint8x16_t prev3  = vextq_u8(prev, input, 13);
+    const uint8x16_t must23 = vandq_u8(
+            vorrq_u8(
+                    vqsubq_u8(prev2, vdupq_n_u8(0xe0 - 0x80)),
+                    vqsubq_u8(prev3, vdupq_n_u8(0xf0 - 0x80))),
+            vdupq_n_u8(0x80));
+    return veorq_u8(must23, special);
+}
+
+int validate_neon(const uint8_t* data, int size) {
+    const uint8x16_t incomplete = vld1q_u8(kIncomplete + 16);
+    uint8x16_t       prev       = vdupq_n_u8(0);
+    int              i          = 0;
+    for (; (i + 16) <= size; i += 16) {
+        const uint8x16_t input  = vld1q_u8(data + i);
+        const uint8x16_t errors = (vmaxvq_u8(input) < 0x80) ? vqsubq_u8(prev, incomplete)
+                                                            : neon_errors(input, prev);
+        if (vmaxvq_u8(errors) != 0) {
+            break;
+        }
+        prev = input;
+    }
+    return validate_from(data, size, i);
+}
+
+#endif
+
+typedef int (*validate_function)(const uint8_t* data, int size);
+
+validate_function select_validate() {
+#if defined(SFZ_ENCODING_X86_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return validate_avx2;
+    } else if (__builtin_cpu_supports("ssse3")) {
+        return validate_ssse3;
+    }
+#elif defined(SFZ_ENCODING_NEON)
+    return validate_neon;
+#endif
+    return validate_scalar;
+}
+
+}  // namespace
+
+int validate(pn::data_view data) {
+    static const validate_function impl = select_validate();
+    return impl(data.data(), data.size());
+}
+
+namespace {
+
+const int kSkipBlockSize = 64;
+
+// Returns the offset in [data, data + size) after the first `n` code points, or `size` if there
+// are fewer.  `data` must start on a code point.  Counts the code points in whole blocks with
+// SIMD, while there are more than that left to skip, then finds the last ones a byte at a time.
+int skip_runes(const uint8_t* data, int size, int n) {
+    int i = 0;
+    for (; (i + kSkipBlockSize) <= size; i += kSkipBlockSize) {
+        const int runes = kSkipBlockSize - count_bytes_in(data + i, kSkipBlockSize, 0x80, 0xbf);
+        if (runes > n) {
+            break;
+        }
+        n -= runes;
+    }
+    for (; i < size; ++i) {
+        if (!is_continuation(data[i]) && (n-- == 0)) {
+            return i;
+        }
+    }
+    return size;
+}
+
+void rune_out_of_range(int n, int size) {
+    throw std::runtime_error(
+            pn::format("rune index {0} out of range for {1} runes", n, size).c_str());
+}
+
+}  // namespace
+
+int count_runes(pn::string_view string) {
+    return string.size() - count_bytes_in(bytes_of(string), string.size(), 0x80, 0xbf);
+}
+
+rune_index::rune_index(pn::string_view string) : _string{string}, _size{count_runes(string)} {
+    const uint8_t* const data = bytes_of(string);
+    for (int i = 0, n = 0; n <= _size; n += kRuneIndexInterval) {
+        _samples.push_back(i);
+        i += skip_runes(data + i, string.size() - i, kRuneIndexInterval);
+    }
+}
+
+int rune_index::offset(int n) const {
+    if ((n < 0) || (n > _size)) {
+        rune_out_of_range(n, _size);
+    }
+    const int i = _samples[n / kRuneIndexInterval];
+    return i + skip_runes(bytes_of(_string) + i, _string.size() - i, n % kRuneIndexInterval);
+}
+
+pn::rune rune_index::at(int n) const {
+    if (n == _size) {
+        rune_out_of_range(n, _size);
+    }
+    return *_string.substr(offset(n)).begin();
+}
+
+pn::string_view rune_index::substr(int begin, int end) const {
+    if ((end < begin) || (end > _size)) {
+        rune_out_of_range(end, _size);
+    }
+    const int i = offset(begin);
+    const int j = i + skip_runes(bytes_of(_string) + i, _string.size() - i, end - begin);
+    return _string.substr(i, j - i);
+}
+
+}  // namespace utf8
+
+namespace {
+
+// Counts the sequences in UTF-8, in the sense of utf8_span(), which is how many code points or
+// replacements it encodes to.  Also counts valid 4-byte sequences, which take a surrogate pair in
+// UTF-16.  Within valid runs, this is a count of the bytes which aren't continuation bytes.
+struct utf8_counts {
+    int sequences;
+    int supplementary;
+};
+
+utf8_counts count_sequences(const uint8_t* in, int size) {
+    utf8_counts counts = {0, 0};
+    int         i      = 0;
+    while (i < size) {
+        const int valid = i + utf8::validate(pn::data_view{in + i, size - i});
+        counts.sequences += (valid - i) - count_bytes_in(in + i, valid - i, 0x80, 0xbf);
+        counts.supplementary += count_bytes_in(in + i, valid - i, 0xf0, 0xff);
+        i = valid;
+        if (i < size) {
+            ++counts.sequences;
+            i += utf8_span(in + i, size - i);
+        }
+    }
+    return counts;
+}
+
+// Bounds the output of a codec: `size` bytes of input give at most
+// (size / in) * out + extra bytes of output.
+struct output_bound {
+    int in;
+    int out;
+    int extra;
+};
+
+// Returns the last offset in UTF-8 at or before `n` where the input may be split.  That's the
+// start of any sequence, in the sense of utf8_span().
+int utf8_split(const uint8_t* in, int size, int n) {
+    if ((n == size) || !is_continuation(in[n])) {
+        return n;
+    }
+    for (int j = n - 1; (j >= 0) && (j >= (n - 3)); --j) {
+        if (!is_continuation(in[j])) {
+            return ((j + utf8_span(in + j, size - j)) > n) ? j : n;
+        }
+    }
+    return n;
+}
+
+// Converts as much of [in, in + size) as fits in `capacity` bytes at `out`.  `convert` is a
+// codec's encode() or decode() function, `bound` bounds its output, and `split` finds where its
+// input may be split.
+//
+// First converts the longest piece of input whose output is sure to fit, until only a few bytes of
+// room are left.  Then converts one sequence at a time, through a small buffer, until the next
+// doesn't fit.
+template <typename Convert, typename Split>
+transcode_result convert_into(
+        const uint8_t* in, int size, uint8_t* out, int capacity, output_bound bound,
+        const Convert& convert, Split split) {
+    transcode_result result = {0, 0};
+    while (result.read < size) {
+        const int room = std::max(0, capacity - result.written - bound.extra) / bound.out;
+        const int end  = split(in, size, std::min(size, result.read + (room * bound.in)));
+        if (end <= result.read) {
+            break;
+        }
+        result.written += convert(in + result.read, end - result.read, out + result.written);
+        result.read = end;
+    }
+    while (result.read < size) {
+        int end = result.read + 1;
+        while (split(in, size, end) <= result.read) {
+            ++end;
+        }
+        uint8_t   buffer[16];  // Room for one sequence, converted.
+        const int written = convert(in + result.read, end - result.read, buffer);
+        if (written > (capacity - result.written)) {
+            break;
+        }
+        memcpy(out + result.written, buffer, written);
+        result.read = end;
+        result.written += written;
+    }
+    return result;
+}
+
+// Implements encode_into() and friends for a codec, which provides functions to encode and decode
+// through a pointer, and to bound their output.
+template <typename Codec>
+transcode_result encode_into(
+        const Codec& codec, pn::string_view string, uint8_t* out, int capacity) {
+    return convert_into(
+            bytes_of(string), string.size(), out, capacity, Codec::encode_bound(),
+            [&codec](const uint8_t* in, int size, uint8_t* out) {
+                return codec.encode(in, size, out);
+            },
+            utf8_split);
+}
+
+template <typename Codec>
+transcode_result decode_into(const Codec& codec, pn::data_view data, uint8_t* out, int capacity) {
+    return convert_into(
+            data.data(), data.size(), out, capacity, Codec::decode_bound(),
+            [&codec](const uint8_t* in, int size, uint8_t* out) {
+                return codec.decode(in, size, out);
+            },
+            Codec::decode_split);
+}
+
+// encode_append() and decode_append() convert through a buffer of this size on the stack.
+const int kStackBufferSize = 1024;
+
+template <typename Codec>
+void encode_append(const Codec& codec, pn::string_view string, pn::data* out) {
+    uint8_t buffer[kStackBufferSize];
+    while (string.size() > 0) {
+        const transcode_result result = encode_into(codec, string, buffer, kStackBufferSize);
+        *out += pn::data_view{buffer, result.written};
+        string = string.substr(result.read);
+    }
+}
+
+template <typename Codec>
+void decode_append(const Codec& codec, pn::data_view data, pn::string* out) {
+    uint8_t buffer[kStackBufferSize];
+    while (data.size() > 0) {
+        const transcode_result result = decode_into(codec, data, buffer, kStackBufferSize);
+        *out += pn::string_view{reinterpret_cast<const char*>(buffer), result.written};
+        data = pn::data_view{data.data() + result.read, data.size() - result.read};
+    }
+}
+
+// Maps code points in the basic multilingual plane back to bytes 0x80 to 0xFF of a single-byte
+// encoding, in constant time.
+//
+// This is a two-level table: the high byte of a code point selects a page, and the low byte an
+// entry within the page.  Pages with no mapped code points all share page 0, which is empty, so
+// the table takes a few KiB rather than 64.  Bytes which decode to kUnknownCodePoint aren't
+// mapped back.
+class reverse_table {
+  public:
+    explicit reverse_table(const uint16_t (&supplement)[0x80]) : _index{}, _pages(1) {
+        for (int i : range(0x80)) {
+            uint16_t code = supplement[i];
+            if (code == kUnknownCodePoint.value()) {
+                continue;
+            }
+            uint8_t& page = _index[code >> 8];
+            if (page == 0) {
+                page = _pages.size();
+                _pages.emplace_back();
+            }
+            // If a code point appears twice, the first byte wins, as with a linear search.
+            uint8_t& byte = _pages[page][code & 0xff];
+            if (byte == 0) {
+                byte = 0x80 + i;
+            }
+        }
+    }
+
+    // Returns the byte which encodes `rune`, or 0 if there isn't one.
+    uint8_t operator[](uint32_t rune) const {
+        if (rune > 0xffff) {
+            return 0;
+        }
+        return _pages[_index[rune >> 8]][rune & 0xff];
+    }
+
+  private:
+    uint8_t                                 _index[0x100];
+    std::vector<std::array<uint8_t, 0x100>> _pages;
+};
+
+// A single-byte encoding which matches ASCII in bytes 0x00 to 0x7F, and maps bytes 0x80 to 0xFF
+// to the code points in a 128-entry table.  Bytes that have no code point can be given
+// kUnknownCodePoint.
+//
+// ASCII text is encoded identically in UTF-8, so runs of it are copied in bulk.  Only the bytes
+// and code points between runs go through the tables.
+class single_byte_codec {
+  public:
+    explicit single_byte_codec(const uint16_t (&supplement)[0x80]) : _reverse(supplement) {
+        for (int i : range(0x80)) {
+            _utf8_size[i] = write_utf8(supplement[i], _utf8[i]);
+        }
+    }
+
+    // Converts UTF-8 to this encoding.  `out` must have room for `size` bytes, since each code
+    // point takes at least one byte in UTF-8.
+    // @returns             The number of bytes written.
+    int encode(const uint8_t* in, int size, uint8_t* out) const {
+        uint8_t* const begin = out;
+        int            i     = 0;
+        while (i < size) {
+            // Runes before the next invalid sequence, if any, can be read without checking each.
+            const int valid = i + utf8::validate(pn::data_view{in + i, size - i});
+            while (i < valid) {
+                const int run = ascii_prefix(in + i, valid - i);
+                memcpy(out, in + i, run);
+                out += run;
+                i += run;
+                while ((i < valid) && (in[i] >= 0x80)) {
+                    uint32_t rune;
+                    i += read_utf8(in + i, &rune);
+                    *(out++) = encode_rune(rune);
+                }
+            }
+            if (i < size) {
+                *(out++) = kAsciiUnknownCodePoint.value();
+                i += utf8_span(in + i, size - i);
+            }
+        }
+        return out - begin;
+    }
+
+    // Converts this encoding to UTF-8.  `out` must have room for `size` bytes, plus two for each
+    // byte with its high bit set, since supplement code points are in the basic multilingual
+    // plane.
+    // @returns             The number of bytes written.
+    int decode(const uint8_t* in, int size, uint8_t* out) const {
+        uint8_t* const begin = out;
+        for (int i = 0; i < size;) {
+            int run = ascii_prefix(in + i, size - i);
+            memcpy(out, in + i, run);
+            out += run;
+            i += run;
+            for (; (i < size) && (in[i] >= 0x80); ++i) {
+                int index = in[i] - 0x80;
+                memcpy(out, _utf8[index], _utf8_size[index]);
+                out += _utf8_size[index];
+            }
+        }
+        return out - begin;
+    }
+
+    pn::data encode(pn::string_view string) const {
+        return convert_to_data(string.size(), [&](uint8_t* out) {
+            return encode(bytes_of(string), string.size(), out);
+        });
+    }
+
+    pn::string decode(pn::data_view data) const {
+        return convert_to_string(
+                data.size() + (2 * count_high_bytes(data.data(), data.size())),
+                [&](uint8_t* out) { return decode(data.data(), data.size(), out); });
+    }
+
+    // Each sequence of UTF-8, valid or not, becomes one byte.
+    int encoded_length(const uint8_t* in, int size) const {
+        return count_sequences(in, size).sequences;
+    }
+
+    int decoded_length(const uint8_t* in, int size) const {
+        int length = size;
+        for (int i = ascii_prefix(in, size); i < size; i += ascii_prefix(in + i, size - i)) {
+            for (; (i < size) && (in[i] >= 0x80); ++i) {
+                length += _utf8_size[in[i] - 0x80] - 1;
+            }
+        }
+        return length;
+    }
+
+    bool can_encode(const uint8_t* in, int size) const {
+        if (utf8::validate(pn::data_view{in, size}) != size) {
+            return false;
+        }
+        for (int i = ascii_prefix(in, size); i < size; i += ascii_prefix(in + i, size - i)) {
+            while ((i < size) && (in[i] >= 0x80)) {
+                uint32_t rune;
+                i += read_utf8(in + i, &rune);
+                if (_reverse[rune] == 0) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    static output_bound encode_bound() { return {1, 1, 0}; }
+    static output_bound decode_bound() { return {1, 3, 0}; }
+    static int          decode_split(const uint8_t*, int, int n) { return n; }
+
+  private:
+    uint8_t encode_rune(uint32_t rune) const {
+        uint8_t byte = _reverse[rune];
+        return (byte == 0) ? kAsciiUnknownCodePoint.value() : byte;
+    }
+
+    const reverse_table _reverse;
+    uint8_t             _utf8[0x80][4];  // Each supplement code point, encoded in UTF-8.
+    int                 _utf8_size[0x80];
+};
+
+}  // namespace
+
+namespace ascii {
+
+namespace {
+
+// No byte above 0x7F is valid ASCII.
+const uint16_t kAsciiSupplement[0x80] = {
+        0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD,
+        0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD,
+        0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD,
+        0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD,
+        0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD,
+        0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD,
+        0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD,
+        0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD,
+        0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD,
+        0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD,
+        0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD,
+        0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD,
+        0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD,
+        0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD,
+        0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD,
+        0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD,
+};
+
+const single_byte_codec& codec() {
+    static const single_byte_codec codec(kAsciiSupplement);
+    return codec;
+}
+
+}  // namespace
+
+pn::data   encode(pn::string_view string) { return codec().encode(string); }
+pn::string decode(pn::data_view data) { return codec().decode(data); }
+
+transcode_result encode_into(pn::string_view string, uint8_t* out, int capacity) {
+    return sfz::encode_into(codec(), string, out, capacity);
+}
+transcode_result decode_into(pn::data_view data, uint8_t* out, int capacity) {
+    return sfz::decode_into(codec(), data, out, capacity);
+}
+void encode_append(pn::string_view string, pn::data* out) {
+    sfz::encode_append(codec(), string, out);
+}
+void decode_append(pn::data_view data, pn::string* out) { sfz::decode_append(codec(), data, out); }
+
+int encoded_length(pn::string_view string) {
+    return codec().encoded_length(bytes_of(string), string.size());
+}
+int decoded_length(pn::data_view data) { return codec().decoded_length(data.data(), data.size()); }
+bool can_encode(pn::string_view string) {
+    return codec().can_encode(bytes_of(string), string.size());
+}
+
+}  // namespace ascii
+
+namespace latin1 {
+
+namespace {
+
+// Code points U+80 to U+FF are encoded in UTF-8 as 0xC2 or 0xC3, followed by a continuation byte
+// with the low six bits.  Blocks of 16 bytes which are all ASCII, or all in this range, are
+// converted at once; mixed blocks are converted a byte or rune at a time.
+
+// Converts Latin-1 to UTF-8.  `out` must have room for `size` bytes, plus one for each byte
+// with its high bit set.  Returns the number of bytes written.
+int widen(const uint8_t* in, int size, uint8_t* out) {
+    uint8_t* const begin = out;
+    int            i     = 0;
+    while (i < size) {
+#if defined(SFZ_ENCODING_SSE2)
+        if ((i + 16) <= size) {
+            __m128i v    = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            int     high = _mm_movemask_epi8(v);
+            if (high == 0) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), v);
+                out += 16;
+                i += 16;
+                continue;
+            } else if (high == 0xffff) {
+                // Bit 6 of each byte selects the lead byte; shifting 16-bit lanes by 6 moves it
+                // to bit 0 of the same byte.
+                __m128i lead = _mm_add_epi8(
+                        _mm_set1_epi8(static_cast<char>(0xc2)),
+                        _mm_and_si128(_mm_srli_epi16(v, 6), _mm_set1_epi8(1)));
+                __m128i cont = _mm_and_si128(v, _mm_set1_epi8(static_cast<char>(0xbf)));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(lead, cont));
+                _mm_storeu_si128(
+                        reinterpret_cast<__m128i*>(out + 16), _mm_unpackhi_epi8(lead, cont));
+                out += 32;
+                i += 16;
+                continue;
+            }
+        }
+#elif defined(SFZ_ENCODING_NEON)
+        if ((i + 16) <= size) {
+            uint8x16_t v = vld1q_u8(in + i);
+            if (vmaxvq_u8(v) < 0x80) {
+                vst1q_u8(out, v);
+                out += 16;
+                i += 16;
+                continue;
+            } else if (vminvq_u8(v) >= 0x80) {
+                uint8x16x2_t pairs;
+                pairs.val[0] = vaddq_u8(
+                        vdupq_n_u8(0xc2), vandq_u8(vshrq_n_u8(v, 6), vdupq_n_u8(1)));
+                pairs.val[1] = vandq_u8(v, vdupq_n_u8(0xbf));
+                vst2q_u8(out, pairs);
+                out += 32;
+                i += 16;
+                continue;
+            }
+        }
+#endif
+        for (int end = std::min(i + 16, size); i < end; ++i) {
+            uint8_t byte = in[i];
+            if (byte < 0x80) {
+                *(out++) = byte;
+            } else {
+                *(out++) = 0xc0 | (byte >> 6);
+                *(out++) = 0x80 | (byte & 0x3f);
+            }
+        }
+    }
+    return out - begin;
+}
+
+// Converts UTF-8 to Latin-1, replacing code points above U+FF with '?'.  `out` must have room for
+// `size` bytes.  Returns the number of bytes written.
+int narrow(const uint8_t* in, int size, uint8_t* out) {
+    uint8_t* const begin = out;
+    int            i     = 0;
+    while (i < size) {
+#if defined(SFZ_ENCODING_SSE2)
+        if ((i + 16) <= size) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            if (_mm_movemask_epi8(v) == 0) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), v);
+                out += 16;
+                i += 16;
+                continue;
+            }
+
+            // Check for eight two-byte sequences, with each lead byte in the low half of a 16-bit
+            // lane and its continuation byte in the high half.
+            __m128i lead = _mm_and_si128(v, _mm_set1_epi16(0x00ff));
+            __m128i cont = _mm_srli_epi16(v, 8);
+            __m128i ok   = _mm_and_si128(
+                    _mm_cmpeq_epi16(
+                            _mm_and_si128(lead, _mm_set1_epi16(0xfe)), _mm_set1_epi16(0xc2)),
+                    _mm_cmpeq_epi16(
+                            _mm_and_si128(cont, _mm_set1_epi16(0xc0)), _mm_set1_epi16(0x80)));
+            if (_mm_movemask_epi8(ok) == 0xffff) {
+                __m128i bytes = _mm_or_si128(
+                        _mm_slli_epi16(_mm_and_si128(lead, _mm_set1_epi16(0x03)), 6),
+                        _mm_and_si128(cont, _mm_set1_epi16(0x3f)));
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(bytes, bytes));
+                out += 8;
+                i += 16;
+                continue;
+            }
+        }
+#elif defined(SFZ_ENCODING_NEON)
+        if ((i + 16) <= size) {
+            uint8x16_t v = vld1q_u8(in + i);
+            if (vmaxvq_u8(v) < 0x80) {
+                vst1q_u8(out, v);
+                out += 16;
+                i += 16;
+                continue;
+            }
+            uint8x8x2_t pairs = vld2_u8(in + i);
+            uint8x8_t   ok    = vand_u8(
+                    vceq_u8(vand_u8(pairs.val[0], vdup_n_u8(0xfe)), vdup_n_u8(0xc2)),
+                    vceq_u8(vand_u8(pairs.val[1], vdup_n_u8(0xc0)), vdup_n_u8(0x80)));
+            if (vminv_u8(ok) == 0xff) {
+                uint8x8_t bytes = vorr_u8(
+                        vshl_n_u8(vand_u8(pairs.val[0], vdup_n_u8(0x03)), 6),
+                        vand_u8(pairs.val[1], vdup_n_u8(0x3f)));
+                vst1_u8(out, bytes);
+                out += 8;
+                i += 16;
+                continue;
+            }
+        }
+#endif
+        for (int end = std::min(i + 16, size); i < end;) {
+            uint8_t byte = in[i];
+            if (byte < 0x80) {
+                *(out++) = byte;
+                ++i;
+                continue;
+            }
+            int length = utf8_span(in + i, size - i);
+            if (((byte & 0xfe) == 0xc2) && (length == 2)) {
+                *(out++) = ((byte & 0x03) << 6) | (in[i + 1] & 0x3f);
+            } else {
+                *(out++) = '?';
+            }
+            i += length;
+        }
+    }
+    return out - begin;
+}
+
+struct latin1_codec {
+    int encode(const uint8_t* in, int size, uint8_t* out) const { return narrow(in, size, out); }
+    int decode(const uint8_t* in, int size, uint8_t* out) const { return widen(in, size, out); }
+
+    int encoded_length(const uint8_t* in, int size) const {
+        return count_sequences(in, size).sequences;
+    }
+    int decoded_length(const uint8_t* in, int size) const {
+        return size + count_high_bytes(in, size);
+    }
+    // Code points up to U+FF have lead bytes up to 0xC3, and no continuation byte is higher than
+    // 0xBF, so valid UTF-8 can be encoded if it has no byte from 0xC4 up.
+    bool can_encode(const uint8_t* in, int size) const {
+        return (utf8::validate(pn::data_view{in, size}) == size) &&
+               (count_bytes_in(in, size, 0xc4, 0xff) == 0);
+    }
+
+    static output_bound encode_bound() { return {1, 1, 0}; }
+    static output_bound decode_bound() { return {1, 2, 0}; }
+    static int          decode_split(const uint8_t*, int, int n) { return n; }
+};
+
+latin1_codec codec() { return latin1_codec{}; }
+
+}  // namespace
+
+pn::data encode(pn::string_view string) {
+    // Each code point takes at least one byte in UTF-8, so the result is no longer than the input.
+    return convert_to_data(string.size(), [&](uint8_t* out) {
+        return narrow(bytes_of(string), string.size(), out);
+    });
+}
+
+pn::string decode(pn::data_view data) {
+    return convert_to_string(
+            data.size() + count_high_bytes(data.data(), data.size()),
+            [&](uint8_t* out) { return widen(data.data(), data.size(), out); });
+}
+
+transcode_result encode_into(pn::string_view string, uint8_t* out, int capacity) {
+    return sfz::encode_into(codec(), string, out, capacity);
+}
+transcode_result decode_into(pn::data_view data, uint8_t* out, int capacity) {
+    return sfz::decode_into(codec(), data, out, capacity);
+}
+void encode_append(pn::string_view string, pn::data* out) {
+    sfz::encode_append(codec(), string, out);
+}
+void decode_append(pn::data_view data, pn::string* out) { sfz::decode_append(codec(), data, out); }
+
+int encoded_length(pn::string_view string) {
+    return codec().encoded_length(bytes_of(string), string.size());
+}
+int decoded_length(pn::data_view data) { return codec().decoded_length(data.data(), data.size()); }
+bool can_encode(pn::string_view string) {
+    return codec().can_encode(bytes_of(string), string.size());
+}
+
+}  // namespace latin1
+
+namespace macroman {
+
+namespace {
+
+const uint16_t kMacRomanSupplement[0x80] = {
+        0x00C4,  // LATIN CAPITAL LETTER A WITH DIAERESIS
+        0x00C5,  // LATIN CAPITAL LETTER A WITH RING ABOVE
+        0x00C7,  // LATIN CAPITAL LETTER C WITH CEDILLA
+        0x00C9,  // LATIN CAPITAL LETTER E WITH ACUTE
+        0x00D1,  // LATIN CAPITAL LETTER N WITH TILDE
+        0x00D6,  // LATIN CAPITAL LETTER O WITH DIAERESIS
+        0x00DC,  // LATIN CAPITAL LETTER U WITH DIAERESIS
+        0x00E1,  // LATIN SMALL LETTER A WITH ACUTE
+        0x00E0,  // LATIN SMALL LETTER A WITH GRAVE
+        0x00E2,  // LATIN SMALL LETTER A WITH CIRCUMFLEX
+        0x00E4,  // LATIN SMALL LETTER A WITH DIAERESIS
+        0x00E3,  // LATIN SMALL LETTER A WITH TILDE
+        0x00E5,  // LATIN SMALL LETTER A WITH RING ABOVE
+        0x00E7,  // LATIN SMALL LETTER C WITH CEDILLA
+        0x00E9,  // LATIN SMALL LETTER E WITH ACUTE
+        0x00E8,  // LATIN SMALL LETTER E WITH GRAVE
+        0x00EA,  // LATIN SMALL LETTER E WITH CIRCUMFLEX
+        0x00EB,  // LATIN SMALL LETTER E WITH DIAERESIS
+        0x00ED,  // LATIN SMALL LETTER I WITH ACUTE
+        0x00EC,  // LATIN SMALL LETTER I WITH GRAVE
+        0x00EE,  // LATIN SMALL LETTER I WITH CIRCUMFLEX
+        0x00EF,  // LATIN SMALL LETTER I WITH DIAERESIS
+        0x00F1,  // LATIN SMALL LETTER N WITH TILDE
+        0x00F3,  // LATIN SMALL LETTER O WITH ACUTE
+        0x00F2,  // LATIN SMALL LETTER O WITH GRAVE
+        0x00F4,  // LATIN SMALL LETTER O WITH CIRCUMFLEX
+        0x00F6,  // LATIN SMALL LETTER O WITH DIAERESIS
+        0x00F5,  // LATIN SMALL LETTER O WITH TILDE
+        0x00FA,  // LATIN SMALL LETTER U WITH ACUTE
+        0x00F9,  // LATIN SMALL LETTER U WITH GRAVE
+        0x00FB,  // LATIN SMALL LETTER U WITH CIRCUMFLEX
+        0x00FC,  // LATIN SMALL LETTER U WITH DIAERESIS
+        0x2020,  // DAGGER
+        0x00B0,  // DEGREE SIGN
+        0x00A2,  // CENT SIGN
+        0x00A3,  // POUND SIGN
+        0x00A7,  // SECTION SIGN
+        0x2022,  // BULLET
+        0x00B6,  // PILCROW SIGN
+        0x00DF,  // LATIN SMALL LETTER SHARP S
+        0x00AE,  // REGISTERED SIGN
+        0x00A9,  // COPYRIGHT SIGN
+        0x2122,  // TRADE MARK SIGN
+        0x00B4,  // ACUTE ACCENT
+        0x00A8,  // DIAERESIS
+        0x2260,  // NOT EQUAL TO
+        0x00C6,  // LATIN CAPITAL LETTER AE
+        0x00D8,  // LATIN CAPITAL LETTER O WITH STROKE
+        0x221E,  // INFINITY
+        0x00B1,  // PLUS-MINUS SIGN
+        0x2264,  // LESS-THAN OR EQUAL TO
+        0x2265,  // GREATER-THAN OR EQUAL TO
+        0x00A5,  // YEN SIGN
+        0x00B5,  // MICRO SIGN
+        0x2202,  // PARTIAL DIFFERENTIAL
+        0x2211,  // N-ARY SUMMATION
+        0x220F,  // N-ARY PRODUCT
+        0x03C0,  // GREEK SMALL LETTER PI
+        0x222B,  // INTEGRAL
+        0x00AA,  // FEMININE ORDINAL INDICATOR
+        0x00BA,  // MASCULINE ORDINAL INDICATOR
+        0x03A9,  // GREEK CAPITAL LETTER OMEGA
+        0x00E6,  // LATIN SMALL LETTER AE
+        0x00F8,  // LATIN SMALL LETTER O WITH STROKE
+        0x00BF,  // INVERTED QUESTION MARK
+        0x00A1,  // INVERTED EXCLAMATION MARK
+        0x00AC,  // NOT SIGN
+        0x221A,  // SQUARE ROOT
+        0x0192,  // LATIN SMALL LETTER F WITH HOOK
+        0x2248,  // ALMOST EQUAL TO
+        0x2206,  // INCREMENT
+        0x00AB,  // LEFT-POINTING DOUBLE ANGLE QUOTATION MARK
+        0x00BB,  // RIGHT-POINTING DOUBLE ANGLE QUOTATION MARK
+        0x2026,  // HORIZONTAL ELLIPSIS
+        0x00A0,  // NO-BREAK SPACE
+        0x00C0,  // LATIN CAPITAL LETTER A WITH GRAVE
+        0x00C3,  // LATIN CAPITAL LETTER A WITH TILDE
+        0x00D5,  // LATIN CAPITAL LETTER O WITH TILDE
+        0x0152,  // LATIN CAPITAL LIGATURE OE
+        0x0153,  // LATIN SMALL LIGATURE OE
+        0x2013,  // EN DASH
+        0x2014,  // EM DASH
+        0x201C,  // LEFT DOUBLE QUOTATION MARK
+        0x201D,  // RIGHT DOUBLE QUOTATION MARK
+        0x2018,  // LEFT SINGLE QUOTATION MARK
+        0x2019,  // RIGHT SINGLE QUOTATION MARK
+        0x00F7,  // DIVISION SIGN
+        0x25CA,  // LOZENGE
+        0x00FF,  // LATIN SMALL LETTER Y WITH DIAERESIS
+        0x0178,  // LATIN CAPITAL LETTER Y WITH DIAERESIS
+        0x2044,  // FRACTION SLASH
+        0x20AC,  // EURO SIGN
+        0x2039,  // SINGLE LEFT-POINTING ANGLE QUOTATION MARK
+        0x203A,  // SINGLE RIGHT-POINTING ANGLE QUOTATION MARK
+        0xFB01,  // LATIN SMALL LIGATURE FI
+        0xFB02,  // LATIN SMALL LIGATURE FL
+        0x2021,  // DOUBLE DAGGER
+        0x00B7,  // MIDDLE DOT
+        0x201A,  // SINGLE LOW-9 QUOTATION MARK
+        0x201E,  // DOUBLE LOW-9 QUOTATION MARK
+        0x2030,  // PER MILLE SIGN
+        0x00C2,  // LATIN CAPITAL LETTER A WITH CIRCUMFLEX
+        0x00CA,  // LATIN CAPITAL LETTER E WITH CIRCUMFLEX
+        0x00C1,  // LATIN CAPITAL LETTER A WITH ACUTE
+        0x00CB,  // LATIN CAPITAL LETTER E WITH DIAERESIS
+        0x00C8,  // LATIN CAPITAL LETTER E WITH GRAVE
+        0x00CD,  // LATIN CAPITAL LETTER I WITH ACUTE
+        0x00CE,  // LATIN CAPITAL LETTER I WITH CIRCUMFLEX
+        0x00CF,  // LATIN CAPITAL LETTER I WITH DIAERESIS
+        0x00CC,  // LATIN CAPITAL LETTER I WITH GRAVE
+        0x00D3,  // LATIN CAPITAL LETTER O WITH ACUTE
+        0x00D4,  // LATIN CAPITAL LETTER O WITH CIRCUMFLEX
+        0xF8FF,  // Apple logo
+        0x00D2,  // LATIN CAPITAL LETTER O WITH GRAVE
+        0x00DA,  // LATIN CAPITAL LETTER U WITH ACUTE
+        0x00DB,  // LATIN CAPITAL LETTER U WITH CIRCUMFLEX
+        0x00D9,  // LATIN CAPITAL LETTER U WITH GRAVE
+        0x0131,  // LATIN SMALL LETTER DOTLESS I
+        0x02C6,  // MODIFIER LETTER CIRCUMFLEX ACCENT
+        0x02DC,  // SMALL TILDE
+        0x00AF,  // MACRON
+        0x02D8,  // BREVE
+        0x02D9,  // DOT ABOVE
+        0x02DA,  // RING ABOVE
+        0x00B8,  // CEDILLA
+        0x02DD,  // DOUBLE ACUTE ACCENT
+        0x02DB,  // OGONEK
+        0x02C7,  // CARON
+};
+
+const single_byte_codec& codec() {
+    static const single_byte_codec codec(kMacRomanSupplement);
+    return codec;
+}
+
+}  // namespace
+
+pn::data   encode(pn::string_view string) { return codec().encode(string); }
+pn::string decode(pn::data_view data) { return codec().decode(data); }
+
+transcode_result encode_into(pn::string_view string, uint8_t* out, int capacity) {
+    return sfz::encode_into(codec(), string, out, capacity);
+}
+transcode_result decode_into(pn::data_view data, uint8_t* out, int capacity) {
+    return sfz::decode_into(codec(), data, out, capacity);
+}
+void encode_append(pn::string_view string, pn::data* out) {
+    sfz::encode_append(codec(), string, out);
+}
+void decode_append(pn::data_view data, pn::string* out) { sfz::decode_append(codec(), data, out); }
+
+int encoded_length(pn::string_view string) {
+    return codec().encoded_length(bytes_of(string), string.size());
+}
+int decoded_length(pn::data_view data) { return codec().decoded_length(data.data(), data.size()); }
+bool can_encode(pn::string_view string) {
+    return codec().can_encode(bytes_of(string), string.size());
+}
+
+}  // namespace macroman
+
+namespace windows1252 {
+
+namespace {
+
+const uint16_t kWindows1252Supplement[0x80] = {
+        0x20AC,  // EURO SIGN
+        0x0081,  // <control> (undefined in Windows-1252)
+        0x201A,  // SINGLE LOW-9 QUOTATION MARK
+        0x0192,  // LATIN SMALL LETTER F WITH HOOK
+        0x201E,  // DOUBLE LOW-9 QUOTATION MARK
+        0x2026,  // HORIZONTAL ELLIPSIS
+        0x2020,  // DAGGER
+        0x2021,  // DOUBLE DAGGER
+        0x02C6,  // MODIFIER LETTER CIRCUMFLEX ACCENT
+        0x2030,  // PER MILLE SIGN
+        0x0160,  // LATIN CAPITAL LETTER S WITH CARON
+        0x2039,  // SINGLE LEFT-POINTING ANGLE QUOTATION MARK
+        0x0152,  // LATIN CAPITAL LIGATURE OE
+        0x008D,  // <control> (undefined in Windows-1252)
+        0x017D,  // LATIN CAPITAL LETTER Z WITH CARON
+        0x008F,  // <control> (undefined in Windows-1252)
+        0x0090,  // <control> (undefined in Windows-1252)
+        0x2018,  // LEFT SINGLE QUOTATION MARK
+        0x2019,  // RIGHT SINGLE QUOTATION MARK
+        0x201C,  // LEFT DOUBLE QUOTATION MARK
+        0x201D,  // RIGHT DOUBLE QUOTATION MARK
+        0x2022,  // BULLET
+        0x2013,  // EN DASH
+        0x2014,  // EM DASH
+        0x02DC,  // SMALL TILDE
+        0x2122,  // TRADE MARK SIGN
+        0x0161,  // LATIN SMALL LETTER S WITH CARON
+        0x203A,  // SINGLE RIGHT-POINTING ANGLE QUOTATION MARK
+        0x0153,  // LATIN SMALL LIGATURE OE
+        0x009D,  // <control> (undefined in Windows-1252)
+        0x017E,  // LATIN SMALL LETTER Z WITH CARON
+        0x0178,  // LATIN CAPITAL LETTER Y WITH DIAERESIS
+        0x00A0,  // NO-BREAK SPACE
+        0x00A1,  // INVERTED EXCLAMATION MARK
+        0x00A2,  // CENT SIGN
+        0x00A3,  // POUND SIGN
+        0x00A4,  // CURRENCY SIGN
+        0x00A5,  // YEN SIGN
+        0x00A6,  // BROKEN BAR
+        0x00A7,  // SECTION SIGN
+        0x00A8,  // DIAERESIS
+        0x00A9,  // COPYRIGHT SIGN
+        0x00AA,  // FEMININE ORDINAL INDICATOR
+        0x00AB,  // LEFT-POINTING DOUBLE ANGLE QUOTATION MARK
+        0x00AC,  // NOT SIGN
+        0x00AD,  // SOFT HYPHEN
+        0x00AE,  // REGISTERED SIGN
+        0x00AF,  // MACRON
+        0x00B0,  // DEGREE SIGN
+        0x00B1,  // PLUS-MINUS SIGN
+        0x00B2,  // SUPERSCRIPT TWO
+        0x00B3,  // SUPERSCRIPT THREE
+        0x00B4,  // ACUTE ACCENT
+        0x00B5,  // MICRO SIGN
+        0x00B6,  // PILCROW SIGN
+        0x00B7,  // MIDDLE DOT
+        0x00B8,  // CEDILLA
+        0x00B9,  // SUPERSCRIPT ONE
+        0x00BA,  // MASCULINE ORDINAL INDICATOR
+        0x00BB,  // RIGHT-POINTING DOUBLE ANGLE QUOTATION MARK
+        0x00BC,  // VULGAR FRACTION ONE QUARTER
+        0x00BD,  // VULGAR FRACTION ONE HALF
+        0x00BE,  // VULGAR FRACTION THREE QUARTERS
+        0x00BF,  // INVERTED QUESTION MARK
+        0x00C0,  // LATIN CAPITAL LETTER A WITH GRAVE
+        0x00C1,  // LATIN CAPITAL LETTER A WITH ACUTE
+        0x00C2,  // LATIN CAPITAL LETTER A WITH CIRCUMFLEX
+        0x00C3,  // LATIN CAPITAL LETTER A WITH TILDE
+        0x00C4,  // LATIN CAPITAL LETTER A WITH DIAERESIS
+        0x00C5,  // LATIN CAPITAL LETTER A WITH RING ABOVE
+        0x00C6,  // LATIN CAPITAL LETTER AE
+        0x00C7,  // LATIN CAPITAL LETTER C WITH CEDILLA
+        0x00C8,  // LATIN CAPITAL LETTER E WITH GRAVE
+        0x00C9,  // LATIN CAPITAL LETTER E WITH ACUTE
+        0x00CA,  // LATIN CAPITAL LETTER E WITH CIRCUMFLEX
+        0x00CB,  // LATIN CAPITAL LETTER E WITH DIAERESIS
+        0x00CC,  // LATIN CAPITAL LETTER I WITH GRAVE
+        0x00CD,  // LATIN CAPITAL LETTER I WITH ACUTE
+        0x00CE,  // LATIN CAPITAL LETTER I WITH CIRCUMFLEX
+        0x00CF,  // LATIN CAPITAL LETTER I WITH DIAERESIS
+        0x00D0,  // LATIN CAPITAL LETTER ETH
+        0x00D1,  // LATIN CAPITAL LETTER N WITH TILDE
+        0x00D2,  // LATIN CAPITAL LETTER O WITH GRAVE
+        0x00D3,  // LATIN CAPITAL LETTER O WITH ACUTE
+        0x00D4,  // LATIN CAPITAL LETTER O WITH CIRCUMFLEX
+        0x00D5,  // LATIN CAPITAL LETTER O WITH TILDE
+        0x00D6,  // LATIN CAPITAL LETTER O WITH DIAERESIS
+        0x00D7,  // MULTIPLICATION SIGN
+        0x00D8,  // LATIN CAPITAL LETTER O WITH STROKE
+        0x00D9,  // LATIN CAPITAL LETTER U WITH GRAVE
+        0x00DA,  // LATIN CAPITAL LETTER U WITH ACUTE
+        0x00DB,  // LATIN CAPITAL LETTER U WITH CIRCUMFLEX
+        0x00DC,  // LATIN CAPITAL LETTER U WITH DIAERESIS
+        0x00DD,  // LATIN CAPITAL LETTER Y WITH ACUTE
+        0x00DE,  // LATIN CAPITAL LETTER THORN
+        0x00DF,  // LATIN SMALL LETTER SHARP S
+        0x00E0,  // LATIN SMALL LETTER A WITH GRAVE
+        0x00E1,  // LATIN SMALL LETTER A WITH ACUTE
+        0x00E2,  // LATIN SMALL LETTER A WITH CIRCUMFLEX
+        0x00E3,  // LATIN SMALL LETTER A WITH TILDE
+        0x00E4,  // LATIN SMALL LETTER A WITH DIAERESIS
+        0x00E5,  // LATIN SMALL LETTER A WITH RING ABOVE
+        0x00E6,  // LATIN SMALL LETTER AE
+        0x00E7,  // LATIN SMALL LETTER C WITH CEDILLA
+        0x00E8,  // LATIN SMALL LETTER E WITH GRAVE
+        0x00E9,  // LATIN SMALL LETTER E WITH ACUTE
+        0x00EA,  // LATIN SMALL LETTER E WITH CIRCUMFLEX
+        0x00EB,  // LATIN SMALL LETTER E WITH DIAERESIS
+        0x00EC,  // LATIN SMALL LETTER I WITH GRAVE
+        0x00ED,  // LATIN SMALL LETTER I WITH ACUTE
+        0x00EE,  // LATIN SMALL LETTER I WITH CIRCUMFLEX
+        0x00EF,  // LATIN SMALL LETTER I WITH DIAERESIS
+        0x00F0,  // LATIN SMALL LETTER ETH
+        0x00F1,  // LATIN SMALL LETTER N WITH TILDE
+        0x00F2,  // LATIN SMALL LETTER O WITH GRAVE
+        0x00F3,  // LATIN SMALL LETTER O WITH ACUTE
+        0x00F4,  // LATIN SMALL LETTER O WITH CIRCUMFLEX
+        0x00F5,  // LATIN SMALL LETTER O WITH TILDE
+        0x00F6,  // LATIN SMALL LETTER O WITH DIAERESIS
+        0x00F7,  // DIVISION SIGN
+        0x00F8,  // LATIN SMALL LETTER O WITH STROKE
+        0x00F9,  // LATIN SMALL LETTER U WITH GRAVE
+        0x00FA,  // LATIN SMALL LETTER U WITH ACUTE
+        0x00FB,  // LATIN SMALL LETTER U WITH CIRCUMFLEX
+        0x00FC,  // LATIN SMALL LETTER U WITH DIAERESIS
+        0x00FD,  // LATIN SMALL LETTER Y WITH ACUTE
+        0x00FE,  // LATIN SMALL LETTER THORN
+        0x00FF,  // LATIN SMALL LETTER Y WITH DIAERESIS
+};
+
+const single_byte_codec& codec() {
+    static const single_byte_codec codec(kWindows1252Supplement);
+    return codec;
+}
+
+}  // namespace
+
+pn::data   encode(pn::string_view string) { return codec().encode(string); }
+pn::string decode(pn::data_view data) { return codec().decode(data); }
+
+transcode_result encode_into(pn::string_view string, uint8_t* out, int capacity) {
+    return sfz::encode_into(codec(), string, out, capacity);
+}
+transcode_result decode_into(pn::data_view data, uint8_t* out, int capacity) {
+    return sfz::decode_into(codec(), data, out, capacity);
+}
+void encode_append(pn::string_view string, pn::data* out) {
+    sfz::encode_append(codec(), string, out);
+}
+void decode_append(pn::data_view data, pn::string* out) { sfz::decode_append(codec(), data, out); }
+
+int encoded_length(pn::string_view string) {
+    return codec().encoded_length(bytes_of(string), string.size());
+}
+int decoded_length(pn::data_view data) { return codec().decoded_length(data.data(), data.size()); }
+bool can_encode(pn::string_view string) {
+    return codec().can_encode(bytes_of(string), string.size());
+}
+
+}  // namespace windows1252
+
+namespace iso8859_15 {
+
+namespace {
+
+const uint16_t kIso8859_15Supplement[0x80] = {
+        0x0080,  // <control>
+        0x0081,  // <control>
+        0x0082,  // <control>
+        0x0083,  // <control>
+        0x0084,  // <control>
+        0x0085,  // <control>
+        0x0086,  // <control>
+        0x0087,  // <control>
+        0x0088,  // <control>
+        0x0089,  // <control>
+        0x008A,  // <control>
+        0x008B,  // <control>
+        0x008C,  // <control>
+        0x008D,  // <control>
+        0x008E,  // <control>
+        0x008F,  // <control>
+        0x0090,  // <control>
+        0x0091,  // <control>
+        0x0092,  // <control>
+        0x0093,  // <control>
+        0x0094,  // <control>
+        0x0095,  // <control>
+        0x0096,  // <control>
+        0x0097,  // <control>
+        0x0098,  // <control>
+        0x0099,  // <control>
+        0x009A,  // <control>
+        0x009B,  // <control>
+        0x009C,  // <control>
+        0x009D,  // <control>
+        0x009E,  // <control>
+        0x009F,  // <control>
+        0x00A0,  // NO-BREAK SPACE
+        0x00A1,  // INVERTED EXCLAMATION MARK
+        0x00A2,  // CENT SIGN
+        0x00A3,  // POUND SIGN
+        0x20AC,  // EURO SIGN
+        0x00A5,  // YEN SIGN
+        0x0160,  // LATIN CAPITAL LETTER S WITH CARON
+        0x00A7,  // SECTION SIGN
+        0x0161,  // LATIN SMALL LETTER S WITH CARON
+        0x00A9,  // COPYRIGHT SIGN
+        0x00AA,  // FEMININE ORDINAL INDICATOR
+        0x00AB,  // LEFT-POINTING DOUBLE ANGLE QUOTATION MARK
+        0x00AC,  // NOT SIGN
+        0x00AD,  // SOFT HYPHEN
+        0x00AE,  // REGISTERED SIGN
+        0x00AF,  // MACRON
+        0x00B0,  // DEGREE SIGN
+        0x00B1,  // PLUS-MINUS SIGN
+        0x00B2,  // SUPERSCRIPT TWO
+        0x00B3,  // SUPERSCRIPT THREE
+        0x017D,  // LATIN CAPITAL LETTER Z WITH CARON
+        0x00B5,  // MICRO SIGN
+        0x00B6,  // PILCROW SIGN
+        0x00B7,  // MIDDLE DOT
+        0x017E,  // LATIN SMALL LETTER Z WITH CARON
+        0x00B9,  // SUPERSCRIPT ONE
+        0x00BA,  // MASCULINE ORDINAL INDICATOR
+        0x00BB,  // RIGHT-POINTING DOUBLE ANGLE QUOTATION MARK
+        0x0152,  // LATIN CAPITAL LIGATURE OE
+        0x0153,  // LATIN SMALL LIGATURE OE
+        0x0178,  // LATIN CAPITAL LETTER Y WITH DIAERESIS
+        0x00BF,  // INVERTED QUESTION MARK
+        0x00C0,  // LATIN CAPITAL LETTER A WITH GRAVE
+        0x00C1,  // LATIN CAPITAL LETTER A WITH ACUTE
+        0x00C2,  // LATIN CAPITAL LETTER A WITH CIRCUMFLEX
+        0x00C3,  // LATIN CAPITAL LETTER A WITH TILDE
+        0x00C4,  // LATIN CAPITAL LETTER A WITH DIAERESIS
+        0x00C5,  // LATIN CAPITAL LETTER A WITH RING ABOVE
+        0x00C6,  // LATIN CAPITAL LETTER AE
+        0x00C7,  // LATIN CAPITAL LETTER C WITH CEDILLA
+        0x00C8,  // LATIN CAPITAL LETTER E WITH GRAVE
+        0x00C9,  // LATIN CAPITAL LETTER E WITH ACUTE
+        0x00CA,  // LATIN CAPITAL LETTER E WITH CIRCUMFLEX
+        0x00CB,  // LATIN CAPITAL LETTER E WITH DIAERESIS
+        0x00CC,  // LATIN CAPITAL LETTER I WITH GRAVE
+        0x00CD,  // LATIN CAPITAL LETTER I WITH ACUTE
+        0x00CE,  // LATIN CAPITAL LETTER I WITH CIRCUMFLEX
+        0x00CF,  // LATIN CAPITAL LETTER I WITH DIAERESIS
+        0x00D0,  // LATIN CAPITAL LETTER ETH
+        0x00D1,  // LATIN CAPITAL LETTER N WITH TILDE
+        0x00D2,  // LATIN CAPITAL LETTER O WITH GRAVE
+        0x00D3,  // LATIN CAPITAL LETTER O WITH ACUTE
+        0x00D4,  // LATIN CAPITAL LETTER O WITH CIRCUMFLEX
+        0x00D5,  // LATIN CAPITAL LETTER O WITH TILDE
+        0x00D6,  // LATIN CAPITAL LETTER O WITH DIAERESIS
+        0x00D7,  // MULTIPLICATION SIGN
+        0x00D8,  // LATIN CAPITAL LETTER O WITH STROKE
+        0x00D9,  // LATIN CAPITAL LETTER U WITH GRAVE
+        0x00DA,  // LATIN CAPITAL LETTER U WITH ACUTE
+        0x00DB,  // LATIN CAPITAL LETTER U WITH CIRCUMFLEX
+        0x00DC,  // LATIN CAPITAL LETTER U WITH DIAERESIS
+        0x00DD,  // LATIN CAPITAL LETTER Y WITH ACUTE
+        0x00DE,  // LATIN CAPITAL LETTER THORN
+        0x00DF,  // LATIN SMALL LETTER SHARP S
+        0x00E0,  // LATIN SMALL LETTER A WITH GRAVE
+        0x00E1,  // LATIN SMALL LETTER A WITH ACUTE
+        0x00E2,  // LATIN SMALL LETTER A WITH CIRCUMFLEX
+        0x00E3,  // LATIN SMALL LETTER A WITH TILDE
+        0x00E4,  // LATIN SMALL LETTER A WITH DIAERESIS
+        0x00E5,  // LATIN SMALL LETTER A WITH RING ABOVE
+        0x00E6,  // LATIN SMALL LETTER AE
+        0x00E7,  // LATIN SMALL LETTER C WITH CEDILLA
+        0x00E8,  // LATIN SMALL LETTER E WITH GRAVE
+        0x00E9,  // LATIN SMALL LETTER E WITH ACUTE
+        0x00EA,  // LATIN SMALL LETTER E WITH CIRCUMFLEX
+        0x00EB,  // LATIN SMALL LETTER E WITH DIAERESIS
+        0x00EC,  // LATIN SMALL LETTER I WITH GRAVE
+        0x00ED,  // LATIN SMALL LETTER I WITH ACUTE
+        0x00EE,  // LATIN SMALL LETTER I WITH CIRCUMFLEX
+        0x00EF,  // LATIN SMALL LETTER I WITH DIAERESIS
+        0x00F0,  // LATIN SMALL LETTER ETH
+        0x00F1,  // LATIN SMALL LETTER N WITH TILDE
+        0x00F2,  // LATIN SMALL LETTER O WITH GRAVE
+        0x00F3,  // LATIN SMALL LETTER O WITH ACUTE
+        0x00F4,  // LATIN SMALL LETTER O WITH CIRCUMFLEX
+        0x00F5,  // LATIN SMALL LETTER O WITH TILDE
+        0x00F6,  // LATIN SMALL LETTER O WITH DIAERESIS
+        0x00F7,  // DIVISION SIGN
+        0x00F8,  // LATIN SMALL LETTER O WITH STROKE
+        0x00F9,  // LATIN SMALL LETTER U WITH GRAVE
+        0x00FA,  // LATIN SMALL LETTER U WITH ACUTE
+        0x00FB,  // LATIN SMALL LETTER U WITH CIRCUMFLEX
+        0x00FC,  // LATIN SMALL LETTER U WITH DIAERESIS
+        0x00FD,  // LATIN SMALL LETTER Y WITH ACUTE
+        0x00FE,  // LATIN SMALL LETTER THORN
+        0x00FF,  // LATIN SMALL LETTER Y WITH DIAERESIS
+};
+
+const single_byte_codec& codec() {
+    static const single_byte_codec codec(kIso8859_15Supplement);
+    return codec;
+}
+
+}  // namespace
+
+pn::data   encode(pn::string_view string) { return codec().encode(string); }
+pn::string decode(pn::data_view data) { return codec().decode(data); }
+
+transcode_result encode_into(pn::string_view string, uint8_t* out, int capacity) {
+    return sfz::encode_into(codec(), string, out, capacity);
+}
+transcode_result decode_into(pn::data_view data, uint8_t* out, int capacity) {
+    return sfz::decode_into(codec(), data, out, capacity);
+}
+void encode_append(pn::string_view string, pn::data* out) {
+    sfz::encode_append(codec(), string, out);
+}
+void decode_append(pn::data_view data, pn::string* out) { sfz::decode_append(codec(), data, out); }
+
+int encoded_length(pn::string_view string) {
+    return codec().encoded_length(bytes_of(string), string.size());
+}
+int decoded_length(pn::data_view data) { return codec().decoded_length(data.data(), data.size()); }
+bool can_encode(pn::string_view string) {
+    return codec().can_encode(bytes_of(string), string.size());
+}
+
+}  // namespace iso8859_15
+
+namespace koi8r {
+
+namespace {
+
+const uint16_t kKoi8RSupplement[0x80] = {
+        0x2500,  // BOX DRAWINGS LIGHT HORIZONTAL
+        0x2502,  // BOX DRAWINGS LIGHT VERTICAL
+        0x250C,  // BOX DRAWINGS LIGHT DOWN AND RIGHT
+        0x2510,  // BOX DRAWINGS LIGHT DOWN AND LEFT
+        0x2514,  // BOX DRAWINGS LIGHT UP AND RIGHT
+        0x2518,  // BOX DRAWINGS LIGHT UP AND LEFT
+        0x251C,  // BOX DRAWINGS LIGHT VERTICAL AND RIGHT
+        0x2524,  // BOX DRAWINGS LIGHT VERTICAL AND LEFT
+        0x252C,  // BOX DRAWINGS LIGHT DOWN AND HORIZONTAL
+        0x2534,  // BOX DRAWINGS LIGHT UP AND HORIZONTAL
+        0x253C,  // BOX DRAWINGS LIGHT VERTICAL AND HORIZONTAL
+        0x2580,  // UPPER HALF BLOCK
+        0x2584,  // LOWER HALF BLOCK
+        0x2588,  // FULL BLOCK
+        0x258C,  // LEFT HALF BLOCK
+        0x2590,  // RIGHT HALF BLOCK
+        0x2591,  // LIGHT SHADE
+        0x2592,  // MEDIUM SHADE
+        0x2593,  // DARK SHADE
+        0x2320,  // TOP HALF INTEGRAL
+        0x25A0,  // BLACK SQUARE
+        0x2219,  // BULLET OPERATOR
+        0x221A,  // SQUARE ROOT
+        0x2248,  // ALMOST EQUAL TO
+        0x2264,  // LESS-THAN OR EQUAL TO
+        0x2265,  // GREATER-THAN OR EQUAL TO
+        0x00A0,  // NO-BREAK SPACE
+        0x2321,  // BOTTOM HALF INTEGRAL
+        0x00B0,  // DEGREE SIGN
+        0x00B2,  // SUPERSCRIPT TWO
+        0x00B7,  // MIDDLE DOT
+        0x00F7,  // DIVISION SIGN
+        0x2550,  // BOX DRAWINGS DOUBLE HORIZONTAL
+        0x2551,  // BOX DRAWINGS DOUBLE VERTICAL
+        0x2552,  // BOX DRAWINGS DOWN SINGLE AND RIGHT DOUBLE
+        0x0451,  // CYRILLIC SMALL LETTER IO
+        0x2553,  // BOX DRAWINGS DOWN DOUBLE AND RIGHT SINGLE
+        0x2554,  // BOX DRAWINGS DOUBLE DOWN AND RIGHT
+        0x2555,  // BOX DRAWINGS DOWN SINGLE AND LEFT DOUBLE
+        0x2556,  // BOX DRAWINGS DOWN DOUBLE AND LEFT SINGLE
+        0x2557,  // BOX DRAWINGS DOUBLE DOWN AND LEFT
+        0x2558,  // BOX DRAWINGS UP SINGLE AND RIGHT DOUBLE
+        0x2559,  // BOX DRAWINGS UP DOUBLE AND RIGHT SINGLE
+        0x255A,  // BOX DRAWINGS DOUBLE UP AND RIGHT
+        0x255B,  // BOX DRAWINGS UP SINGLE AND LEFT DOUBLE
+        0x255C,  // BOX DRAWINGS UP DOUBLE AND LEFT SINGLE
+        0x255D,  // BOX DRAWINGS DOUBLE UP AND LEFT
+        0x255E,  // BOX DRAWINGS VERTICAL SINGLE AND RIGHT DOUBLE
+        0x255F,  // BOX DRAWINGS VERTICAL DOUBLE AND RIGHT SINGLE
+        0x2560,  // BOX DRAWINGS DOUBLE VERTICAL AND RIGHT
+        0x2561,  // BOX DRAWINGS VERTICAL SINGLE AND LEFT DOUBLE
+        0x0401,  // CYRILLIC CAPITAL LETTER IO
+        0x2562,  // BOX DRAWINGS VERTICAL DOUBLE AND LEFT SINGLE
+        0x2563,  // BOX DRAWINGS DOUBLE VERTICAL AND LEFT
+        0x2564,  // BOX DRAWINGS DOWN SINGLE AND HORIZONTAL DOUBLE
+        0x2565,  // BOX DRAWINGS DOWN DOUBLE AND HORIZONTAL SINGLE
+        0x2566,  // BOX DRAWINGS DOUBLE DOWN AND HORIZONTAL
+        0x2567,  // BOX DRAWINGS UP SINGLE AND HORIZONTAL DOUBLE
+        0x2568,  // BOX DRAWINGS UP DOUBLE AND HORIZONTAL SINGLE
+        0x2569,  // BOX DRAWINGS DOUBLE UP AND HORIZONTAL
+        0x256A,  // BOX DRAWINGS VERTICAL SINGLE AND HORIZONTAL DOUBLE
+        0x256B,  // BOX DRAWINGS VERTICAL DOUBLE AND HORIZONTAL SINGLE
+        0x256C,  // BOX DRAWINGS DOUBLE VERTICAL AND HORIZONTAL
+        0x00A9,  // COPYRIGHT SIGN
+        0x044E,  // CYRILLIC SMALL LETTER YU
+        0x0430,  // CYRILLIC SMALL LETTER A
+        0x0431,  // CYRILLIC SMALL LETTER BE
+        0x0446,  // CYRILLIC SMALL LETTER TSE
+        0x0434,  // CYRILLIC SMALL LETTER DE
+        0x0435,  // CYRILLIC SMALL LETTER IE
+        0x0444,  // CYRILLIC SMALL LETTER EF
+        0x0433,  // CYRILLIC SMALL LETTER GHE
+        0x0445,  // CYRILLIC SMALL LETTER HA
+        0x0438,  // CYRILLIC SMALL LETTER I
+        0x0439,  // CYRILLIC SMALL LETTER SHORT I
+        0x043A,  // CYRILLIC SMALL LETTER KA
+        0x043B,  // CYRILLIC SMALL LETTER EL
+        0x043C,  // CYRILLIC SMALL LETTER EM
+        0x043D,  // CYRILLIC SMALL LETTER EN
+        0x043E,  // CYRILLIC SMALL LETTER O
+        0x043F,  // CYRILLIC SMALL LETTER PE
+        0x044F,  // CYRILLIC SMALL LETTER YA
+        0x0440,  // CYRILLIC SMALL LETTER ER
+        0x0441,  // CYRILLIC SMALL LETTER ES
+        0x0442,  // CYRILLIC SMALL LETTER TE
+        0x0443,  // CYRILLIC SMALL LETTER U
+        0x0436,  // CYRILLIC SMALL LETTER ZHE
+        0x0432,  // CYRILLIC SMALL LETTER VE
+        0x044C,  // CYRILLIC SMALL LETTER SOFT SIGN
+        0x044B,  // CYRILLIC SMALL LETTER YERU
+        0x0437,  // CYRILLIC SMALL LETTER ZE
+        0x0448,  // CYRILLIC SMALL LETTER SHA
+        0x044D,  // CYRILLIC SMALL LETTER E
+        0x0449,  // CYRILLIC SMALL LETTER SHCHA
+        0x0447,  // CYRILLIC SMALL LETTER CHE
+        0x044A,  // CYRILLIC SMALL LETTER HARD SIGN
+        0x042E,  // CYRILLIC CAPITAL LETTER YU
+        0x0410,  // CYRILLIC CAPITAL LETTER A
+        0x0411,  // CYRILLIC CAPITAL LETTER BE
+        0x0426,  // CYRILLIC CAPITAL LETTER TSE
+        0x0414,  // CYRILLIC CAPITAL LETTER DE
+        0x0415,  // CYRILLIC CAPITAL LETTER IE
+        0x0424,  // CYRILLIC CAPITAL LETTER EF
+        0x0413,  // CYRILLIC CAPITAL LETTER GHE
+        0x0425,  // CYRILLIC CAPITAL LETTER HA
+        0x0418,  // CYRILLIC CAPITAL LETTER I
+        0x0419,  // CYRILLIC CAPITAL LETTER SHORT I
+        0x041A,  // CYRILLIC CAPITAL LETTER KA
+        0x041B,  // CYRILLIC CAPITAL LETTER EL
+        0x041C,  // CYRILLIC CAPITAL LETTER EM
+        0x041D,  // CYRILLIC CAPITAL LETTER EN
+        0x041E,  // CYRILLIC CAPITAL LETTER O
+        0x041F,  // CYRILLIC CAPITAL LETTER PE
+        0x042F,  // CYRILLIC CAPITAL LETTER YA
+        0x0420,  // CYRILLIC CAPITAL LETTER ER
+        0x0421,  // CYRILLIC CAPITAL LETTER ES
+        0x0422,  // CYRILLIC CAPITAL LETTER TE
+        0x0423,  // CYRILLIC CAPITAL LETTER U
+        0x0416,  // CYRILLIC CAPITAL LETTER ZHE
+        0x0412,  // CYRILLIC CAPITAL LETTER VE
+        0x042C,  // CYRILLIC CAPITAL LETTER SOFT SIGN
+        0x042B,  // CYRILLIC CAPITAL LETTER YERU
+        0x0417,  // CYRILLIC CAPITAL LETTER ZE
+        0x0428,  // CYRILLIC CAPITAL LETTER SHA
+        0x042D,  // CYRILLIC CAPITAL LETTER E
+        0x0429,  // CYRILLIC CAPITAL LETTER SHCHA
+        0x0427,  // CYRILLIC CAPITAL LETTER CHE
+        0x042A,  // CYRILLIC CAPITAL LETTER HARD SIGN
+};
+
+const single_byte_codec& codec() {
+    static const single_byte_codec codec(kKoi8RSupplement);
+    return codec;
+}
+
+}  // namespace
+
+pn::data   encode(pn::string_view string) { return codec().encode(string); }
+pn::string decode(pn::data_view data) { return codec().decode(data); }
+
+transcode_result encode_into(pn::string_view string, uint8_t* out, int capacity) {
+    return sfz::encode_into(codec(), string, out, capacity);
+}
+transcode_result decode_into(pn::data_view data, uint8_t* out, int capacity) {
+    return sfz::decode_into(codec(), data, out, capacity);
+}
+void encode_append(pn::string_view string, pn::data* out) {
+    sfz::encode_append(codec(), string, out);
+}
+void decode_append(pn::data_view data, pn::string* out) { sfz::decode_append(codec(), data, out); }
+
+int encoded_length(pn::string_view string) {
+    return codec().encoded_length(bytes_of(string), string.size());
+}
+int decoded_length(pn::data_view data) { return codec().decoded_length(data.data(), data.size()); }
+bool can_encode(pn::string_view string) {
+    return codec().can_encode(bytes_of(string), string.size());
+}
+
+}  // namespace koi8r
+
+namespace {
+
+// Reads a UTF-16 or UTF-32 code unit of `kUnitSize` bytes.
+template <int kUnitSize, bool kBigEndian>
+inline uint32_t read_unit(const uint8_t* in) {
+    uint32_t unit = 0;
+    for (int i = 0; i < kUnitSize; ++i) {
+        unit |= uint32_t{in[kBigEndian ? (kUnitSize - 1 - i) : i]} << (8 * i);
+    }
+    return unit;
+}
+
+template <int kUnitSize, bool kBigEndian>
+inline void write_unit(uint32_t unit, uint8_t* out) {
+    for (int i = 0; i < kUnitSize; ++i) {
+        out[kBigEndian ? (kUnitSize - 1 - i) : i] = unit >> (8 * i);
+    }
+}
+
+// Writes `rune` as a code unit, or in UTF-16, as a surrogate pair if it's outside the basic
+// multilingual plane.
+// @returns             The number of bytes written.
+template <int kUnitSize, bool kBigEndian>
+inline int write_units(uint32_t rune, uint8_t* out) {
+    if ((kUnitSize == 2) && (rune >= 0x10000)) {
+        rune -= 0x10000;
+        write_unit<2, kBigEndian>(0xd800 | (rune >> 10), out);
+        write_unit<2, kBigEndian>(0xdc00 | (rune & 0x3ff), out + 2);
+        return 4;
+    }
+    write_unit<kUnitSize, kBigEndian>(rune, out);
+    return kUnitSize;
+}
+
+inline bool is_high_surrogate(uint32_t unit) { return (unit & 0xfffffc00) == 0xd800; }
+inline bool is_low_surrogate(uint32_t unit) { return (unit & 0xfffffc00) == 0xdc00; }
+
+// Converts the longest ASCII prefix of `in` to code units, 16 bytes at a time where possible, by
+// interleaving them with zeroes.
+// @returns             The number of bytes converted.
+template <int kUnitSize, bool kBigEndian>
+int widen_ascii(const uint8_t* in, int size, uint8_t* out) {
+    int i = 0;
+#if defined(SFZ_ENCODING_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; (i + 16) <= size; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        if (_mm_movemask_epi8(v) != 0) {
+            break;
+        }
+        const __m128i lo = kBigEndian ? _mm_unpacklo_epi8(zero, v) : _mm_unpacklo_epi8(v, zero);
+        const __m128i hi = kBigEndian ? _mm_unpackhi_epi8(zero, v) : _mm_unpackhi_epi8(v, zero);
+        __m128i*      o  = reinterpret_cast<__m128i*>(out + (i * kUnitSize));
+        if (kUnitSize == 2) {
+            _mm_storeu_si128(o, lo);
+            _mm_storeu_si128(o + 1, hi);
+        } else if (kBigEndian) {
+            _mm_storeu_si128(o, _mm_unpacklo_epi16(zero, lo));
+            _mm_storeu_si128(o + 1, _mm_unpackhi_epi16(zero, lo));
+            _mm_storeu_si128(o + 2, _mm_unpacklo_epi16(zero, hi));
+            _mm_storeu_si128(o + 3, _mm_unpackhi_epi16(zero, hi));
+        } else {
+            _mm_storeu_si128(o, _mm_unpacklo_epi16(lo, zero));
+            _mm_storeu_si128(o + 1, _mm_unpackhi_epi16(lo, zero));
+            _mm_storeu_si128(o + 2, _mm_unpacklo_epi16(hi, zero));
+            _mm_storeu_si128(o + 3, _mm_unpackhi_epi16(hi, zero));
+        }
+    }
+#elif defined(SFZ_ENCODING_NEON)
+    const uint8x16_t zero = vdupq_n_u8(0);
+    for (; (i + 16) <= size; i += 16) {
+        const uint8x16_t v = vld1q_u8(in + i);
+        if (vmaxvq_u8(v) >= 0x80) {
+            break;
+        }
+        uint8_t* o = out + (i * kUnitSize);
+        if (kUnitSize == 2) {
+            uint8x16x2_t units;
+            units.val[0] = kBigEndian ? zero : v;
+            units.val[1] = kBigEndian ? v : zero;
+            vst2q_u8(o, units);
+        } else {
+            uint8x16x4_t units;
+            units.val[0] = kBigEndian ? zero : v;
+            units.val[1] = zero;
+            units.val[2] = zero;
+            units.val[3] = kBigEndian ? v : zero;
+            vst4q_u8(o, units);
+        }
+    }
+#endif
+    for (; (i < size) && (in[i] < 0x80); ++i) {
+        write_unit<kUnitSize, kBigEndian>(in[i], out + (i * kUnitSize));
+    }
+    return i;
+}
+
+// Converts the longest prefix of `units` code units in `in` which are all ASCII, 16 units at a
+// time where possible, by dropping their zero bytes.
+// @returns             The number of units converted.
+template <int kUnitSize, bool kBigEndian>
+int narrow_ascii(const uint8_t* in, int units, uint8_t* out) {
+    int i = 0;
+#if defined(SFZ_ENCODING_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; (i + 16) <= units; i += 16) {
+        const __m128i* p = reinterpret_cast<const __m128i*>(in + (i * kUnitSize));
+        __m128i        a = _mm_loadu_si128(p);
+        __m128i        b = _mm_loadu_si128(p + 1);
+        __m128i        packed;
+        if (kUnitSize == 2) {
+            // Only the low seven bits of each unit may be set; read as a little-endian lane, a
+            // big-endian unit has its bytes swapped.
+            const __m128i high =
+                    _mm_set1_epi16(static_cast<short>(kBigEndian ? 0x80ff : 0xff80));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(_mm_or_si128(a, b), high), zero)) !=
+                0xffff) {
+                break;
+            } else if (kBigEndian) {
+                a = _mm_srli_epi16(a, 8);
+                b = _mm_srli_epi16(b, 8);
+            }
+            packed = _mm_packus_epi16(a, b);
+        } else {
+            __m128i       c    = _mm_loadu_si128(p + 2);
+            __m128i       d    = _mm_loadu_si128(p + 3);
+            const __m128i high = _mm_set1_epi32(kBigEndian ? 0x80ffffff : 0xffffff80);
+            const __m128i all  = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(all, high), zero)) != 0xffff) {
+                break;
+            } else if (kBigEndian) {
+                a = _mm_srli_epi32(a, 24);
+                b = _mm_srli_epi32(b, 24);
+                c = _mm_srli_epi32(c, 24);
+                d = _mm_srli_epi32(d, 24);
+            }
+            packed = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), packed);
+    }
+#elif defined(SFZ_ENCODING_NEON)
+    for (; (i + 16) <= units; i += 16) {
+        const uint8_t* p = in + (i * kUnitSize);
+        uint8x16_t     low, high;
+        if (kUnitSize == 2) {
+            const uint8x16x2_t v = vld2q_u8(p);
+            low                  = v.val[kBigEndian ? 1 : 0];
+            high                 = v.val[kBigEndian ? 0 : 1];
+        } else {
+            const uint8x16x4_t v = vld4q_u8(p);
+            low                  = v.val[kBigEndian ? 3 : 0];
+            high = vorrq_u8(vorrq_u8(v.val[1], v.val[2]), v.val[kBigEndian ? 0 : 3]);
+        }
+        if ((vmaxvq_u8(high) != 0) || (vmaxvq_u8(low) >= 0x80)) {
+            break;
+        }
+        vst1q_u8(out + i, low);
+    }
+#endif
+    for (; i < units; ++i) {
+        const uint32_t unit = read_unit<kUnitSize, kBigEndian>(in + (i * kUnitSize));
+        if (unit >= 0x80) {
+            break;
+        }
+        out[i] = unit;
+    }
+    return i;
+}
+
+// Converts UTF-8 to UTF-16 or UTF-32.  `out` must have room for `kUnitSize` bytes per byte of
+// `in`.  Invalid sequences are replaced with kUnknownCodePoint.
+// @returns             The number of bytes written.
+template <int kUnitSize, bool kBigEndian>
+int encode_units(const uint8_t* in, int size, uint8_t* out) {
+    uint8_t* const begin = out;
+    int            i     = 0;
+    while (i < size) {
+        // Runes before the next invalid sequence, if any, can be read without checking each.
+        const int valid = i + utf8::validate(pn::data_view{in + i, size - i});
+        while (i < valid) {
+            const int run = widen_ascii<kUnitSize, kBigEndian>(in + i, valid - i, out);
+            out += run * kUnitSize;
+            i += run;
+            while ((i < valid) && (in[i] >= 0x80)) {
+                uint32_t rune;
+                i += read_utf8(in + i, &rune);
+                out += write_units<kUnitSize, kBigEndian>(rune, out);
+            }
+        }
+
+        if (i < size) {
+            out += write_units<kUnitSize, kBigEndian>(kUnknownCodePoint.value(), out);
+            i += utf8_span(in + i, size - i);
+        }
+    }
+    return out - begin;
+}
+
+// The most UTF-8 that `size` bytes of UTF-16 or UTF-32 can decode to.  A UTF-16 unit takes up to
+// 3 bytes, or 4 for a surrogate pair; a UTF-32 unit takes up to 4.  A partial unit at the end
+// takes 3.
+template <int kUnitSize>
+inline int max_utf8_size(int size) {
+    return ((kUnitSize == 2) ? 3 : 4) * (size / kUnitSize) + 3;
+}
+
+// Converts UTF-16 or UTF-32 to UTF-8.  `out` must have room for max_utf8_size() bytes.  Unpaired
+// surrogates, units which aren't code points, and a partial unit are replaced with
+// kUnknownCodePoint.
+// @returns             The number of bytes written.
+template <int kUnitSize, bool kBigEndian>
+int decode_units(const uint8_t* in, int size, uint8_t* out) {
+    uint8_t* const begin = out;
+    const int      units = size / kUnitSize;
+    int            i     = 0;
+    while (i < units) {
+        const int run = narrow_ascii<kUnitSize, kBigEndian>(in + (i * kUnitSize), units - i, out);
+        out += run;
+        i += run;
+
+        while (i < units) {
+#if defined(SFZ_ENCODING_SSE2)
+            // Blocks of UTF-16 from U+80 to U+7FF, which covers most alphabets besides Latin,
+            // become two bytes per unit: a lead byte in the low half of each lane, and a
+            // continuation byte in the high half.
+            if ((kUnitSize == 2) && ((i + 8) <= units)) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + (i * 2)));
+                if (kBigEndian) {
+                    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+                }
+                const __m128i zero  = _mm_setzero_si128();
+                const __m128i ascii = _mm_cmpeq_epi16(
+                        _mm_and_si128(v, _mm_set1_epi16(static_cast<short>(0xff80))), zero);
+                const __m128i narrow =
+                        _mm_cmpeq_epi16(_mm_subs_epu16(v, _mm_set1_epi16(0x7ff)), zero);
+                if ((_mm_movemask_epi8(ascii) == 0) && (_mm_movemask_epi8(narrow) == 0xffff)) {
+                    const __m128i lead = _mm_or_si128(
+                            _mm_srli_epi16(v, 6), _mm_set1_epi16(static_cast<short>(0xc0)));
+                    const __m128i cont = _mm_or_si128(
+                            _mm_and_si128(v, _mm_set1_epi16(0x3f)),
+                            _mm_set1_epi16(static_cast<short>(0x80)));
+                    _mm_storeu_si128(
+                            reinterpret_cast<__m128i*>(out),
+                            _mm_or_si128(lead, _mm_slli_epi16(cont, 8)));
+                    out += 16;
+                    i += 8;
+                    continue;
+                }
+            }
+#elif defined(SFZ_ENCODING_NEON)
+            if ((kUnitSize == 2) && ((i + 8) <= units)) {
+                uint16x8_t v = vreinterpretq_u16_u8(vld1q_u8(in + (i * 2)));
+                if (kBigEndian) {
+                    v = vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(v)));
+                }
+                if ((vminvq_u16(v) >= 0x80) && (vmaxvq_u16(v) < 0x800)) {
+                    const uint16x8_t lead = vorrq_u16(vshrq_n_u16(v, 6), vdupq_n_u16(0xc0));
+                    const uint16x8_t cont =
+                            vorrq_u16(vandq_u16(v, vdupq_n_u16(0x3f)), vdupq_n_u16(0x80));
+                    vst1q_u8(out, vreinterpretq_u8_u16(vorrq_u16(lead, vshlq_n_u16(cont, 8))));
+                    out += 16;
+                    i += 8;
+                    continue;
+                }
+            }
+#endif
+            uint32_t unit = read_unit<kUnitSize, kBigEndian>(in + (i * kUnitSize));
+            if (unit < 0x80) {
+                break;
+            }
+            ++i;
+            if ((kUnitSize == 2) && is_high_surrogate(unit) && (i < units)) {
+                const uint32_t low = read_unit<2, kBigEndian>(in + (i * 2));
+                if (is_low_surrogate(low)) {
+                    unit = 0x10000 + ((unit - 0xd800) << 10) + (low - 0xdc00);
+                    ++i;
+                }
+            }
+            if (!is_valid_code_point(unit)) {
+                unit = kUnknownCodePoint.value();
+            }
+            out += write_utf8(unit, out);
+        }
+    }
+    if ((size % kUnitSize) != 0) {
+        out += write_utf8(kUnknownCodePoint.value(), out);
+    }
+    return out - begin;
+}
+
+// Returns the number of bytes that decode_units() would write, without writing them.  Each UTF-16
+// unit takes 1 to 3 bytes, by its value, except that a high surrogate followed by a low one takes
+// 4 together, rather than 3 each.  A UTF-32 unit takes 1 to 4 bytes, or 3 for a replacement.
+//
+// The length of each unit is computed 8 or 4 at a time with SIMD where available, by adding its
+// comparison masks, which are -1 where true, to its largest length.  In UTF-16, the unit after
+// each one is loaded too, to find pairs, so the last block stops one unit short of the end.
+template <int kUnitSize, bool kBigEndian>
+int decoded_units_length(const uint8_t* in, int size) {
+    const int units  = size / kUnitSize;
+    int       length = ((size % kUnitSize) != 0) ? 3 : 0;
+    int       i      = 0;
+#if defined(SFZ_ENCODING_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    if (kUnitSize == 2) {
+        // 16-bit lanes gain at most 3 per block, so they're summed every 8192 blocks.
+        while ((i + 9) <= units) {
+            __m128i sums = zero;
+            for (int end = std::min(units - 8, i + (8192 * 8)); i < end; i += 8) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + (i * 2)));
+                __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + (i * 2) + 2));
+                if (kBigEndian) {
+                    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+                    w = _mm_or_si128(_mm_slli_epi16(w, 8), _mm_srli_epi16(w, 8));
+                }
+                const __m128i surrogate = _mm_set1_epi16(static_cast<short>(0xfc00));
+                const __m128i below80   = _mm_cmpeq_epi16(
+                        _mm_and_si128(v, _mm_set1_epi16(static_cast<short>(0xff80))), zero);
+                const __m128i below800 =
+                        _mm_cmpeq_epi16(_mm_subs_epu16(v, _mm_set1_epi16(0x7ff)), zero);
+                const __m128i pair = _mm_and_si128(
+                        _mm_cmpeq_epi16(
+                                _mm_and_si128(v, surrogate),
+                                _mm_set1_epi16(static_cast<short>(0xd800))),
+                        _mm_cmpeq_epi16(
+                                _mm_and_si128(w, surrogate),
+                                _mm_set1_epi16(static_cast<short>(0xdc00))));
+                sums = _mm_add_epi16(sums, _mm_add_epi16(below80, below800));
+                sums = _mm_add_epi16(sums, _mm_add_epi16(pair, pair));
+                sums = _mm_add_epi16(sums, _mm_set1_epi16(3));
+            }
+            const __m128i quads = _mm_madd_epi16(sums, _mm_set1_epi16(1));
+            const __m128i pairs = _mm_add_epi32(quads, _mm_srli_si128(quads, 8));
+            length += _mm_cvtsi128_si32(_mm_add_epi32(pairs, _mm_srli_si128(pairs, 4)));
+        }
+    } else {
+        __m128i sums = zero;
+        for (; (i + 4) <= units; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + (i * 4)));
+            if (kBigEndian) {
+                v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+                v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+                v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+            }
+            const __m128i below80 = _mm_cmpeq_epi32(
+                    _mm_and_si128(v, _mm_set1_epi32(static_cast<int>(0xffffff80))), zero);
+            const __m128i below800 = _mm_cmpeq_epi32(
+                    _mm_and_si128(v, _mm_set1_epi32(static_cast<int>(0xfffff800))), zero);
+            const __m128i below10000 = _mm_cmpeq_epi32(_mm_srli_epi32(v, 16), zero);
+            const __m128i invalid = _mm_cmpgt_epi32(_mm_srli_epi32(v, 16), _mm_set1_epi32(0x10));
+            sums = _mm_add_epi32(sums, _mm_add_epi32(below80, below800));
+            sums = _mm_add_epi32(sums, _mm_add_epi32(below10000, invalid));
+            sums = _mm_add_epi32(sums, _mm_set1_epi32(4));
+        }
+        const __m128i pairs = _mm_add_epi32(sums, _mm_srli_si128(sums, 8));
+        length += _mm_cvtsi128_si32(_mm_add_epi32(pairs, _mm_srli_si128(pairs, 4)));
+    }
+#elif defined(SFZ_ENCODING_NEON)
+    if (kUnitSize == 2) {
+        while ((i + 9) <= units) {
+            uint16x8_t sums = vdupq_n_u16(0);
+            for (int end = std::min(units - 8, i + (8192 * 8)); i < end; i += 8) {
+                uint8x16_t v = vld1q_u8(in + (i * 2));
+                uint8x16_t w = vld1q_u8(in + (i * 2) + 2);
+                if (kBigEndian) {
+                    v = vrev16q_u8(v);
+                    w = vrev16q_u8(w);
+                }
+                const uint16x8_t u = vreinterpretq_u16_u8(v);
+                const uint16x8_t pair = vandq_u16(
+                        vceqq_u16(vandq_u16(u, vdupq_n_u16(0xfc00)), vdupq_n_u16(0xd800)),
+                        vceqq_u16(
+                                vandq_u16(vreinterpretq_u16_u8(w), vdupq_n_u16(0xfc00)),
+                                vdupq_n_u16(0xdc00)));
+                sums = vaddq_u16(sums, vcltq_u16(u, vdupq_n_u16(0x80)));
+                sums = vaddq_u16(sums, vcltq_u16(u, vdupq_n_u16(0x800)));
+                sums = vaddq_u16(sums, vaddq_u16(pair, pair));
+                sums = vaddq_u16(sums, vdupq_n_u16(3));
+            }
+            length += vaddlvq_u16(sums);
+        }
+    } else {
+        uint32x4_t sums = vdupq_n_u32(0);
+        for (; (i + 4) <= units; i += 4) {
+            uint8x16_t v = vld1q_u8(in + (i * 4));
+            if (kBigEndian) {
+                v = vrev32q_u8(v);
+            }
+            const uint32x4_t u = vreinterpretq_u32_u8(v);
+            sums = vaddq_u32(sums, vcltq_u32(u, vdupq_n_u32(0x80)));
+            sums = vaddq_u32(sums, vcltq_u32(u, vdupq_n_u32(0x800)));
+            sums = vaddq_u32(sums, vcltq_u32(u, vdupq_n_u32(0x10000)));
+            sums = vaddq_u32(sums, vcgtq_u32(u, vdupq_n_u32(0x10ffff)));
+            sums = vaddq_u32(sums, vdupq_n_u32(4));
+        }
+        length += vaddvq_u32(sums);
+    }
+#endif
+    for (; i < units; ++i) {
+        const uint32_t unit = read_unit<kUnitSize, kBigEndian>(in + (i * kUnitSize));
+        if (kUnitSize == 2) {
+            length += 1 + (unit >= 0x80) + (unit >= 0x800);
+            if (is_high_surrogate(unit) && ((i + 1) < units) &&
+                is_low_surrogate(read_unit<2, kBigEndian>(in + ((i + 1) * 2)))) {
+                length -= 2;
+            }
+        } else if (unit > 0x10ffff) {
+            length += 3;
+        } else {
+            length += 1 + (unit >= 0x80) + (unit >= 0x800) + (unit >= 0x10000);
+        }
+    }
+    return length;
+}
+
+// Returns the last offset in UTF-16 or UTF-32 at or before `n` where the input may be split: the
+// end of a whole unit, but not within a surrogate pair.
+template <int kUnitSize, bool kBigEndian>
+int unit_split(const uint8_t* in, int size, int n) {
+    if (n == size) {
+        return n;
+    }
+    n -= n % kUnitSize;
+    if ((kUnitSize == 2) && (n > 0) && ((n + 2) <= size) &&
+        is_high_surrogate(read_unit<2, kBigEndian>(in + n - 2)) &&
+        is_low_surrogate(read_unit<2, kBigEndian>(in + n))) {
+        n -= 2;
+    }
+    return n;
+}
+
+template <int kUnitSize, bool kBigEndian>
+struct utf_codec {
+    int encode(const uint8_t* in, int size, uint8_t* out) const {
+        return encode_units<kUnitSize, kBigEndian>(in, size, out);
+    }
+    int decode(const uint8_t* in, int size, uint8_t* out) const {
+        return decode_units<kUnitSize, kBigEndian>(in, size, out);
+    }
+
+    pn::data encode(pn::string_view string) const {
+        return convert_to_data(kUnitSize * string.size(), [&](uint8_t* out) {
+            return encode(bytes_of(string), string.size(), out);
+        });
+    }
+    pn::string decode(pn::data_view data) const {
+        return convert_to_string(max_utf8_size<kUnitSize>(data.size()), [&](uint8_t* out) {
+            return decode(data.data(), data.size(), out);
+        });
+    }
+
+    // Each sequence of UTF-8, valid or not, becomes one code point, which takes a unit, or in
+    // UTF-16, two if it's outside the basic multilingual plane.
+    int encoded_length(const uint8_t* in, int size) const {
+        const utf8_counts counts = count_sequences(in, size);
+        return kUnitSize * counts.sequences + ((kUnitSize == 2) ? 2 * counts.supplementary : 0);
+    }
+    int decoded_length(const uint8_t* in, int size) const {
+        return decoded_units_length<kUnitSize, kBigEndian>(in, size);
+    }
+    bool can_encode(const uint8_t* in, int size) const {
+        return utf8::validate(pn::data_view{in, size}) == size;
+    }
+
+    static output_bound encode_bound() { return {1, kUnitSize, 0}; }
+    static output_bound decode_bound() { return {kUnitSize, (kUnitSize == 2) ? 3 : 4, 3}; }
+    static int          decode_split(const uint8_t* in, int size, int n) {
+        return unit_split<kUnitSize, kBigEndian>(in, size, n);
+    }
+};
+
+}  // namespace
+
+namespace utf16le {
+
+namespace {
+
+utf_codec<2, false> codec() { return utf_codec<2, false>{}; }
+
+}  // namespace
+
+pn::data   encode(pn::string_view string) { return codec().encode(string); }
+pn::string decode(pn::data_view data) { return codec().decode(data); }
+
+transcode_result encode_into(pn::string_view string, uint8_t* out, int capacity) {
+    return sfz::encode_into(codec(), string, out, capacity);
+}
+transcode_result decode_into(pn::data_view data, uint8_t* out, int capacity) {
+    return sfz::decode_into(codec(), data, out, capacity);
+}
+void encode_append(pn::string_view string, pn::data* out) {
+    sfz::encode_append(codec(), string, out);
+}
+void decode_append(pn::data_view data, pn::string* out) { sfz::decode_append(codec(), data, out); }
+
+int encoded_length(pn::string_view string) {
+    return codec().encoded_length(bytes_of(string), string.size());
+}
+int decoded_length(pn::data_view data) { return codec().decoded_length(data.data(), data.size()); }
+bool can_encode(pn::string_view string) {
+    return codec().can_encode(bytes_of(string), string.size());
+}
+
+}  // namespace utf16le
+
+namespace utf16be {
+
+namespace {
+
+utf_codec<2, true> codec() { return utf_codec<2, true>{}; }
+
+}  // namespace
+
+pn::data   encode(pn::string_view string) { return codec().encode(string); }
+pn::string decode(pn::data_view data) { return codec().decode(data); }
+
+transcode_result encode_into(pn::string_view string, uint8_t* out, int capacity) {
+    return sfz::encode_into(codec(), string, out, capacity);
+}
+transcode_result decode_into(pn::data_view data, uint8_t* out, int capacity) {
+    return sfz::decode_into(codec(), data, out, capacity);
+}
+void encode_append(pn::string_view string, pn::data* out) {
+    sfz::encode_append(codec(), string, out);
+}
+void decode_append(pn::data_view data, pn::string* out) { sfz::decode_append(codec(), data, out); }
+
+int encoded_length(pn::string_view string) {
+    return codec().encoded_length(bytes_of(string), string.size());
+}
+int decoded_length(pn::data_view data) { return codec().decoded_length(data.data(), data.size()); }
+bool can_encode(pn::string_view string) {
+    return codec().can_encode(bytes_of(string), string.size());
+}
+
+}  // namespace utf16be
+
+namespace utf32 {
+
+namespace {
+
+utf_codec<4, true> codec() { return utf_codec<4, true>{}; }
+
+}  // namespace
+
+pn::data   encode(pn::string_view string) { return codec().encode(string); }
+pn::string decode(pn::data_view data) { return codec().decode(data); }
+
+transcode_result encode_into(pn::string_view string, uint8_t* out, int capacity) {
+    return sfz::encode_into(codec(), string, out, capacity);
+}
+transcode_result decode_into(pn::data_view data, uint8_t* out, int capacity) {
+    return sfz::decode_into(codec(), data, out, capacity);
+}
+void encode_append(pn::string_view string, pn::data* out) {
+    sfz::encode_append(codec(), string, out);
+}
+void decode_append(pn::data_view data, pn::string* out) { sfz::decode_append(codec(), data, out); }
+
+int encoded_length(pn::string_view string) {
+    return codec().encoded_length(bytes_of(string), string.size());
+}
+int decoded_length(pn::data_view data) { return codec().decoded_length(data.data(), data.size()); }
+bool can_encode(pn::string_view string) {
+    return codec().can_encode(bytes_of(string), string.size());
+}
+
+}  // namespace utf32
+
+namespace {
+
+// A base64 alphabet, with the tables that its SIMD kernels translate with.  The kernels follow
+// Muła and Lemire, "Faster Base64 Encoding and Decoding Using AVX2 Instructions" (2018).
+struct base64_alphabet {
+    base64_alphabet(const char* chars, bool pad);
+
+    const char* chars;          // The characters for values 0 to 63.
+    bool        pad;            // Whether the last group is padded to 4 characters with "=".
+    int8_t      values[0x100];  // The value of each character, or -1.
+
+    // Added to a value to give its character, indexed by the value's range: 0 for A to Z, 1 for
+    // a to z, 2 to 11 for digits, and 12 and 13 for the last two characters.
+    int8_t encode_offsets[16];
+
+    // Characters are sorted into rows by their high nibble.  Rows that allow the same low
+    // nibbles share a bit in decode_high, and decode_low has that bit set for each low nibble
+    // that they don't allow, so a character is invalid if its entries share a bit.
+    uint8_t decode_high[16];
+    uint8_t decode_low[16];
+
+    // Added to a character to give its value, indexed by its high nibble, or for the one
+    // character whose offset differs from the rest of its row, its high nibble plus 8.
+    int8_t  decode_offsets[16];
+    uint8_t special;
+};
+
+base64_alphabet::base64_alphabet(const char* chars, bool pad)
+        : chars{chars},
+          pad{pad},
+          encode_offsets{},
+          decode_high{},
+          decode_low{},
+          decode_offsets{},
+          special{0} {
+    memset(values, -1, sizeof(values));
+    for (int i : range(64)) {
+        values[static_cast<uint8_t>(chars[i])] = i;
+    }
+
+    encode_offsets[0] = 'A';
+    encode_offsets[1] = 'a' - 26;
+    for (int i : range(2, 12)) {
+        encode_offsets[i] = '0' - 52;
+    }
+    encode_offsets[12] = chars[62] - 62;
+    encode_offsets[13] = chars[63] - 63;
+
+    uint16_t allowed[16] = {};
+    bool     seen[16]    = {};
+    for (int i : range(64)) {
+        const int row = static_cast<uint8_t>(chars[i]) >> 4;
+        allowed[row] |= 1 << (chars[i] & 0xf);
+        if (!seen[row]) {
+            seen[row]           = true;
+            decode_offsets[row] = i - chars[i];
+        } else if (decode_offsets[row] != (i - chars[i])) {
+            special                 = chars[i];
+            decode_offsets[row + 8] = i - chars[i];
+        }
+    }
+    uint16_t classes[8];
+    int      class_count = 0;
+    for (int row : range(16)) {
+        int c = 0;
+        while ((c < class_count) && (classes[c] != allowed[row])) {
+            ++c;
+        }
+        if (c == class_count) {
+            classes[class_count++] = allowed[row];
+        }
+        decode_high[row] = 1 << c;
+        for (int low : range(16)) {
+            if (!(allowed[row] & (1 << low))) {
+                decode_low[low] |= 1 << c;
+            }
+        }
+    }
+}
+
+const base64_alphabet& standard_alphabet() {
+    static const base64_alphabet alphabet(
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/", true);
+    return alphabet;
+}
+
+const base64_alphabet& url_alphabet() {
+    static const base64_alphabet alphabet(
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_", false);
+    return alphabet;
+}
+
+// SIMD kernels encode or decode as many whole blocks as they can, from the start of the input,
+// while the output has room for a whole block.  Decoders stop at the first block with an
+// invalid character, leaving the scalar code to report it.
+// @returns             The number of bytes or characters read.
+typedef int (*base64_kernel)(
+        const uint8_t* in, int size, uint8_t* out, int capacity, const base64_alphabet& alphabet);
+
+int base64_scalar(const uint8_t*, int, uint8_t*, int, const base64_alphabet&) { return 0; }
+
+#if defined(SFZ_ENCODING_X86_DISPATCH)
+
+// Encodes 24 bytes into 32 characters at a time.  The two 12-byte halves are loaded into separate
+// lanes, then each group of 3 bytes is spread across a 32-bit word, and its four 6-bit values
+// shifted into place with multiplies.
+SFZ_TARGET("avx2")
+int encode_base64_avx2(
+        const uint8_t* in, int size, uint8_t* out, int capacity,
+        const base64_alphabet& alphabet) {
+    const __m256i shuffle = _mm256_setr_epi8(
+            1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10, 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7,
+            10, 9, 11, 10);
+    const __m256i offsets = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(alphabet.encode_offsets)));
+    int i = 0;
+    int o = 0;
+    for (; ((i + 28) <= size) && ((o + 32) <= capacity); i += 24, o += 32) {
+        __m256i v = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 12)), 1);
+        v               = _mm256_shuffle_epi8(v, shuffle);
+        const __m256i a = _mm256_mulhi_epu16(
+                _mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00)),
+                _mm256_set1_epi32(0x04000040));
+        const __m256i b = _mm256_mullo_epi16(
+                _mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0)),
+                _mm256_set1_epi32(0x01000010));
+        const __m256i values = _mm256_or_si256(a, b);
+
+        __m256i index = _mm256_subs_epu8(values, _mm256_set1_epi8(51));
+        index         = _mm256_sub_epi8(index, _mm256_cmpgt_epi8(values, _mm256_set1_epi8(25)));
+        _mm256_storeu_si256(
+                reinterpret_cast<__m256i*>(out + o),
+                _mm256_add_epi8(values, _mm256_shuffle_epi8(offsets, index)));
+    }
+    return i;
+}
+
+// Decodes 32 characters into 24 bytes at a time.  The 6-bit values are merged in pairs with
+// multiply-adds, then the resulting 3 bytes of each word are gathered.  Writes 8 bytes past the
+// 24 it decodes.
+SFZ_TARGET("avx2")
+int decode_base64_avx2(
+        const uint8_t* in, int size, uint8_t* out, int capacity,
+        const base64_alphabet& alphabet) {
+    const __m256i high_table = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(alphabet.decode_high)));
+    const __m256i low_table = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(alphabet.decode_low)));
+    const __m256i offsets = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(alphabet.decode_offsets)));
+    const __m256i nibble  = _mm256_set1_epi8(0x0f);
+    const __m256i special = _mm256_set1_epi8(static_cast<char>(alphabet.special));
+    const __m256i gather  = _mm256_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1, 2, 1, 0, 6, 5, 4, 10, 9, 8, 14,
+            13, 12, -1, -1, -1, -1);
+    int i = 0;
+    int o = 0;
+    for (; ((i + 32) <= size) && ((o + 32) <= capacity); i += 32, o += 24) {
+        __m256i       v    = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        const __m256i high = _mm256_and_si256(_mm256_srli_epi32(v, 4), nibble);
+        const __m256i low  = _mm256_and_si256(v, nibble);
+        if (!_mm256_testz_si256(
+                    _mm256_shuffle_epi8(high_table, high), _mm256_shuffle_epi8(low_table, low))) {
+            break;
+        }
+        const __m256i row = _mm256_add_epi8(
+                high, _mm256_and_si256(_mm256_cmpeq_epi8(v, special), _mm256_set1_epi8(8)));
+        v = _mm256_add_epi8(v, _mm256_shuffle_epi8(offsets, row));
+        v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+        v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+        v = _mm256_shuffle_epi8(v, gather);
+        v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + o), v);
+    }
+    return i;
+}
+
+#elif defined(SFZ_ENCODING_NEON)
+
+// Encodes 48 bytes into 64 characters at a time.  Loads deinterleave the bytes of each group, and
+// stores interleave the characters.
+int encode_base64_neon(
+        const uint8_t* in, int size, uint8_t* out, int capacity,
+        const base64_alphabet& alphabet) {
+    const uint8_t* const chars = reinterpret_cast<const uint8_t*>(alphabet.chars);
+    const uint8x16x4_t   table = {
+            {vld1q_u8(chars), vld1q_u8(chars + 16), vld1q_u8(chars + 32), vld1q_u8(chars + 48)}};
+    const uint8x16_t mask = vdupq_n_u8(0x3f);
+    int              i    = 0;
+    int              o    = 0;
+    for (; ((i + 48) <= size) && ((o + 64) <= capacity); i += 48, o += 64) {
+        const uint8x16x3_t bytes = vld3q_u8(in + i);
+        uint8x16x4_t       values;
+        values.val[0] = vshrq_n_u8(bytes.val[0], 2);
+        values.val[1] = vandq_u8(
+                vorrq_u8(vshlq_n_u8(bytes.val[0], 4), vshrq_n_u8(bytes.val[1], 4)), mask);
+        values.val[2] = vandq_u8(
+                vorrq_u8(vshlq_n_u8(bytes.val[1], 2), vshrq_n_u8(bytes.val[2], 6)), mask);
+        values.val[3] = vandq_u8(bytes.val[2], mask);
+        for (int k = 0; k < 4; ++k) {
+            values.val[k] = vqtbl4q_u8(table, values.val[k]);
+        }
+        vst4q_u8(out + o, values);
+    }
+    return i;
+}
+
+// Decodes 64 characters into 48 bytes at a time.  Characters are looked up in the 128-entry
+// table of values, in two halves; -1 for an invalid character, or a high bit in the character,
+// marks the block as invalid.
+int decode_base64_neon(
+        const uint8_t* in, int size, uint8_t* out, int capacity,
+        const base64_alphabet& alphabet) {
+    const uint8_t* const values = reinterpret_cast<const uint8_t*>(alphabet.values);
+    const uint8x16x4_t   low    = {
+            {vld1q_u8(values), vld1q_u8(values + 16), vld1q_u8(values + 32),
+             vld1q_u8(values + 48)}};
+    const uint8x16x4_t high = {
+            {vld1q_u8(values + 64), vld1q_u8(values + 80), vld1q_u8(values + 96),
+             vld1q_u8(values + 112)}};
+    int i = 0;
+    int o = 0;
+    for (; ((i + 64) <= size) && ((o + 48) <= capacity); i += 64, o += 48) {
+        const uint8x16x4_t chars = vld4q_u8(in + i);
+        uint8x16x4_t       v;
+        uint8x16_t         error = vdupq_n_u8(0);
+        for (int k = 0; k < 4; ++k) {
+            v.val[k] = vqtbx4q_u8(
+                    vqtbl4q_u8(low, chars.val[k]), high,
+                    veorq_u8(chars.val[k], vdupq_n_u8(0x40)));
+            error = vorrq_u8(error, vorrq_u8(v.val[k], chars.val[k]));
+        }
+        if (vmaxvq_u8(error) >= 0x80) {
+            break;
+        }
+        uint8x16x3_t bytes;
+        bytes.val[0] = vorrq_u8(vshlq_n_u8(v.val[0], 2), vshrq_n_u8(v.val[1], 4));
+        bytes.val[1] = vorrq_u8(vshlq_n_u8(v.val[1], 4), vshrq_n_u8(v.val[2], 2));
+        bytes.val[2] = vorrq_u8(vshlq_n_u8(v.val[2], 6), v.val[3]);
+        vst3q_u8(out + o, bytes);
+    }
+    return i;
+}
+
+#endif
+
+base64_kernel select_base64_encode() {
+#if defined(SFZ_ENCODING_X86_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return encode_base64_avx2;
+    }
+#elif defined(SFZ_ENCODING_NEON)
+    return encode_base64_neon;
+#endif
+    return base64_scalar;
+}
+
+base64_kernel select_base64_decode() {
+#if defined(SFZ_ENCODING_X86_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return decode_base64_avx2;
+    }
+#elif defined(SFZ_ENCODING_NEON)
+    return decode_base64_neon;
+#endif
+    return base64_scalar;
+}
+
+void invalid_base64(int offset) {
+    throw std::runtime_error(pn::format("invalid base64 at offset {0}", offset).c_str());
+}
+
+int base64_encoded_length(int size, const base64_alphabet& alphabet) {
+    if (alphabet.pad || ((size % 3) == 0)) {
+        return 4 * ((size + 2) / 3);
+    }
+    return (4 * (size / 3)) + (size % 3) + 1;
+}
+
+int base64_decoded_length(pn::string_view string, const base64_alphabet& alphabet) {
+    const int size = string.size();
+    if (alphabet.pad) {
+        int padding = 0;
+        for (int i = size - 1; (i >= std::max(0, size - 2)) && (string.data()[i] == '='); --i) {
+            ++padding;
+        }
+        return (3 * (size / 4)) - padding;
+    }
+    return (3 * (size / 4)) + std::max(0, (size % 4) - 1);
+}
+
+transcode_result encode_base64_into(
+        pn::data_view data, uint8_t* out, int capacity, const base64_alphabet& alphabet) {
+    static const base64_kernel kernel = select_base64_encode();
+    const uint8_t* const       in     = data.data();
+    const int                  size   = data.size();
+    const char* const          chars  = alphabet.chars;
+
+    int read    = kernel(in, size, out, capacity, alphabet);
+    int written = 4 * (read / 3);
+    for (; ((read + 3) <= size) && ((written + 4) <= capacity); read += 3, written += 4) {
+        const uint32_t group = (in[read] << 16) | (in[read + 1] << 8) | in[read + 2];
+        out[written]         = chars[group >> 18];
+        out[written + 1]     = chars[(group >> 12) & 0x3f];
+        out[written + 2]     = chars[(group >> 6) & 0x3f];
+        out[written + 3]     = chars[group & 0x3f];
+    }
+
+    // The last 1 or 2 bytes take 2 or 3 characters, plus padding.
+    const int rest = size - read;
+    if ((0 < rest) && (rest < 3) && ((written + (alphabet.pad ? 4 : rest + 1)) <= capacity)) {
+        const uint32_t group = (in[read] << 16) | ((rest == 2) ? (in[read + 1] << 8) : 0);
+        out[written++]       = chars[group >> 18];
+        out[written++]       = chars[(group >> 12) & 0x3f];
+        if (rest == 2) {
+            out[written++] = chars[(group >> 6) & 0x3f];
+        } else if (alphabet.pad) {
+            out[written++] = '=';
+        }
+        if (alphabet.pad) {
+            out[written++] = '=';
+        }
+        read = size;
+    }
+    return {read, written};
+}
+
+transcode_result decode_base64_into(
+        pn::string_view string, uint8_t* out, int capacity, const base64_alphabet& alphabet) {
+    static const base64_kernel kernel = select_base64_decode();
+    const uint8_t* const       in     = bytes_of(string);
+    const int                  size   = string.size();
+    const int8_t* const        values = alphabet.values;
+    if (((size % 4) != 0) && (alphabet.pad || ((size % 4) == 1))) {
+        throw std::runtime_error("invalid base64 length");
+    }
+
+    // All groups but the last have 4 characters, and no padding.
+    const int last    = (size == 0) ? 0 : (4 * ((size - 1) / 4));
+    int       read    = kernel(in, std::min(size, last), out, capacity, alphabet);
+    int       written = 3 * (read / 4);
+    for (; (read < last) && ((written + 3) <= capacity); read += 4, written += 3) {
+        const int a = values[in[read]], b = values[in[read + 1]], c = values[in[read + 2]],
+                  d = values[in[read + 3]];
+        if ((a | b | c | d) < 0) {
+            invalid_base64(read + ((a < 0) ? 0 : (b < 0) ? 1 : (c < 0) ? 2 : 3));
+        }
+        const uint32_t group = (a << 18) | (b << 12) | (c << 6) | d;
+        out[written]         = group >> 16;
+        out[written + 1]     = group >> 8;
+        out[written + 2]     = group;
+    }
+    if ((read != last) || (read == size)) {
+        return {read, written};
+    }
+
+    // The last group has 2 to 4 characters, after removing any padding, for 1 to 3 bytes.  Bits
+    // of the last character beyond the last byte must be zero.
+    int count = size - read;
+    if (alphabet.pad) {
+        while ((count > 2) && (in[read + count - 1] == '=')) {
+            --count;
+        }
+    }
+    if ((written + count - 1) > capacity) {
+        return {read, written};
+    }
+    uint32_t group = 0;
+    for (int i : range(count)) {
+        const int value = values[in[read + i]];
+        if (value < 0) {
+            invalid_base64(read + i);
+        }
+        group |= value << (18 - (6 * i));
+    }
+    if ((group & (0xffffff >> (8 * (count - 1)))) != 0) {
+        invalid_base64(read + count - 1);
+    }
+    for (int i : range(count - 1)) {
+        out[written++] = group >> (16 - (8 * i));
+    }
+    return {size, written};
+}
+
+pn::string encode_base64(pn::data_view data, const base64_alphabet& alphabet) {
+    const int size = base64_encoded_length(data.size(), alphabet);
+    return convert_to_string(size, [&](uint8_t* out) {
+        return encode_base64_into(data, out, size, alphabet).written;
+    });
+}
+
+pn::data decode_base64(pn::string_view string, const base64_alphabet& alphabet) {
+    // The SIMD kernels write a little past what they decode, so leave them room for it.
+    const int size = (3 * (string.size() / 4)) + 3 + 32;
+    return convert_to_data(size, [&](uint8_t* out) {
+        return decode_base64_into(string, out, size, alphabet).written;
+    });
+}
+
+}  // namespace
+
+namespace base64 {
+
+pn::string encode(pn::data_view data) { return encode_base64(data, standard_alphabet()); }
+pn::data decode(pn::string_view string) { return decode_base64(string, standard_alphabet()); }
+
+transcode_result encode_into(pn::data_view data, uint8_t* out, int capacity) {
+    return encode_base64_into(data, out, capacity, standard_alphabet());
+}
+transcode_result decode_into(pn::string_view string, uint8_t* out, int capacity) {
+    return decode_base64_into(string, out, capacity, standard_alphabet());
+}
+
+int encoded_length(int size) { return base64_encoded_length(size, standard_alphabet()); }
+int decoded_length(pn::string_view string) {
+    return base64_decoded_length(string, standard_alphabet());
+}
+
+}  // namespace base64
+
+namespace base64url {
+
+pn::string encode(pn::data_view data) { return encode_base64(data, url_alphabet()); }
+pn::data   decode(pn::string_view string) { return decode_base64(string, url_alphabet()); }
+
+transcode_result encode_into(pn::data_view data, uint8_t* out, int capacity) {
+    return encode_base64_into(data, out, capacity, url_alphabet());
+}
+transcode_result decode_into(pn::string_view string, uint8_t* out, int capacity) {
+    return decode_base64_into(string, out, capacity, url_alphabet());
+}
+
+int encoded_length(int size) { return base64_encoded_length(size, url_alphabet()); }
+int decoded_length(pn::string_view string) {
+    return base64_decoded_length(string, url_alphabet());
+}
+
+}  // namespace base64url
+
+namespace {
+
+const char kHexDigits[] = "0123456789abcdef";
+
+// Returns the value of a hex digit, or -1.
+inline int hex_digit_value(uint8_t ch) {
+    if (('0' <= ch) && (ch <= '9')) {
+        return ch - '0';
+    }
+    ch |= 0x20;  // Lowercase.
+    if (('a' <= ch) && (ch <= 'f')) {
+        return ch - 'a' + 10;
+    }
+    return -1;
+}
+
+// Encodes 16 bytes into 32 digits at a time with SIMD where available, by splitting the nibbles
+// of each byte, translating each to a digit, and interleaving them.
+// @returns             The number of bytes encoded.
+int encode_hex_blocks(const uint8_t* in, int size, uint8_t* out) {
+    int i = 0;
+#if defined(SFZ_ENCODING_SSE2)
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    const __m128i nine   = _mm_set1_epi8(9);
+    for (; (i + 16) <= size; i += 16) {
+        const __m128i v    = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i       high = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+        __m128i       low  = _mm_and_si128(v, nibble);
+        // Digits above 9 skip the 39 characters from ':' to '`'.
+        high = _mm_add_epi8(
+                _mm_add_epi8(high, _mm_set1_epi8('0')),
+                _mm_and_si128(_mm_cmpgt_epi8(high, nine), _mm_set1_epi8(39)));
+        low = _mm_add_epi8(
+                _mm_add_epi8(low, _mm_set1_epi8('0')),
+                _mm_and_si128(_mm_cmpgt_epi8(low, nine), _mm_set1_epi8(39)));
+        _mm_storeu_si128(
+                reinterpret_cast<__m128i*>(out + (2 * i)), _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128(
+                reinterpret_cast<__m128i*>(out + (2 * i) + 16), _mm_unpackhi_epi8(high, low));
+    }
+#elif defined(SFZ_ENCODING_NEON)
+    const uint8x16_t digits = vld1q_u8(reinterpret_cast<const uint8_t*>(kHexDigits));
+    for (; (i + 16) <= size; i += 16) {
+        const uint8x16_t v = vld1q_u8(in + i);
+        uint8x16x2_t     pairs;
+        pairs.val[0] = vqtbl1q_u8(digits, vshrq_n_u8(v, 4));
+        pairs.val[1] = vqtbl1q_u8(digits, vandq_u8(v, vdupq_n_u8(0x0f)));
+        vst2q_u8(out + (2 * i), pairs);
+    }
+#else
+    static_cast<void>(in);
+    static_cast<void>(size);
+    static_cast<void>(out);
+#endif
+    return i;
+}
+
+#if defined(SFZ_ENCODING_SSE2)
+// Translates 16 hex digits to their values, and sets `*valid` to false if any isn't a digit.
+inline __m128i sse2_hex_values(__m128i v, bool* valid) {
+    // Signed comparisons, so bytes above 0x7F fall outside both ranges.
+    const __m128i digit = _mm_and_si128(
+            _mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    const __m128i lower  = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    const __m128i letter = _mm_and_si128(
+            _mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+            _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+    *valid = *valid && (_mm_movemask_epi8(_mm_or_si128(digit, letter)) == 0xffff);
+    return _mm_or_si128(
+            _mm_and_si128(digit, _mm_sub_epi8(v, _mm_set1_epi8('0'))),
+            _mm_and_si128(letter, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+}
+#endif
+
+// Decodes 32 digits into 16 bytes at a time with SIMD where available.  Stops at the first block
+// with a character that isn't a hex digit, leaving the scalar code to report it.
+// @returns             The number of digits decoded.
+int decode_hex_blocks(const uint8_t* in, int size, uint8_t* out) {
+    int i = 0;
+#if defined(SFZ_ENCODING_SSE2)
+    for (; (i + 32) <= size; i += 32) {
+        bool          valid = true;
+        const __m128i a     = sse2_hex_values(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)), &valid);
+        const __m128i b = sse2_hex_values(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 16)), &valid);
+        if (!valid) {
+            break;
+        }
+        // Each 16-bit lane holds a high digit, then a low one.
+        const __m128i mask = _mm_set1_epi16(0x00f0);
+        const __m128i x =
+                _mm_or_si128(_mm_and_si128(_mm_slli_epi16(a, 4), mask), _mm_srli_epi16(a, 8));
+        const __m128i y =
+                _mm_or_si128(_mm_and_si128(_mm_slli_epi16(b, 4), mask), _mm_srli_epi16(b, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + (i / 2)), _mm_packus_epi16(x, y));
+    }
+#elif defined(SFZ_ENCODING_NEON)
+    for (; (i + 32) <= size; i += 32) {
+        const uint8x16x2_t digits = vld2q_u8(in + i);
+        uint8x16_t         values[2];
+        uint8x16_t         valid = vdupq_n_u8(0xff);
+        for (int k = 0; k < 2; ++k) {
+            const uint8x16_t digit  = vsubq_u8(digits.val[k], vdupq_n_u8('0'));
+            const uint8x16_t letter = vsubq_u8(
+                    vorrq_u8(digits.val[k], vdupq_n_u8(0x20)), vdupq_n_u8('a' - 10));
+            const uint8x16_t is_digit  = vcltq_u8(digit, vdupq_n_u8(10));
+            const uint8x16_t is_letter = vandq_u8(
+                    vcgeq_u8(letter, vdupq_n_u8(10)), vcltq_u8(letter, vdupq_n_u8(16)));
+            values[k] = vbslq_u8(is_digit, digit, letter);
+            valid     = vandq_u8(valid, vorrq_u8(is_digit, is_letter));
+        }
+        if (vminvq_u8(valid) == 0) {
+            break;
+        }
+        vst1q_u8(out + (i / 2), vorrq_u8(vshlq_n_u8(values[0], 4), values[1]));
+    }
+#else
+    static_cast<void>(in);
+    static_cast<void>(size);
+    static_cast<void>(out);
+#endif
+    return i;
+}
+
+}  // namespace
+
+namespace hex {
+
+pn::string encode(pn::data_view data) {
+    return convert_to_string(2 * data.size(), [&](uint8_t* out) {
+        return encode_into(data, out, 2 * data.size()).written;
+    });
+}
+
+pn::data decode(pn::string_view string) {
+    return convert_to_data(string.size() / 2, [&](uint8_t* out) {
+        return decode_into(string, out, string.size() / 2).written;
+    });
+}
+
+transcode_result encode_into(pn::data_view data, uint8_t* out, int capacity) {
+    const uint8_t* const in   = data.data();
+    const int            size = std::min(data.size(), capacity / 2);
+    for (int i = encode_hex_blocks(in, size, out); i < size; ++i) {
+        out[2 * i]       = kHexDigits[in[i] >> 4];
+        out[(2 * i) + 1] = kHexDigits[in[i] & 0xf];
+    }
+    return {size, 2 * size};
+}
+
+transcode_result decode_into(pn::string_view string, uint8_t* out, int capacity) {
+    if ((string.size() % 2) != 0) {
+        throw std::runtime_error("invalid hex length");
+    }
+    const uint8_t* const in   = bytes_of(string);
+    const int            size = std::min(string.size() / 2, capacity) * 2;
+    for (int i = decode_hex_blocks(in, size, out); i < size; i += 2) {
+        const int high = hex_digit_value(in[i]);
+        const int low  = hex_digit_value(in[i + 1]);
+        if ((high | low) < 0) {
+            throw std::runtime_error(
+                    pn::format("invalid hex at offset {0}", i + ((high < 0) ? 0 : 1)).c_str());
+        }
+        out[i / 2] = (high << 4) | low;
+    }
+    return {size, size / 2};
+}
+
+int encoded_length(int size) { return 2 * size; }
+int decoded_length(pn::string_view string) { return string.size() / 2; }
+
+}  // namespace hex
+
+namespace {
+
+// In single-byte encodings, every byte decodes on its own.
+int whole_bytes(pn::data_view data) { return data.size(); }
+
+// A high surrogate can't be decoded without the unit after it.
+template <bool kBigEndian>
+int whole_utf16(pn::data_view data) {
+    int size = data.size() & ~1;
+    if ((size > 0) && is_high_surrogate(read_unit<2, kBigEndian>(data.data() + size - 2))) {
+        size -= 2;
+    }
+    return size;
+}
+
+int whole_utf32(pn::data_view data) { return data.size() & ~3; }
+
+const text_encoding kAscii = {
+        "US-ASCII", ascii::encode, ascii::decode, ascii::encode_into, ascii::decode_into,
+        ascii::encoded_length, ascii::decoded_length, whole_bytes};
+const text_encoding kLatin1 = {
+        "ISO-8859-1", latin1::encode, latin1::decode, latin1::encode_into, latin1::decode_into,
+        latin1::encoded_length, latin1::decoded_length, whole_bytes};
+const text_encoding kMacRoman = {
+        "MacRoman", macroman::encode, macroman::decode, macroman::encode_into,
+        macroman::decode_into, macroman::encoded_length, macroman::decoded_length, whole_bytes};
+const text_encoding kWindows1252 = {
+        "Windows-1252", windows1252::encode, windows1252::decode, windows1252::encode_into,
+        windows1252::decode_into, windows1252::encoded_length, windows1252::decoded_length,
+        whole_bytes};
+const text_encoding kIso8859_15 = {
+        "ISO-8859-15", iso8859_15::encode, iso8859_15::decode, iso8859_15::encode_into,
+        iso8859_15::decode_into, iso8859_15::encoded_length, iso8859_15::decoded_length,
+        whole_bytes};
+const text_encoding kKoi8R = {
+        "KOI8-R", koi8r::encode, koi8r::decode, koi8r::encode_into, koi8r::decode_into,
+        koi8r::encoded_length, koi8r::decoded_length, whole_bytes};
+const text_encoding kUtf16LE = {
+        "UTF-16LE", utf16le::encode, utf16le::decode, utf16le::encode_into, utf16le::decode_into,
+        utf16le::encoded_length, utf16le::decoded_length, whole_utf16<false>};
+const text_encoding kUtf16BE = {
+        "UTF-16BE", utf16be::encode, utf16be::decode, utf16be::encode_into, utf16be::decode_into,
+        utf16be::encoded_length, utf16be::decoded_length, whole_utf16<true>};
+const text_encoding kUtf32 = {
+        "UTF-32", utf32::encode, utf32::decode, utf32::encode_into, utf32::decode_into,
+        utf32::encoded_length, utf32::decoded_length, whole_utf32};
+
+const struct {
+    const char*          name;
+    const text_encoding* encoding;
+} kEncodingNames[] = {
+        {"ascii", &kAscii},
+        {"us-ascii", &kAscii},
+        {"latin1", &kLatin1},
+        {"iso-8859-1", &kLatin1},
+        {"macroman", &kMacRoman},
+        {"macintosh", &kMacRoman},
+        {"windows-1252", &kWindows1252},
+        {"cp1252", &kWindows1252},
+        {"iso-8859-15", &kIso8859_15},
+        {"latin9", &kIso8859_15},
+        {"koi8-r", &kKoi8R},
+        {"utf-16le", &kUtf16LE},
+        {"utf-16be", &kUtf16BE},
+        {"utf-32", &kUtf32},
+        {"utf-32be", &kUtf32},
+};
+
+// Returns the next letter or digit at or after `*i` in `name`, lowercased, and advances `*i`
+// past it.  Returns 0 at the end of `name`.
+char next_name_char(pn::string_view name, int* i) {
+    while (*i < name.size()) {
+        char ch = name.data()[(*i)++];
+        if (('A' <= ch) && (ch <= 'Z')) {
+            return ch - 'A' + 'a';
+        } else if ((('a' <= ch) && (ch <= 'z')) || (('0' <= ch) && (ch <= '9'))) {
+            return ch;
+        }
+    }
+    return 0;
+}
+
+// Compares names of encodings, ignoring case and punctuation.
+bool names_match(pn::string_view a, pn::string_view b) {
+    int i = 0, j = 0;
+    while (true) {
+        char x = next_name_char(a, &i);
+        char y = next_name_char(b, &j);
+        if (x != y) {
+            return false;
+        } else if (x == 0) {
+            return true;
+        }
+    }
+}
+
+}  // namespace
+
+const text_encoding* find_encoding(pn::string_view name) {
+    for (const auto& entry : kEncodingNames) {
+        if (names_match(name, entry.name)) {
+            return entry.encoding;
+        }
+    }
+    return nullptr;
+}
+
+namespace {
+
+// Counts the zero bytes in [data, data + size) at each offset modulo 4, 16 bytes at a time with
+// SIMD where available.  Each lane counts up to 255 blocks, then lanes at the same offset are
+// summed by masking the others.
+void count_zeros_by_offset(const uint8_t* data, int size, int zeros[4]) {
+    zeros[0] = zeros[1] = zeros[2] = zeros[3] = 0;
+    int i                                     = 0;
+#if defined(SFZ_ENCODING_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    while ((i + 16) <= size) {
+        __m128i counts = zero;
+        for (int end = std::min(size - 15, i + (255 * 16)); i < end; i += 16) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            counts          = _mm_sub_epi8(counts, _mm_cmpeq_epi8(v, zero));
+        }
+        for (int k = 0; k < 4; ++k) {
+            const __m128i sums = _mm_sad_epu8(
+                    _mm_and_si128(counts, _mm_set1_epi32(static_cast<int>(0xffu << (8 * k)))),
+                    zero);
+            zeros[k] += _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+        }
+    }
+#elif defined(SFZ_ENCODING_NEON)
+    while ((i + 16) <= size) {
+        uint8x16_t counts = vdupq_n_u8(0);
+        for (int end = std::min(size - 15, i + (255 * 16)); i < end; i += 16) {
+            counts = vsubq_u8(counts, vceqq_u8(vld1q_u8(data + i), vdupq_n_u8(0)));
+        }
+        for (int k = 0; k < 4; ++k) {
+            const uint8x16_t mask = vreinterpretq_u8_u32(vdupq_n_u32(0xffu << (8 * k)));
+            zeros[k] += vaddlvq_u8(vandq_u8(counts, mask));
+        }
+    }
+#endif
+    for (; i < size; ++i) {
+        zeros[i % 4] += (data[i] == 0);
+    }
+}
+
+// Bytes which are common in text in each single-byte encoding, and rare in the others: lowercase
+// accented letters, and curly quotes and dashes where they differ.
+bool is_latin1_letter(int byte) { return (byte >= 0xdf) && (byte != 0xf7); }
+bool is_windows1252_punctuation(int byte) {
+    return (byte == 0x80) || (byte == 0x85) || ((0x91 <= byte) && (byte <= 0x94));
+}
+bool is_macroman_letter(int byte) {
+    return ((0x87 <= byte) && (byte <= 0x90)) || ((0x96 <= byte) && (byte <= 0x9f)) ||
+           (byte == 0xa7) || (byte == 0xc9) || ((0xd0 <= byte) && (byte <= 0xd5));
+}
+
+}  // namespace
+
+detected_encoding detect_encoding(pn::data_view data) {
+    const uint8_t* in   = data.data();
+    int            size = std::min(data.size(), kDetectionSampleSize);
+
+    if ((size >= 3) && (in[0] == 0xef) && (in[1] == 0xbb) && (in[2] == 0xbf)) {
+        return {nullptr, 3};
+    } else if ((size >= 4) && (in[0] == 0x00) && (in[1] == 0x00) && (in[2] == 0xfe) &&
+               (in[3] == 0xff)) {
+        return {&kUtf32, 4};
+    } else if ((size >= 2) && (in[0] == 0xfe) && (in[1] == 0xff)) {
+        return {&kUtf16BE, 2};
+    } else if ((size >= 2) && (in[0] == 0xff) && (in[1] == 0xfe)) {
+        return {&kUtf16LE, 2};
+    }
+
+    // In UTF-32, the top byte or two of every unit is zero, and in UTF-16, the high byte of each
+    // unit of ASCII, which is most units in most text.  Other encodings have few zero bytes.
+    int zeros[4];
+    count_zeros_by_offset(in, size, zeros);
+    const int units32 = size / 4;
+    if ((units32 > 0) && (zeros[0] * 10 >= units32 * 9) && (zeros[1] * 10 >= units32 * 9)) {
+        return {&kUtf32, 0};
+    }
+    const int even = zeros[0] + zeros[2];
+    const int odd  = zeros[1] + zeros[3];
+    if ((even * 4 >= size / 2) && (even > 2 * odd)) {
+        return {&kUtf16BE, 0};
+    } else if ((odd * 4 >= size / 2) && (odd > 2 * even)) {
+        return {&kUtf16LE, 0};
+    }
+
+    // If the sample cuts the data short, it might split a sequence; back up to the start of it.
+    if (size < data.size()) {
+        for (int i = 0; (i < 3) && (size > 0) && is_continuation(in[size]); ++i) {
+            --size;
+        }
+    }
+    if (utf8::validate(pn::data_view{in, size}) == size) {
+        return {nullptr, 0};
+    }
+
+    // Tally the high bytes.  Each goes in one of four histograms, by its offset, so that runs of
+    // the same byte don't each wait for the last to be counted.
+    int histogram[4][0x100] = {};
+    for (int i = ascii_prefix(in, size); i < size; i += ascii_prefix(in + i, size - i)) {
+        for (; (i < size) && (in[i] >= 0x80); ++i) {
+            ++histogram[i % 4][in[i]];
+        }
+    }
+    int latin1 = 0, windows1252 = 0, macroman = 0, controls = 0;
+    for (int byte = 0x80; byte < 0x100; ++byte) {
+        const int count = histogram[0][byte] + histogram[1][byte] + histogram[2][byte] +
+                          histogram[3][byte];
+        latin1 += is_latin1_letter(byte) ? count : 0;
+        windows1252 += is_windows1252_punctuation(byte) ? count : 0;
+        macroman += is_macroman_letter(byte) ? count : 0;
+        controls += (byte < 0xa0) ? count : 0;
+    }
+    if (macroman > (latin1 + windows1252)) {
+        return {&kMacRoman, 0};
+    } else if (controls > 0) {
+        // Bytes 0x80 to 0x9F are control characters in Latin-1, which are rare in text, but
+        // punctuation in Windows-1252, which is otherwise the same.
+        return {&kWindows1252, 0};
+    }
+    return {&kLatin1, 0};
+}
+
+namespace {
+
+// Inputs are split into pieces of about this size for encode_parallel() and decode_parallel().
+// An input smaller than two pieces is converted on the calling thread.
+const int kParallelPieceSize = 1 << 20;
+
+// Returns the bounds of pieces of [in, in + size), ending each at the offset that `split` gives
+// for an end at or after it.
+template <typename Split>
+std::vector<int> split_pieces(int size, const Split& split) {
+    const int64_t    count = std::max(1, size / kParallelPieceSize);
+    std::vector<int> bounds{0};
+    for (int64_t k = 1; k < count; ++k) {
+        bounds.push_back(std::max(bounds.back(), split(static_cast<int>(size * k / count))));
+    }
+    bounds.push_back(size);
+    return bounds;
+}
+
+// Converts each piece of [in, in + bounds.back()) in parallel, into `result`, which is a pn::data
+// or pn::string.  `measure(in, size)` gives the length of a piece's output, and
+// `convert(in, size, out, capacity)` writes it.
+template <typename Result, typename Measure, typename Convert>
+void convert_pieces(
+        const uint8_t* in, const std::vector<int>& bounds, const Measure& measure,
+        const Convert& convert, Result* result) {
+    const size_t         count = bounds.size() - 1;
+    std::vector<int64_t> offsets(count + 1, 0);
+    parallel_for(count, 1, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            offsets[k + 1] = measure(in + bounds[k], bounds[k + 1] - bounds[k]);
+        }
+    });
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    if (offsets.back() > std::numeric_limits<int>::max()) {
+        throw std::runtime_error("converted text is too long");
+    }
+
+    result->resize(offsets.back());
+    uint8_t* const out = reinterpret_cast<uint8_t*>(result->data());
+    parallel_for(count, 1, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            convert(in + bounds[k], bounds[k + 1] - bounds[k], out + offsets[k],
+                    static_cast<int>(offsets[k + 1] - offsets[k]));
+        }
+    });
+}
+
+pn::string_view string_of(const uint8_t* in, int size) {
+    return pn::string_view{reinterpret_cast<const char*>(in), size};
+}
+
+}  // namespace
+
+pn::data encode_parallel(const text_encoding& encoding, pn::string_view string) {
+    const uint8_t* in      = bytes_of(string);
+    const int      length  = string.size();
+    auto           split   = [&](int n) { return utf8_split(in, length, n); };
+    auto           measure = [&](const uint8_t* piece, int n) {
+        return encoding.encoded_length(string_of(piece, n));
+    };
+    auto convert = [&](const uint8_t* piece, int n, uint8_t* out, int capacity) {
+        encoding.encode_into(string_of(piece, n), out, capacity);
+    };
+    pn::data out;
+    convert_pieces(in, split_pieces(length, split), measure, convert, &out);
+    return out;
+}
+
+pn::string decode_parallel(const text_encoding& encoding, pn::data_view data) {
+    const uint8_t* in      = data.data();
+    auto           split   = [&](int n) { return encoding.decodable(pn::data_view{in, n}); };
+    auto           measure = [&](const uint8_t* piece, int n) {
+        return encoding.decoded_length(pn::data_view{piece, n});
+    };
+    auto convert = [&](const uint8_t* piece, int n, uint8_t* out, int capacity) {
+        encoding.decode_into(pn::data_view{piece, n}, out, capacity);
+    };
+    pn::string out;
+    convert_pieces(in, split_pieces(data.size(), split), measure, convert, &out);
+    return out;
+}
+
+// transcode_file() converts through buffers of this size, one for the UTF-8 text, and one for the
+// encoded output.
+const int kTranscodeBufferSize = 256 * 1024;
+
+// The source may be too large for one pn::data_view, so transcode_file() views it in pieces of
+// at most this size.
+const int kTranscodePieceSize = 1 << 30;
+
+void transcode_file(
+        pn::string_view src, pn::string_view dst, const text_encoding* from,
+        const text_encoding* to) {
+    mapped_file file(src);
+    pn::output  out{dst, pn::binary};
+    if (!out.c_obj()) {
+        throw std::runtime_error(pn::format("{0}: couldn't open for writing", dst).c_str());
+    }
+
+    std::unique_ptr<uint8_t[]> buffers(new uint8_t[2 * kTranscodeBufferSize]);
+    uint8_t* const             utf8    = buffers.get();
+    uint8_t* const             encoded = utf8 + kTranscodeBufferSize;
+
+    // Writes a piece of UTF-8 text, which ends on a sequence boundary.
+    auto emit = [&](const uint8_t* text, int size) {
+        if (!to) {
+            out.write(pn::data_view{text, size}).check();
+            return;
+        }
+        for (int i = 0; i < size;) {
+            const transcode_result result =
+                    to->encode_into(string_of(text + i, size - i), encoded, kTranscodeBufferSize);
+            out.write(pn::data_view{encoded, result.written}).check();
+            i += result.read;
+        }
+    };
+
+    // Each piece but the last ends where the source encoding can split it, and is converted as
+    // if it were the whole source.  A piece is viewed with a few bytes after it, so that UTF-8 can
+    // be split without cutting a sequence short.
+    for (uint64_t offset = 0; offset < file.size();) {
+        const uint64_t      rest  = file.size() - offset;
+        const int           avail = std::min<uint64_t>(rest, kTranscodePieceSize + 3);
+        const pn::data_view view  = file.data(offset, avail);
+        int                 end   = std::min(avail, kTranscodePieceSize);
+        if (from) {
+            end = (end < avail) ? from->decodable(pn::data_view{view.data(), end}) : end;
+        } else {
+            end = utf8_split(view.data(), avail, end);
+        }
+
+        for (int i = 0; i < end;) {
+            const uint8_t* in   = view.data() + i;
+            const int      size = end - i;
+            if (from) {
+                const transcode_result result =
+                        from->decode_into(pn::data_view{in, size}, utf8, kTranscodeBufferSize);
+                emit(utf8, result.written);
+                i += result.read;
+            } else {
+                const int n = utf8_split(in, size, std::min(size, kTranscodeBufferSize));
+                emit(in, n);
+                i += n;
+            }
+        }
+        offset += end;
+    }
+}
+
+encoder::encoder(const text_encoding& encoding, pn::output& out)
+        : _encoding(encoding), _out(out), _pending_size{0} {}
+
+void encoder::write(pn::data_view utf8) {
+    const uint8_t* data = utf8.data();
+    const int      size = utf8.size();
+    int            i    = 0;
+
+    // Complete the sequence held from the last chunk, if there is one.  If it's followed by
+    // something other than a continuation byte, it was truncated; pass it on anyway, so that it
+    // gets the same treatment as any other invalid sequence.
+    if (_pending_size > 0) {
+        const int length = utf8_sequence_length(_pending[0]);
+        while ((_pending_size < length) && (i < size) && is_continuation(data[i])) {
+            _pending[_pending_size++] = data[i++];
+        }
+        if ((_pending_size < length) && (i == size)) {
+            return;
+        }
+        emit(pn::data_view{_pending, _pending_size});
+        _pending_size = 0;
+    }
+
+    // Hold back a sequence that starts within the last 3 bytes, but doesn't end within them.
+    int end = size;
+    for (int j = size - 1; (j >= i) && (j >= size - 3); --j) {
+        if (!is_continuation(data[j])) {
+            if ((j + utf8_sequence_length(data[j])) > size) {
+                end = j;
+            }
+            break;
+        }
+    }
+    emit(pn::data_view{data + i, end - i});
+    memcpy(_pending, data + end, size - end);
+    _pending_size = size - end;
+}
+
+void encoder::finish() {
+    emit(pn::data_view{_pending, _pending_size});
+    _pending_size = 0;
+}
+
+void encoder::emit(pn::data_view utf8) {
+    if (utf8.size() > 0) {
+        pn::string_view string{reinterpret_cast<const char*>(utf8.data()), utf8.size()};
+        _out.write(_encoding.encode(string)).check();
+    }
+}
+
+decoder::decoder(const text_encoding& encoding, pn::output& out)
+        : _encoding(encoding), _out(out), _pending_size{0} {}
+
+void decoder::write(pn::data_view data) {
+    // Feed the sequence held from the last chunk one byte at a time, until some of it can be
+    // decoded.  No encoding holds back more than 3 bytes, so there's always room for one more.
+    int i = 0;
+    while ((_pending_size > 0) && (i < data.size())) {
+        _pending[_pending_size++] = data.data()[i++];
+        const int decodable = _encoding.decodable(pn::data_view{_pending, _pending_size});
+        emit(pn::data_view{_pending, decodable});
+        memmove(_pending, _pending + decodable, _pending_size - decodable);
+        _pending_size -= decodable;
+    }
+
+    const pn::data_view rest{data.data() + i, data.size() - i};
+    const int           decodable = _encoding.decodable(rest);
+    emit(pn::data_view{rest.data(), decodable});
+    memcpy(_pending, rest.data() + decodable, rest.size() - decodable);
+    _pending_size += rest.size() - decodable;
+}
+
+void decoder::finish() {
+    emit(pn::data_view{_pending, _pending_size});
+    _pending_size = 0;
+}
+
+void decoder::emit(pn::data_view data) {
+    if (data.size() > 0) {
+        _out.write(_encoding.decode(data)).check();
+    }
+}
 
 }  // namespace sfz
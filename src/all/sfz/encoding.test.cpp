@@ -7,16 +7,46 @@
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 #include <pn/data>
+#include <pn/output>
 #include <pn/string>
+#include <new>
+#include <sfz/file.hpp>
+#include <sfz/os.hpp>
 #include <sfz/range.hpp>
+#include <stdexcept>
+#include <vector>
 
 using testing::Eq;
+using testing::Gt;
+using testing::Le;
 using testing::Test;
 
+// Counts allocations, to check that codecs size their output up front.
+static int allocations = 0;
+
+void* operator new(size_t size) {
+    ++allocations;
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+
 namespace sfz {
 namespace {
 
+pn::data_view bytes_of(pn::string_view string) {
+    return pn::data_view{reinterpret_cast<const uint8_t*>(string.data()), string.size()};
+}
+
 typedef Test EncodingTest;
 
 TEST_F(EncodingTest, IsValidCodePoint) {
@@ -53,6 +83,378 @@ TEST_F(EncodingTest, IsValidCodePoint) {
     EXPECT_THAT(is_valid_code_point(0xffffffff), false);
 }
 
+// Puts each kind of value, valid and invalid, at each position in arrays long enough to go through
+// the SIMD paths, and checks that they agree with is_valid_code_point().
+TEST_F(EncodingTest, ValidateCodePoints) {
+    const uint32_t kValues[] = {0x0000,   0xd7ff,   0xd800,     0xdfff,     0xe000,    0x10ffff,
+                                0x110000, 0x1ffff0, 0x7fffffff, 0x80000000, 0xffffffff};
+    EXPECT_THAT(validate_code_points(nullptr, 0), Eq(0));
+    for (int size : {1, 15, 16, 17, 31, 32, 33, 100}) {
+        for (int i : range(size)) {
+            for (uint32_t value : kValues) {
+                std::vector<uint32_t> runes(size + 1, 'a');
+                runes[i]    = value;
+                runes[size] = 0xd800;  // Past the end.
+
+                const int expected = is_valid_code_point(value) ? size : i;
+                ASSERT_THAT(validate_code_points(runes.data(), size), Eq(expected))
+                        << size << " " << i << " " << value;
+
+                ASSERT_THAT(
+                        replace_invalid_code_points(runes.data(), size),
+                        Eq(is_valid_code_point(value) ? 0 : 1));
+                EXPECT_THAT(runes[i], Eq(is_valid_code_point(value) ? value : 0xfffd));
+                EXPECT_THAT(runes[size], Eq(0xd800u));
+            }
+        }
+    }
+
+    std::vector<uint32_t> runes;
+    for (int i : range(1000)) {
+        runes.push_back(((i % 3) == 0) ? 0xdc00 + i : i);
+    }
+    EXPECT_THAT(validate_code_points(runes.data(), runes.size()), Eq(0));
+    EXPECT_THAT(replace_invalid_code_points(runes.data(), runes.size()), Eq(334));
+    EXPECT_THAT(validate_code_points(runes.data(), runes.size()), Eq<int>(runes.size()));
+    EXPECT_THAT(runes[3], Eq(0xfffdu));
+    EXPECT_THAT(runes[4], Eq(4u));
+}
+
+// Each codec bounds the size of its output and converts into a result of that size, which is
+// allocated once.
+TEST_F(EncodingTest, Allocations) {
+    pn::string string;
+    while (string.size() < (1 << 20)) {
+        string += "Grüße an die Welt, \u043f\u0440\u0438\u0432\u0435\u0442 \u043c\u0438\u0440, "
+                  "for only \u20ac5! ";
+    }
+    for (const char* name :
+         {"ascii", "latin1", "macroman", "windows-1252", "iso-8859-15", "koi8-r", "utf-16le",
+          "utf-16be", "utf-32"}) {
+        const text_encoding* encoding = find_encoding(name);
+        pn::data             data     = encoding->encode(string);
+
+        int before = allocations;
+        encoding->encode(string);
+        EXPECT_THAT(allocations - before, Le(1)) << name;
+        before = allocations;
+        encoding->decode(data);
+        EXPECT_THAT(allocations - before, Le(1)) << name;
+
+        // Converting into a caller's buffer doesn't allocate at all.
+        uint8_t buffer[1024];
+        before = allocations;
+        encoding->encode_into(string, buffer, sizeof(buffer));
+        encoding->decode_into(data, buffer, sizeof(buffer));
+        EXPECT_THAT(allocations - before, Eq(0)) << name;
+    }
+}
+
+// Converting into a buffer a piece at a time gives the same result as converting at once, and
+// never writes past the end of the buffer.
+TEST_F(EncodingTest, Into) {
+    // Includes invalid UTF-8, which each encoding replaces, and bytes which UTF-16 and UTF-32
+    // don't decode as a whole code point.
+    const char            kText[] =
+            "Gr\xc3\xbc\xc3\x9f" "e \xe2\x82\xac \xf0\x9f\x98\x80 \xe2\x82 "
+            "\xff\x80\x80\x80\x80 \xc0\x80 end";
+    const uint8_t         kTail[] = {0x00, 0xd8, 0x00, 0xd8, 'x'};
+    const pn::string_view text{kText, sizeof(kText) - 1};
+    for (const char* name : {"ascii", "latin1", "macroman", "windows-1252", "iso-8859-15",
+                             "koi8-r", "utf-16le", "utf-16be", "utf-32"}) {
+        const text_encoding& encoding = *find_encoding(name);
+        pn::data             encoded  = encoding.encode(text);
+        encoded += pn::data_view{kTail, sizeof(kTail)};
+        const pn::string decoded = encoding.decode(encoded);
+
+        for (int capacity : {4, 5, 6, 7, 13, 64, 1024}) {
+            uint8_t buffer[1024 + 16];
+            pn::data out;
+            for (int read = 0; read < text.size();) {
+                memset(buffer, 0xee, sizeof(buffer));
+                transcode_result result =
+                        encoding.encode_into(text.substr(read), buffer, capacity);
+                ASSERT_THAT(result.read, Gt(0)) << name << " " << capacity;
+                EXPECT_THAT(result.written, Le(capacity)) << name << " " << capacity;
+                EXPECT_THAT(buffer[capacity], Eq(0xee)) << name << " " << capacity;
+                out += pn::data_view{buffer, result.written};
+                read += result.read;
+            }
+            EXPECT_THAT(out, Eq(pn::data_view{encoded.data(), encoded.size() - 5}))
+                    << name << " " << capacity;
+
+            pn::string string;
+            for (int read = 0; read < encoded.size();) {
+                memset(buffer, 0xee, sizeof(buffer));
+                transcode_result result = encoding.decode_into(
+                        pn::data_view{encoded.data() + read, encoded.size() - read}, buffer,
+                        capacity);
+                ASSERT_THAT(result.read, Gt(0)) << name << " " << capacity;
+                EXPECT_THAT(result.written, Le(capacity)) << name << " " << capacity;
+                EXPECT_THAT(buffer[capacity], Eq(0xee)) << name << " " << capacity;
+                string += pn::string_view{reinterpret_cast<const char*>(buffer), result.written};
+                read += result.read;
+            }
+            EXPECT_THAT(string, Eq(pn::string_view{decoded})) << name << " " << capacity;
+        }
+    }
+}
+
+TEST_F(EncodingTest, Append) {
+    pn::string text;
+    while (text.size() < 5000) {
+        text += "Gr\u00fc\u00dfe, \u043f\u0440\u0438\u0432\u0435\u0442 \U0001f600 ";
+    }
+    const pn::data encoded = utf16be::encode(text);
+
+    pn::data data{reinterpret_cast<const uint8_t*>("ab"), 2};
+    utf16be::encode_append(text, &data);
+    pn::data expected{reinterpret_cast<const uint8_t*>("ab"), 2};
+    expected += encoded;
+    EXPECT_THAT(data, Eq(pn::data_view{expected}));
+
+    pn::string string{"ab"};
+    utf16be::decode_append(encoded, &string);
+    EXPECT_THAT(string, Eq(pn::string_view{pn::format("ab{0}", text)}));
+
+    pn::data latin1{reinterpret_cast<const uint8_t*>("ab"), 2};
+    latin1::encode_append(text, &latin1);
+    EXPECT_THAT(latin1.size(), Eq(2 + latin1::encode(text).size()));
+}
+
+struct codec_functions {
+    const char* name;
+    pn::data (*encode)(pn::string_view);
+    pn::string (*decode)(pn::data_view);
+    int (*encoded_length)(pn::string_view);
+    int (*decoded_length)(pn::data_view);
+    bool (*can_encode)(pn::string_view);
+};
+
+const codec_functions kCodecs[] = {
+        {"ascii", ascii::encode, ascii::decode, ascii::encoded_length, ascii::decoded_length,
+         ascii::can_encode},
+        {"latin1", latin1::encode, latin1::decode, latin1::encoded_length, latin1::decoded_length,
+         latin1::can_encode},
+        {"macroman", macroman::encode, macroman::decode, macroman::encoded_length,
+         macroman::decoded_length, macroman::can_encode},
+        {"windows1252", windows1252::encode, windows1252::decode, windows1252::encoded_length,
+         windows1252::decoded_length, windows1252::can_encode},
+        {"iso8859_15", iso8859_15::encode, iso8859_15::decode, iso8859_15::encoded_length,
+         iso8859_15::decoded_length, iso8859_15::can_encode},
+        {"koi8r", koi8r::encode, koi8r::decode, koi8r::encoded_length, koi8r::decoded_length,
+         koi8r::can_encode},
+        {"utf16le", utf16le::encode, utf16le::decode, utf16le::encoded_length,
+         utf16le::decoded_length, utf16le::can_encode},
+        {"utf16be", utf16be::encode, utf16be::decode, utf16be::encoded_length,
+         utf16be::decoded_length, utf16be::can_encode},
+        {"utf32", utf32::encode, utf32::decode, utf32::encoded_length, utf32::decoded_length,
+         utf32::can_encode},
+};
+
+// Measuring a conversion gives the size of its result, without allocating.
+TEST_F(EncodingTest, Lengths) {
+    const char kInvalid[] = "\xe2\x82 \xff\x80\x80\x80\x80 \xc0\x80 \xed\xa0\x80 \xf4\x90\x80\x80";
+    pn::string text;
+    while (text.size() < 5000) {
+        text += "Gr\u00fc\u00dfe, \u043f\u0440\u0438\u0432\u0435\u0442 \u20ac \U0001f600 ";
+    }
+    pn::string ascii_text;
+    while (ascii_text.size() < 5000) {
+        ascii_text += "Hello, world! ";
+    }
+    const pn::string_view strings[] = {
+            "", "a", "\u00e9", "\U0001f600", text, ascii_text, {kInvalid, sizeof(kInvalid) - 1}};
+
+    // Every byte value, and every UTF-16 and UTF-32 unit in pieces, at each alignment.
+    pn::data bytes;
+    for (int i : range(0x10000)) {
+        const uint8_t unit[] = {static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i), 0xd8,
+                                static_cast<uint8_t>(i), 0x00, 0x10, static_cast<uint8_t>(i >> 8),
+                                0xdc};
+        bytes += pn::data_view{unit, sizeof(unit)};
+    }
+
+    for (const codec_functions& codec : kCodecs) {
+        for (pn::string_view string : strings) {
+            EXPECT_THAT(codec.encoded_length(string), Eq(codec.encode(string).size()))
+                    << codec.name << " " << string.size();
+            const pn::data encoded = codec.encode(string);
+            EXPECT_THAT(codec.decoded_length(encoded), Eq(codec.decode(encoded).size()))
+                    << codec.name << " " << string.size();
+        }
+        for (int offset : {0, 1, 2, 3, 5}) {
+            const pn::data_view data{bytes.data() + offset, bytes.size() - offset};
+            EXPECT_THAT(codec.decoded_length(data), Eq(codec.decode(data).size()))
+                    << codec.name << " " << offset;
+            const pn::data_view piece{bytes.data() + offset, 37};
+            EXPECT_THAT(codec.decoded_length(piece), Eq(codec.decode(piece).size()))
+                    << codec.name << " " << offset;
+        }
+
+        const pn::data encoded = codec.encode(text);
+        const int      before  = allocations;
+        codec.encoded_length(text);
+        codec.decoded_length(encoded);
+        codec.can_encode(text);
+        EXPECT_THAT(allocations - before, Eq(0)) << codec.name;
+    }
+}
+
+// A string can be encoded if it round-trips unchanged.
+TEST_F(EncodingTest, CanEncode) {
+    EXPECT_THAT(ascii::can_encode("Hello, world!"), Eq(true));
+    EXPECT_THAT(ascii::can_encode("caf\u00e9"), Eq(false));
+    EXPECT_THAT(latin1::can_encode("caf\u00e9 \u00ff"), Eq(true));
+    EXPECT_THAT(latin1::can_encode("\u0100"), Eq(false));
+    EXPECT_THAT(latin1::can_encode("\u20ac"), Eq(false));
+    EXPECT_THAT(macroman::can_encode("caf\u00e9 \u2122"), Eq(true));
+    EXPECT_THAT(macroman::can_encode("\u043f"), Eq(false));
+    EXPECT_THAT(windows1252::can_encode("\u20ac5"), Eq(true));
+    EXPECT_THAT(iso8859_15::can_encode("\u20ac5"), Eq(true));
+    EXPECT_THAT(iso8859_15::can_encode("\u00a4"), Eq(false));
+    EXPECT_THAT(koi8r::can_encode("\u043f\u0440\u0438\u0432\u0435\u0442"), Eq(true));
+    EXPECT_THAT(utf16le::can_encode("\U0001f600"), Eq(true));
+    EXPECT_THAT(utf32::can_encode("\U0001f600"), Eq(true));
+
+    const char kInvalid[] = "a\xe2\x82";
+    for (const codec_functions& codec : kCodecs) {
+        EXPECT_THAT(codec.can_encode(pn::string_view{kInvalid, sizeof(kInvalid) - 1}), Eq(false))
+                << codec.name;
+        EXPECT_THAT(codec.can_encode(""), Eq(true)) << codec.name;
+        for (pn::string_view string :
+             {"plain ASCII text", "Gr\u00fc\u00dfe", "\u20ac", "\u0152\u0153", "\u2122",
+              "\u043f\u0440\u0438\u0432\u0435\u0442", "\u00a4", "\U0001f600", "\ufffd"}) {
+            const bool round_trips = codec.decode(codec.encode(string)) == string;
+            EXPECT_THAT(codec.can_encode(string), Eq(round_trips)) << codec.name << " " << string;
+        }
+    }
+}
+
+pn::data concat(pn::data_view a, pn::data_view b) {
+    pn::data data = a.copy();
+    data += b;
+    return data;
+}
+
+TEST_F(EncodingTest, Detect) {
+    const pn::string french{
+            "Le c\u0153ur a ses raisons que la raison ne conna\u00eet point\u2026 "
+            "\u00ab\u00a0C\u2019est l\u2019\u00e9t\u00e9, d\u00e9j\u00e0\u00a0!\u00a0\u00bb "
+            "Fran\u00e7ois a d\u00e9cid\u00e9 d\u2019\u00e9crire \u00e0 sa s\u0153ur. "};
+    const pn::string latin1_text{
+            "Fran\u00e7ois a d\u00e9cid\u00e9 d'\u00e9crire \u00e0 sa m\u00e8re, "
+            "\u00e0 Z\u00fcrich, o\u00f9 il fait tr\u00e8s froid en f\u00e9vrier. "};
+    const uint8_t kUtf8Bom[]    = {0xef, 0xbb, 0xbf};
+    const uint8_t kUtf16LEBom[] = {0xff, 0xfe};
+    const uint8_t kUtf16BEBom[] = {0xfe, 0xff};
+    const uint8_t kUtf32Bom[]   = {0x00, 0x00, 0xfe, 0xff};
+
+    EXPECT_THAT(detect_encoding(pn::data_view{}).encoding, Eq(nullptr));
+    EXPECT_THAT(detect_encoding(bytes_of(french)).encoding, Eq(nullptr));
+    EXPECT_THAT(detect_encoding(concat({kUtf8Bom, 3}, bytes_of(french))).bom, Eq(3));
+
+    const struct {
+        pn::data             data;
+        const text_encoding* encoding;
+        int                  bom;
+    } cases[] = {
+            {utf16le::encode(french), find_encoding("utf-16le"), 0},
+            {utf16be::encode(french), find_encoding("utf-16be"), 0},
+            {utf32::encode(french), find_encoding("utf-32"), 0},
+            {concat({kUtf16LEBom, 2}, utf16le::encode("\u043f\u0440\u0438")),
+             find_encoding("utf-16le"), 2},
+            {concat({kUtf16BEBom, 2}, utf16be::encode("\u043f\u0440\u0438")),
+             find_encoding("utf-16be"), 2},
+            {concat({kUtf32Bom, 4}, utf32::encode("\u043f\u0440\u0438")), find_encoding("utf-32"),
+             4},
+            {latin1::encode(latin1_text), find_encoding("latin1"), 0},
+            {windows1252::encode(french), find_encoding("windows-1252"), 0},
+            {macroman::encode(french), find_encoding("macroman"), 0},
+            {macroman::encode(latin1_text), find_encoding("macroman"), 0},
+    };
+    for (const auto& c : cases) {
+        const detected_encoding detected = detect_encoding(c.data);
+        EXPECT_THAT(detected.encoding, Eq(c.encoding)) << (c.encoding ? c.encoding->name : "");
+        EXPECT_THAT(detected.bom, Eq(c.bom)) << (c.encoding ? c.encoding->name : "");
+    }
+
+    // Only the start of the data is examined, and a sequence split by the end of the sample is
+    // not taken as invalid.
+    pn::string long_text;
+    while (long_text.size() < kDetectionSampleSize) {
+        long_text += "\u20ac";
+    }
+    pn::data data = bytes_of(long_text).copy();
+    data += pn::data_view{reinterpret_cast<const uint8_t*>("\xff\xff\xff"), 3};
+    EXPECT_THAT(detect_encoding(data).encoding, Eq(nullptr));
+    data = latin1::encode(latin1_text);
+    while (data.size() < (2 * kDetectionSampleSize)) {
+        data += pn::data_view{data}.copy();
+    }
+    EXPECT_THAT(detect_encoding(data).encoding, Eq(find_encoding("latin1")));
+}
+
+// Converting in pieces on several threads gives the same result as converting at once, wherever
+// the pieces are split.
+TEST_F(EncodingTest, Parallel) {
+    pn::string text;
+    while (text.size() < (3 << 20)) {
+        text += "Gr\u00fc\u00dfe \u20ac \U0001f600 \xe2\x82 \xff ";
+    }
+    for (const char* name : {"ascii", "latin1", "macroman", "windows-1252", "iso-8859-15",
+                             "koi8-r", "utf-16le", "utf-16be", "utf-32"}) {
+        const text_encoding& encoding = *find_encoding(name);
+        for (int offset : {0, 1, 2, 3}) {
+            const pn::string_view string = pn::string_view{text}.substr(offset);
+            const pn::data        data   = encoding.encode(string);
+            EXPECT_THAT(encode_parallel(encoding, string), Eq(pn::data_view{data})) << name;
+
+            const pn::data_view piece{data.data() + offset, data.size() - offset};
+            const pn::string    decoded = encoding.decode(piece);
+            EXPECT_THAT(decode_parallel(encoding, piece), Eq(pn::string_view{decoded})) << name;
+        }
+        EXPECT_THAT(encode_parallel(encoding, "").size(), Eq(0)) << name;
+        EXPECT_THAT(decode_parallel(encoding, pn::data_view{}).size(), Eq(0)) << name;
+    }
+}
+
+TEST_F(EncodingTest, TranscodeFile) {
+    TemporaryDirectory dir("encoding-test");
+    const pn::string   src = path::join(dir.path(), "src");
+    const pn::string   dst = path::join(dir.path(), "dst");
+
+    // Longer than the buffers that the file is converted through.
+    pn::string text;
+    while (text.size() < (1 << 20)) {
+        text += "Gr\u00fc\u00dfe, \u043f\u0440\u0438\u0432\u0435\u0442 \u20ac \U0001f600 ";
+    }
+
+    const struct {
+        const char* from;
+        const char* to;
+    } cases[] = {
+            {"macroman", nullptr}, {nullptr, "utf-16le"}, {"latin1", "utf-32"},
+            {"utf-16be", "koi8-r"}, {nullptr, nullptr},
+    };
+    for (const auto& c : cases) {
+        const text_encoding* from = c.from ? find_encoding(c.from) : nullptr;
+        const text_encoding* to   = c.to ? find_encoding(c.to) : nullptr;
+        const pn::data       data = from ? from->encode(text) : bytes_of(text).copy();
+        pn::output{src, pn::binary}.write(data).check();
+
+        transcode_file(src, dst, from, to);
+        const pn::string decoded  = from ? from->decode(data) : text.copy();
+        const pn::data   expected = to ? to->encode(decoded) : bytes_of(decoded).copy();
+        EXPECT_THAT(mapped_file(dst).data(), Eq(pn::data_view{expected}))
+                << (c.from ? c.from : "utf-8") << " " << (c.to ? c.to : "utf-8");
+    }
+
+    EXPECT_THROW(
+            transcode_file(path::join(dir.path(), "missing"), dst, nullptr, nullptr),
+            std::runtime_error);
+}
+
 typedef Test AsciiEncodingTest;
 
 TEST_F(AsciiEncodingTest, DecodeValid) {
@@ -109,6 +511,34 @@ TEST_F(AsciiEncodingTest, EncodeInvalid) {
     }
 }
 
+TEST_F(AsciiEncodingTest, Mixed) {
+    // Long runs of ASCII are handled in blocks, so put non-ASCII values at each offset within and
+    // around a block.
+    for (int i : range(100)) {
+        pn::string string;
+        pn::data   encoded;
+        pn::data   data;
+        pn::string decoded;
+        for (int j : range(100)) {
+            uint8_t byte = 'a' + (j % 26);
+            if (j == i) {
+                string += pn::rune{0xe9};
+                string += pn::rune{0x1f600};
+                encoded += pn::data_view{reinterpret_cast<const uint8_t*>("??"), 2};
+                byte = 0xe9;
+                decoded += pn::rune{kUnknownCodePoint};
+            } else {
+                string += pn::rune{byte};
+                encoded += pn::data_view{&byte, 1};
+                decoded += pn::rune{byte};
+            }
+            data += pn::data_view{&byte, 1};
+        }
+        EXPECT_THAT(ascii::encode(string), Eq(pn::data_view{encoded})) << i;
+        EXPECT_THAT(ascii::decode(data), Eq(pn::string_view{decoded})) << i;
+    }
+}
+
 typedef Test Latin1EncodingTest;
 
 TEST_F(Latin1EncodingTest, Decode) {
@@ -158,6 +588,36 @@ TEST_F(Latin1EncodingTest, EncodeInvalid) {
     }
 }
 
+TEST_F(Latin1EncodingTest, Mixed) {
+    // Runs of ASCII and of the Latin-1 supplement are handled in blocks, so mix them in runs of
+    // various lengths, along with code points that can't be encoded.
+    const uint32_t kCodePoints[] = {'a', 0xe9, 0x80, 0xff, 0x100, 0x20ac, 0x1f600};
+    uint32_t       seed          = 1;
+    for (int trial : range(200)) {
+        pn::string string;
+        pn::data   data;
+        pn::data   encoded;
+        pn::string decoded;
+        while (string.size() < trial) {
+            seed            = (seed * 1103515245) + 12345;
+            uint32_t rune   = kCodePoints[(seed >> 16) % 7];
+            int      length = (seed >> 8) % 40;
+            for (int i : range(length)) {
+                static_cast<void>(i);
+                string += pn::rune{rune};
+                uint8_t byte = (rune < 0x100) ? rune : '?';
+                encoded += pn::data_view{&byte, 1};
+                if (rune < 0x100) {
+                    data += pn::data_view{&byte, 1};
+                    decoded += pn::rune{rune};
+                }
+            }
+        }
+        EXPECT_THAT(latin1::encode(string), Eq(pn::data_view{encoded})) << trial;
+        EXPECT_THAT(latin1::decode(data), Eq(pn::string_view{decoded})) << trial;
+    }
+}
+
 typedef Test MacRomanEncodingTest;
 
 const pn::string_view kMacRomanSupplement =
@@ -210,6 +670,210 @@ TEST_F(MacRomanEncodingTest, EncodeInvalid) {
     }
 }
 
+TEST_F(MacRomanEncodingTest, EncodeAll) {
+    // Every valid code point encodes to its byte in the table, or '?' if it has none.
+    pn::string string;
+    pn::data   expected;
+    for (uint32_t i : range(0x110000)) {
+        if (!is_valid_code_point(i)) {
+            continue;
+        }
+        string += pn::rune{i};
+        uint8_t byte = '?';
+        if (i < 0x80) {
+            byte = i;
+        } else if (i < 0x10000) {
+            int index = 0;
+            for (pn::rune r : kMacRomanSupplement) {
+                if (r.value() == i) {
+                    byte = 0x80 + index;
+                    break;
+                }
+                ++index;
+            }
+        }
+        expected += pn::data_view{&byte, 1};
+    }
+    EXPECT_THAT(macroman::encode(string), Eq(pn::data_view{expected}));
+}
+
+typedef Test SingleByteEncodingTest;
+
+// Each byte decodes to a distinct code point, which encodes back to the same byte.
+TEST_F(SingleByteEncodingTest, RoundTrip) {
+    const uint8_t kUnknown = kAsciiUnknownCodePoint.value();
+    pn::data      data;
+    for (uint8_t i : range(0x100)) {
+        data += pn::data_view{&i, 1};
+    }
+    for (const char* name : {"latin1", "macroman", "windows-1252", "iso-8859-15", "koi8-r"}) {
+        const text_encoding* encoding = find_encoding(name);
+        ASSERT_THAT(encoding, testing::NotNull()) << name;
+        pn::string string = encoding->decode(data);
+        int        runes  = 0;
+        for (pn::rune r : string) {
+            static_cast<void>(r);
+            ++runes;
+        }
+        EXPECT_THAT(runes, Eq(0x100)) << name;
+        EXPECT_THAT(encoding->encode(string), Eq(pn::data_view{data})) << name;
+        EXPECT_THAT(encoding->encode("\u4e00"), Eq(pn::data_view{&kUnknown, 1})) << name;
+    }
+}
+
+TEST_F(SingleByteEncodingTest, Decode) {
+    const uint8_t bytes[] = {'a', 0x80, 0x8d, 0x9f, 0xa4, 0xbe, 0xc1, 0xff};
+    pn::data_view data{bytes, sizeof(bytes)};
+    EXPECT_THAT(windows1252::decode(data), Eq(pn::string_view{"a€\u008dŸ¤¾Áÿ"}));
+    EXPECT_THAT(iso8859_15::decode(data), Eq(pn::string_view{"a\u0080\u008d\u009f€ŸÁÿ"}));
+    EXPECT_THAT(koi8r::decode(data), Eq(pn::string_view{"a─█÷╓╬аЪ"}));
+}
+
+TEST_F(SingleByteEncodingTest, FindEncoding) {
+    EXPECT_THAT(find_encoding("ISO-8859-15"), Eq(find_encoding("iso8859_15")));
+    EXPECT_THAT(find_encoding("Latin9"), Eq(find_encoding("iso8859_15")));
+    EXPECT_THAT(find_encoding("CP1252"), Eq(find_encoding("Windows-1252")));
+    EXPECT_THAT(pn::string_view{find_encoding("koi8r")->name}, Eq(pn::string_view{"KOI8-R"}));
+    EXPECT_THAT(find_encoding("ascii")->encode, Eq(&ascii::encode));
+    EXPECT_THAT(find_encoding("latin"), Eq(nullptr));
+    EXPECT_THAT(find_encoding(""), Eq(nullptr));
+}
+
+typedef Test StreamEncodingTest;
+
+// Streaming text through an encoder or decoder gives the same result as converting it at once,
+// however it's split into chunks, including in the middle of a multi-byte sequence.
+TEST_F(StreamEncodingTest, Chunks) {
+    const pn::string_view text{"abc ÀÁÂ €Ÿ ─█ \u4e00\U0001f600 xyz \u4e00"};
+    for (const char* name : {"ascii", "latin1", "macroman", "windows-1252", "koi8-r", "utf-16le",
+                             "utf-16be", "utf-32"}) {
+        const text_encoding& encoding = *find_encoding(name);
+        const pn::data       encoded  = encoding.encode(text);
+        const pn::string     decoded  = encoding.decode(encoded);
+        for (int chunk : {1, 2, 3, 7, 1024}) {
+            pn::data     out;
+            pn::output   output = out.output();
+            sfz::encoder enc(encoding, output);
+            for (int i = 0; i < text.size(); i += chunk) {
+                enc.write(pn::data_view{
+                        reinterpret_cast<const uint8_t*>(text.data()) + i,
+                        std::min(chunk, text.size() - i)});
+            }
+            enc.finish();
+            EXPECT_THAT(out, Eq(pn::data_view{encoded})) << name << " " << chunk;
+
+            pn::string   string;
+            pn::output   string_output = string.output();
+            sfz::decoder dec(encoding, string_output);
+            for (int i = 0; i < encoded.size(); i += chunk) {
+                dec.write(pn::data_view{encoded.data() + i, std::min(chunk, encoded.size() - i)});
+            }
+            dec.finish();
+            EXPECT_THAT(string, Eq(pn::string_view{decoded})) << name << " " << chunk;
+        }
+    }
+}
+
+// Partial units and unpaired surrogates decode the same whether or not they're split between
+// chunks.
+TEST_F(StreamEncodingTest, InvalidChunks) {
+    const uint8_t bytes[] = {'a', 0, 0x3d, 0xd8, 'b', 0, 0x3d, 0xd8, 0x00, 0xde,
+                             0x00, 0xde, 0x3d, 0xd8, 0x3d, 0xd8, 'c'};
+    const pn::data_view data{bytes, sizeof(bytes)};
+    for (const char* name : {"utf-16le", "utf-16be", "utf-32"}) {
+        const text_encoding& encoding = *find_encoding(name);
+        for (int chunk : {1, 2, 3, 5, 1024}) {
+            pn::string   string;
+            pn::output   output = string.output();
+            sfz::decoder dec(encoding, output);
+            for (int i = 0; i < data.size(); i += chunk) {
+                dec.write(pn::data_view{data.data() + i, std::min(chunk, data.size() - i)});
+            }
+            dec.finish();
+            EXPECT_THAT(string, Eq(pn::string_view{encoding.decode(data)}))
+                    << name << " " << chunk;
+        }
+    }
+}
+
+typedef Test Utf16EncodingTest;
+
+TEST_F(Utf16EncodingTest, EncodeDecode) {
+    const pn::string_view text{"a\u00e9\u4e00\U0001f600"};
+    const uint8_t         le[]  = {'a', 0, 0xe9, 0, 0x00, 0x4e, 0x3d, 0xd8, 0x00, 0xde};
+    const uint8_t         be[]  = {0, 'a', 0, 0xe9, 0x4e, 0x00, 0xd8, 0x3d, 0xde, 0x00};
+    const uint8_t         u32[] = {0, 0, 0, 'a', 0, 0, 0, 0xe9, 0, 0, 0x4e, 0, 0, 1, 0xf6, 0};
+    EXPECT_THAT(utf16le::encode(text), Eq(pn::data_view{le, sizeof(le)}));
+    EXPECT_THAT(utf16be::encode(text), Eq(pn::data_view{be, sizeof(be)}));
+    EXPECT_THAT(utf32::encode(text), Eq(pn::data_view{u32, sizeof(u32)}));
+    EXPECT_THAT(utf16le::decode(pn::data_view{le, sizeof(le)}), Eq(text));
+    EXPECT_THAT(utf16be::decode(pn::data_view{be, sizeof(be)}), Eq(text));
+    EXPECT_THAT(utf32::decode(pn::data_view{u32, sizeof(u32)}), Eq(text));
+}
+
+// Long runs of ASCII, and of two-byte UTF-8, are converted in blocks; check that they give the
+// same result as converting a code point at a time, at every alignment.
+TEST_F(Utf16EncodingTest, Blocks) {
+    // Runs of 20 ASCII, 20 Cyrillic, 5 CJK, and 5 emoji code points.
+    pn::string text;
+    for (int i : range(200)) {
+        if ((i % 50) < 20) {
+            text += pn::rune('a' + (i % 26));
+        } else if ((i % 50) < 40) {
+            text += pn::rune(0x430 + (i % 32));
+        } else if ((i % 50) < 45) {
+            text += pn::rune(0x4e00 + i);
+        } else {
+            text += pn::rune(0x1f600 + i);
+        }
+    }
+    for (int start : range(20)) {
+        const pn::string_view sub = pn::string_view{text}.substr(start);
+        pn::data              le, be, u32;
+        for (pn::rune r : sub) {
+            const uint32_t code  = r.value();
+            const uint8_t  c32[] = {
+                    uint8_t(code >> 24), uint8_t(code >> 16), uint8_t(code >> 8), uint8_t(code)};
+            u32 += pn::data_view{c32, 4};
+            uint16_t units[2] = {uint16_t(code), 0};
+            int      count    = 1;
+            if (code >= 0x10000) {
+                units[0] = 0xd800 + ((code - 0x10000) >> 10);
+                units[1] = 0xdc00 + ((code - 0x10000) & 0x3ff);
+                count    = 2;
+            }
+            for (int k : range(count)) {
+                const uint8_t l[] = {uint8_t(units[k]), uint8_t(units[k] >> 8)};
+                const uint8_t b[] = {uint8_t(units[k] >> 8), uint8_t(units[k])};
+                le += pn::data_view{l, 2};
+                be += pn::data_view{b, 2};
+            }
+        }
+        EXPECT_THAT(utf16le::encode(sub), Eq(pn::data_view{le})) << start;
+        EXPECT_THAT(utf16be::encode(sub), Eq(pn::data_view{be})) << start;
+        EXPECT_THAT(utf32::encode(sub), Eq(pn::data_view{u32})) << start;
+        EXPECT_THAT(utf16le::decode(le), Eq(sub)) << start;
+        EXPECT_THAT(utf16be::decode(be), Eq(sub)) << start;
+        EXPECT_THAT(utf32::decode(u32), Eq(sub)) << start;
+    }
+}
+
+TEST_F(Utf16EncodingTest, Invalid) {
+    // Unpaired surrogates, and a trailing odd byte.
+    const uint8_t le[] = {0x3d, 0xd8, 'a', 0, 0x00, 0xde, 0x3d, 0xd8, 0x3d, 0xd8, 0x00, 0xde, 'b'};
+    EXPECT_THAT(utf16le::decode(pn::data_view{le, sizeof(le)}),
+                Eq(pn::string_view{"\ufffda\ufffd\ufffd\U0001f600\ufffd"}));
+
+    // Surrogates, values above U+10FFFF, and trailing bytes.
+    const uint8_t u32[] = {0, 0, 0xd8, 0x3d, 0, 0x11, 0, 0, 0, 0, 0, 'a', 0, 0};
+    EXPECT_THAT(utf32::decode(pn::data_view{u32, sizeof(u32)}),
+                Eq(pn::string_view{"\ufffd\ufffda\ufffd"}));
+
+    // Invalid UTF-8 is encoded as kUnknownCodePoint.
+    const uint8_t expected[] = {'a', 0, 0xfd, 0xff, 0xfd, 0xff, 'b', 0};
+    EXPECT_THAT(utf16le::encode("a\xff\xe2\x82" "b"), Eq(pn::data_view{expected, 8}));
+}
+
 typedef Test Utf8EncodingTest;
 
 TEST_F(Utf8EncodingTest, EncodeAscii) {
@@ -244,5 +908,325 @@ TEST_F(Utf8EncodingTest, EncodeLatin1) {
             bytes, Eq(pn::data_view{reinterpret_cast<const uint8_t*>(kLatin1Supplement), 256}));
 }
 
+// A direct reading of the definition of UTF-8, to check utf8::validate() against.
+int reference_validate(pn::data_view data) {
+    const uint32_t kMinimum[] = {0, 0, 0x80, 0x800, 0x10000};
+    const uint8_t* bytes      = data.data();
+    for (int i = 0; i < data.size();) {
+        const uint8_t lead   = bytes[i];
+        const int     length = (lead < 0x80) ? 1
+                             : (lead < 0xc0) ? 0
+                             : (lead < 0xe0) ? 2
+                             : (lead < 0xf0) ? 3
+                             : (lead < 0xf8) ? 4
+                                             : 0;
+        if ((length == 0) || ((i + length) > data.size())) {
+            return i;
+        }
+        uint32_t rune = (length == 1) ? lead : (lead & (0x7f >> length));
+        for (int k : range(1, length)) {
+            if ((bytes[i + k] & 0xc0) != 0x80) {
+                return i;
+            }
+            rune = (rune << 6) | (bytes[i + k] & 0x3f);
+        }
+        if ((rune < kMinimum[length]) || !is_valid_code_point(rune)) {
+            return i;
+        }
+        i += length;
+    }
+    return data.size();
+}
+
+pn::data repeat(pn::string_view s, int count) {
+    pn::data data;
+    for (int i : range(count)) {
+        static_cast<void>(i);
+        data += pn::data_view{reinterpret_cast<const uint8_t*>(s.data()), s.size()};
+    }
+    return data;
+}
+
+TEST_F(Utf8EncodingTest, Validate) {
+    const struct {
+        pn::string_view bytes;
+        int             offset;  // Of the first error, or -1 if valid.
+    } kCases[] = {
+            {"a", -1},
+            {"\xc2\x80\xdf\xbf", -1},
+            {"\xe0\xa0\x80\xed\x9f\xbf\xee\x80\x80\xef\xbf\xbf", -1},
+            {"\xf0\x90\x80\x80\xf4\x8f\xbf\xbf", -1},
+            {"a\x80", 1},                     // Stray continuation byte.
+            {"\xc0\x80", 0},                  // Overlong.
+            {"\xc1\xbf", 0},                  // Overlong.
+            {"\xe0\x9f\xbf", 0},              // Overlong.
+            {"\xf0\x8f\xbf\xbf", 0},          // Overlong.
+            {"\xed\xa0\x80", 0},              // Surrogate.
+            {"\xed\xbf\xbf", 0},              // Surrogate.
+            {"\xf4\x90\x80\x80", 0},          // Above U+10FFFF.
+            {"\xf5\x80\x80\x80", 0},          // Above U+10FFFF.
+            {"\xff", 0},                      // Never valid.
+            {"\xe2\x82", 0},                  // Truncated at the end.
+            {"\xe2\x82" "a", 0},              // Truncated before ASCII.
+            {"\xf0\x9f\x98\xe2\x82\xac", 0},  // Truncated before a lead byte.
+            {"\xc2\x80\x80", 2},              // Too long.
+    };
+
+    // Place each case at every offset within the blocks that SIMD checks, after both ASCII and
+    // multi-byte text, and before text that's valid.
+    for (const auto& c : kCases) {
+        for (pn::string_view prefix : {"a", "\xe2\x82\xac", "\xf0\x9f\x98\x80"}) {
+            for (int count : range(40)) {
+                pn::data data = repeat(prefix, count);
+                const int before = data.size();
+                data += pn::data_view{reinterpret_cast<const uint8_t*>(c.bytes.data()),
+                                      c.bytes.size()};
+                if (c.offset >= 0) {
+                    EXPECT_THAT(utf8::validate(data), Eq(before + c.offset));
+                } else {
+                    EXPECT_THAT(utf8::validate(data), Eq(data.size()));
+                }
+                data += repeat("b\xc3\xa9", 30);
+                const int expected = (c.offset >= 0) ? (before + c.offset) : data.size();
+                EXPECT_THAT(utf8::validate(data), Eq(expected));
+            }
+        }
+    }
+}
+
+// Tries every lead byte with every following byte, and a selection of bytes after that, across
+// the boundary between SIMD blocks.
+TEST_F(Utf8EncodingTest, ValidatePairs) {
+    const uint8_t kFollowing[] = {0x00, 0x7f, 0x80, 0x8f, 0x90, 0x9f, 0xa0, 0xbf, 0xc0, 0xff};
+    pn::data      data         = repeat("a", 64);
+    uint8_t*      seq          = data.data() + 30;
+    for (int lead : range(0x80, 0x100)) {
+        for (int second : range(0x100)) {
+            for (uint8_t third : kFollowing) {
+                for (uint8_t fourth : kFollowing) {
+                    seq[0] = lead;
+                    seq[1] = second;
+                    seq[2] = third;
+                    seq[3] = fourth;
+                    ASSERT_THAT(utf8::validate(data), Eq(reference_validate(data)))
+                            << lead << " " << second << " " << int(third) << " " << int(fourth);
+                }
+            }
+        }
+    }
+}
+
+// Text with code points of each length, in a pattern that doesn't line up with SIMD blocks.
+pn::string mixed_text(int runes) {
+    const char* const kRunes[] = {"a", "é", "b", "€", "c", "d", "\U0001f600"};
+    pn::string        text;
+    for (int i : range(runes)) {
+        text += kRunes[(i + (i / 7)) % 7];
+    }
+    return text;
+}
+
+TEST_F(Utf8EncodingTest, CountRunes) {
+    EXPECT_THAT(utf8::count_runes(""), Eq(0));
+    EXPECT_THAT(utf8::count_runes("aé€\U0001f600"), Eq(4));
+    for (int runes : {1, 15, 16, 17, 100, 1000, 100000}) {
+        EXPECT_THAT(utf8::count_runes(mixed_text(runes)), Eq(runes));
+    }
+}
+
+TEST_F(Utf8EncodingTest, RuneIndex) {
+    const int kInterval = utf8::kRuneIndexInterval;
+    for (int runes : {0, 1, 100, kInterval - 1, kInterval, (3 * kInterval) + 5}) {
+        const pn::string       text = mixed_text(runes);
+        const utf8::rune_index index(text);
+        ASSERT_THAT(index.size(), Eq(runes));
+        int n = 0;
+        for (auto it = text.begin(); it != text.end(); ++it, ++n) {
+            ASSERT_THAT(index.offset(n), Eq(it.offset())) << runes << " " << n;
+            ASSERT_THAT(index.at(n), Eq(*it)) << runes << " " << n;
+        }
+        EXPECT_THAT(index.offset(runes), Eq(text.size()));
+        EXPECT_THAT(index.substr(0, runes), Eq(pn::string_view{text}));
+        EXPECT_THROW(index.offset(-1), std::runtime_error);
+        EXPECT_THROW(index.offset(runes + 1), std::runtime_error);
+        EXPECT_THROW(index.at(runes), std::runtime_error);
+        EXPECT_THROW(index.substr(0, runes + 1), std::runtime_error);
+    }
+
+    const pn::string       text = mixed_text(10000);
+    const utf8::rune_index index(text);
+    EXPECT_THAT(
+            index.substr(4095, 4098),
+            Eq(pn::string_view{text}.substr(
+                    index.offset(4095), index.offset(4098) - index.offset(4095))));
+    EXPECT_THAT(utf8::count_runes(index.substr(4095, 4098)), Eq(3));
+    EXPECT_THAT(index.substr(9000, 9000), Eq(pn::string_view{""}));
+    EXPECT_THROW(index.substr(9000, 8999), std::runtime_error);
+}
+
+typedef Test Base64EncodingTest;
+
+// Bytes from a fixed sequence, so that every run tests the same input.
+pn::data pseudorandom_data(int size) {
+    pn::data data;
+    uint32_t state = 12345;
+    for (int i : range(size)) {
+        static_cast<void>(i);
+        state         = (state * 1103515245) + 12345;
+        const uint8_t byte = state >> 16;
+        data += pn::data_view{&byte, 1};
+    }
+    return data;
+}
+
+// The test vectors from RFC 4648.
+TEST_F(Base64EncodingTest, Vectors) {
+    const struct {
+        const char* data;
+        const char* base64;
+        const char* base64url;
+        const char* hex;
+    } kVectors[] = {
+            {"", "", "", ""},
+            {"f", "Zg==", "Zg", "66"},
+            {"fo", "Zm8=", "Zm8", "666f"},
+            {"foo", "Zm9v", "Zm9v", "666f6f"},
+            {"foob", "Zm9vYg==", "Zm9vYg", "666f6f62"},
+            {"fooba", "Zm9vYmE=", "Zm9vYmE", "666f6f6261"},
+            {"foobar", "Zm9vYmFy", "Zm9vYmFy", "666f6f626172"},
+    };
+    for (const auto& v : kVectors) {
+        EXPECT_THAT(base64::encode(bytes_of(v.data)), Eq(pn::string_view{v.base64}));
+        EXPECT_THAT(base64::decode(v.base64), Eq(bytes_of(v.data)));
+        EXPECT_THAT(base64::encoded_length(strlen(v.data)), Eq<int>(strlen(v.base64)));
+        EXPECT_THAT(base64::decoded_length(v.base64), Eq<int>(strlen(v.data)));
+        EXPECT_THAT(base64url::encode(bytes_of(v.data)), Eq(pn::string_view{v.base64url}));
+        EXPECT_THAT(base64url::decode(v.base64url), Eq(bytes_of(v.data)));
+        EXPECT_THAT(base64url::encoded_length(strlen(v.data)), Eq<int>(strlen(v.base64url)));
+        EXPECT_THAT(base64url::decoded_length(v.base64url), Eq<int>(strlen(v.data)));
+        EXPECT_THAT(hex::encode(bytes_of(v.data)), Eq(pn::string_view{v.hex}));
+        EXPECT_THAT(hex::decode(v.hex), Eq(bytes_of(v.data)));
+    }
+    EXPECT_THAT(base64::encode(bytes_of("\xfb\xff\xbf")), Eq(pn::string_view{"+/+/"}));
+    EXPECT_THAT(base64url::encode(bytes_of("\xfb\xff\xbf")), Eq(pn::string_view{"-_-_"}));
+}
+
+// Round-trips inputs long enough to go through the SIMD paths, at every length around the
+// boundaries of their blocks, and compares against the result of encoding a byte at a time.
+TEST_F(Base64EncodingTest, RoundTrip) {
+    const pn::data data = pseudorandom_data(1000);
+    for (int size : range(200)) {
+        const pn::data_view in{data.data() + (size % 7), size};
+        pn::string          expected;
+        for (int i = 0; i < size; i += 3) {
+            expected += base64::encode(pn::data_view{in.data() + i, std::min(3, size - i)});
+        }
+        const pn::string encoded = base64::encode(in);
+        ASSERT_THAT(encoded, Eq(pn::string_view{expected})) << size;
+        ASSERT_THAT(base64::decode(encoded), Eq(in)) << size;
+        ASSERT_THAT(base64url::decode(base64url::encode(in)), Eq(in)) << size;
+        ASSERT_THAT(hex::decode(hex::encode(in)), Eq(in)) << size;
+    }
+    const pn::string encoded = base64::encode(data);
+    EXPECT_THAT(base64::decode(encoded), Eq(pn::data_view{data}));
+    EXPECT_THAT(encoded.size(), Eq(base64::encoded_length(data.size())));
+}
+
+TEST_F(Base64EncodingTest, Invalid) {
+    EXPECT_THROW(base64::decode("Zg="), std::runtime_error);
+    EXPECT_THROW(base64::decode("Z==="), std::runtime_error);
+    EXPECT_THROW(base64::decode("Zg==Zg=="), std::runtime_error);
+    EXPECT_THROW(base64::decode("Zh=="), std::runtime_error);  // Leftover bits.
+    EXPECT_THROW(base64::decode("Zm9=Yg=="), std::runtime_error);
+    EXPECT_THROW(base64::decode("Zm9v\n"), std::runtime_error);
+    EXPECT_THROW(base64::decode("-_-_"), std::runtime_error);
+    EXPECT_THROW(base64url::decode("Zg=="), std::runtime_error);
+    EXPECT_THROW(base64url::decode("Zm9vY"), std::runtime_error);
+    EXPECT_THROW(base64url::decode("+/+/"), std::runtime_error);
+
+    // A bad character anywhere in a long input, including within a SIMD block.  A "=" at the end
+    // may be valid padding, depending on the bits before it.
+    const pn::string encoded = base64::encode(pseudorandom_data(300));
+    for (int i : range(encoded.size())) {
+        for (char ch : {'=', '-', '\0', '\x80', '\xff'}) {
+            if ((ch == '=') && (i == (encoded.size() - 1))) {
+                continue;
+            }
+            pn::string bad = encoded.copy();
+            bad.data()[i]  = ch;
+            try {
+                base64::decode(bad);
+                ADD_FAILURE() << i << " " << int(ch);
+            } catch (std::runtime_error& e) {
+                const pn::string expected = pn::format("invalid base64 at offset {0}", i);
+                ASSERT_THAT(pn::string_view{e.what()}, Eq(pn::string_view{expected}));
+            }
+        }
+    }
+}
+
+// Encodes and decodes into buffers of every small capacity, which should be filled with whole
+// groups, and never past their end.  The 100 bytes encode to 33 whole groups of 3, then a padded
+// group with the last byte.
+TEST_F(Base64EncodingTest, Into) {
+    const pn::data   data    = pseudorandom_data(100);
+    const pn::string encoded = base64::encode(data);
+    for (int capacity : range(1, 140)) {
+        uint8_t out[160];
+        memset(out, 0xaa, sizeof(out));
+        transcode_result r = base64::encode_into(data, out, capacity);
+        EXPECT_THAT(r.written, Eq(std::min(4 * (capacity / 4), 136)));
+        EXPECT_THAT(r.read, Eq(std::min(3 * (r.written / 4), 100)));
+        EXPECT_THAT(out[capacity], Eq(0xaa));
+        EXPECT_THAT(
+                pn::string_view(reinterpret_cast<char*>(out), r.written),
+                Eq(pn::string_view{encoded}.substr(0, r.written)));
+
+        memset(out, 0xaa, sizeof(out));
+        r = base64::decode_into(encoded, out, capacity);
+        EXPECT_THAT(r.written, Eq((capacity >= 100) ? 100 : (3 * (capacity / 3))));
+        EXPECT_THAT(r.read, Eq((capacity >= 100) ? 136 : (4 * (r.written / 3))));
+        EXPECT_THAT(out[capacity], Eq(0xaa));
+        EXPECT_THAT(pn::data_view(out, r.written), Eq(pn::data_view{data.data(), r.written}));
+
+        memset(out, 0xaa, sizeof(out));
+        r = hex::decode_into(hex::encode(data), out, capacity);
+        EXPECT_THAT(r.written, Eq(std::min(capacity, 100)));
+        EXPECT_THAT(out[capacity], Eq(0xaa));
+    }
+
+    // A capacity too large to double is still bounded by the input.
+    uint8_t          out[100];
+    transcode_result r = hex::decode_into(hex::encode(data), out, INT_MAX);
+    EXPECT_THAT(r.read, Eq(200));
+    EXPECT_THAT(r.written, Eq(100));
+    EXPECT_THAT(pn::data_view(out, r.written), Eq(pn::data_view{data}));
+}
+
+typedef Test HexEncodingTest;
+
+TEST_F(HexEncodingTest, Decode) {
+    EXPECT_THAT(hex::decode("0123456789ABCDEFabcdef"),
+                Eq(bytes_of("\x01\x23\x45\x67\x89\xab\xcd\xef\xab\xcd\xef")));
+    EXPECT_THAT(hex::decoded_length("00ff"), Eq(2));
+    EXPECT_THAT(hex::encoded_length(2), Eq(4));
+    EXPECT_THROW(hex::decode("abc"), std::runtime_error);
+
+    const pn::string encoded = hex::encode(pseudorandom_data(100));
+    for (int i : range(encoded.size())) {
+        for (char ch : {'g', 'G', '/', ':', '@', '`', ' ', '\x80', '\xe6'}) {
+            pn::string bad = encoded.copy();
+            bad.data()[i]  = ch;
+            try {
+                hex::decode(bad);
+                ADD_FAILURE() << i << " " << int(ch);
+            } catch (std::runtime_error& e) {
+                const pn::string expected = pn::format("invalid hex at offset {0}", i);
+                ASSERT_THAT(pn::string_view{e.what()}, Eq(pn::string_view{expected}));
+            }
+        }
+    }
+}
+
 }  // namespace
 }  // namespace sfz
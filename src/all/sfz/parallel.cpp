@@ -0,0 +1,49 @@
+// Copyright (c) 2026 The libsfz Authors
+//
+// This file is part of libsfz, a free software project.  You can redistribute it and/or modify it
+// under the terms of the MIT License.
+
+#include <sfz/parallel.hpp>
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace sfz {
+
+void parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn) {
+    size_t threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    threads        = std::min(threads, count / std::max<size_t>(grain, 1));
+    if (threads <= 1) {
+        if (count > 0) {
+            fn(0, count);
+        }
+        return;
+    }
+
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread>        workers;
+
+    auto run = [&](size_t i) {
+        try {
+            fn(count * i / threads, count * (i + 1) / threads);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    };
+    for (size_t i = 1; i < threads; ++i) {
+        workers.emplace_back(run, i);
+    }
+    run(0);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+}  // namespace sfz
@@ -0,0 +1,25 @@
+// Copyright (c) 2026 The libsfz Authors
+//
+// This file is part of libsfz, a free software project.  You can redistribute it and/or modify it
+// under the terms of the MIT License.
+
+#ifndef SFZ_PARALLEL_HPP_
+#define SFZ_PARALLEL_HPP_
+
+#include <stdlib.h>
+#include <functional>
+
+namespace sfz {
+
+// Splits the range [0, count) into contiguous pieces of at least `grain` elements, and calls
+// `fn(begin, end)` on each, using as many threads as the hardware supports.  Returns when all
+// pieces are done.  If any call throws, one of the exceptions is rethrown in the calling thread.
+//
+// @param [in] count    The number of elements to process.
+// @param [in] grain    The minimum number of elements worth handing to a thread.
+// @param [in] fn       Processes a half-open range of elements.
+void parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+}  // namespace sfz
+
+#endif  // SFZ_PARALLEL_HPP_
@@ -0,0 +1,70 @@
+// Copyright (c) 2026 The libsfz Authors
+//
+// This file is part of libsfz, a free software project.  You can redistribute it and/or modify it
+// under the terms of the MIT License.
+
+#ifndef SFZ_RELATIVE_PATH_HPP_
+#define SFZ_RELATIVE_PATH_HPP_
+
+#include <pn/string>
+#include <sfz/os.hpp>
+#include <stdexcept>
+
+namespace sfz {
+
+inline bool is_path_separator(char ch) {
+#ifdef _WIN32
+    return (ch == '/') || (ch == '\\');
+#else
+    return ch == '/';
+#endif
+}
+
+// Normalizes a path within a tree, dropping leading separators, and empty and "." components, and
+// resolving ".." components.  Components of the result are separated by "/".
+//
+// @returns             true if the path is within the tree; false if it escapes it.
+inline bool normalize_relative(pn::string_view path, pn::string* result) {
+    *result   = pn::string{};
+    int start = 0;
+    for (int i = 0; i <= path.size(); ++i) {
+        if ((i < path.size()) && !is_path_separator(path.data()[i])) {
+            continue;
+        }
+        pn::string_view component = path.substr(start, i - start);
+        start                     = i + 1;
+
+        if (component.empty() || (component == ".")) {
+            continue;
+        } else if (component == "..") {
+            if (result->empty()) {
+                return false;
+            }
+            int parent = pn::string_view{*result}.rfind(pn::rune{'/'});
+            *result    = (parent == pn::string_view::npos) ? pn::string{}
+                                                           : result->substr(0, parent).copy();
+            continue;
+        }
+        if (!result->empty()) {
+            *result += "/";
+        }
+        *result += component;
+    }
+    return true;
+}
+
+// Joins `relative` onto `root`, where `relative` comes from untrusted input, such as a delta or a
+// manifest.  Throws if `relative` is absolute, escapes `root`, or names `root` itself.
+inline pn::string join_within(pn::string_view root, pn::string_view relative) {
+    pn::string normalized;
+    if (relative.empty() || is_path_separator(relative.data()[0]) ||
+        !path::splitdrive(relative).first.empty() || !normalize_relative(relative, &normalized) ||
+        normalized.empty()) {
+        throw std::runtime_error(pn::format("path outside tree: {0}", relative).c_str());
+    }
+    return path::join(root, pn::string_view{normalized});
+}
+
+}  // namespace sfz
+
+#endif  // SFZ_RELATIVE_PATH_HPP_
@@ -0,0 +1,476 @@
+// Copyright (c) 2026 The libsfz Authors
+//
+// This file is part of libsfz, a free software project.  You can redistribute it and/or modify it
+// under the terms of the MIT License.
+
+#include <sfz/tar.hpp>
+
+#include <string.h>
+#include <algorithm>
+#include <sfz/file.hpp>
+#include <sfz/os.hpp>
+#include <sfz/relative-path.hpp>
+#include <sfz/walk-order.hpp>
+#include <stdexcept>
+
+namespace sfz {
+
+namespace {
+
+const int kBlockSize = 512;
+
+// Symlinks are followed at most this many times, as by Linux.
+const int kMaxLinks = 40;
+
+// Archives may be larger than a pn::data_view can represent, so they are read, and content is
+// passed to sha1::write(), in pieces of at most this size.
+const uint64_t kMaxPiece = 1 << 30;
+
+pn::data_view shift(pn::data_view data, int bytes) {
+    return pn::data_view{data.data() + bytes, data.size() - bytes};
+}
+
+pn::data_view as_bytes(pn::string_view s) {
+    return pn::data_view{reinterpret_cast<const uint8_t*>(s.data()), s.size()};
+}
+
+// Returns the string in a header field, which is NUL-terminated unless it fills the field.
+pn::string_view field(const uint8_t* header, int offset, int size) {
+    const char* p = reinterpret_cast<const char*>(header + offset);
+    int         n = 0;
+    while ((n < size) && p[n]) {
+        ++n;
+    }
+    return pn::string_view{p, n};
+}
+
+// Returns the value of a numeric header field.  Values are usually octal, but GNU tar writes
+// values which don't fit in octal as base-256, flagged by setting the high bit of the first byte.
+uint64_t number(const uint8_t* header, int offset, int size) {
+    const uint8_t* p     = header + offset;
+    uint64_t       value = 0;
+    if (p[0] & 0x80) {
+        if (p[0] != 0x80) {
+            throw std::runtime_error("tar: negative or oversized number");
+        }
+        for (int i = 1; i < size; ++i) {
+            value = (value << 8) | p[i];
+        }
+        return value;
+    }
+    int i = 0;
+    while ((i < size) && (p[i] == ' ')) {
+        ++i;
+    }
+    for (; (i < size) && ('0' <= p[i]) && (p[i] <= '7'); ++i) {
+        value = (value << 3) | (p[i] - '0');
+    }
+    return value;
+}
+
+// The checksum is the sum of the header's bytes, with the checksum field itself taken as spaces.
+// Some old implementations summed signed bytes, so accept that too.
+bool checksum_ok(const uint8_t* header) {
+    uint64_t expected     = number(header, 148, 8);
+    uint64_t unsigned_sum = 0;
+    int64_t  signed_sum   = 0;
+    for (int i = 0; i < kBlockSize; ++i) {
+        uint8_t byte = ((148 <= i) && (i < 156)) ? ' ' : header[i];
+        unsigned_sum += byte;
+        signed_sum += static_cast<int8_t>(byte);
+    }
+    return (expected == unsigned_sum) || (expected == static_cast<uint64_t>(signed_sum));
+}
+
+// Parses a decimal number in a pax header.  Returns false if `s` has anything but digits, or if
+// the number exceeds `limit`.
+bool parse_decimal(pn::string_view s, uint64_t limit, uint64_t* value) {
+    *value = 0;
+    for (int i = 0; i < s.size(); ++i) {
+        const char c = s.data()[i];
+        if ((c < '0') || ('9' < c)) {
+            return false;
+        }
+        const uint64_t digit = c - '0';
+        if (*value > ((limit - digit) / 10)) {
+            return false;
+        }
+        *value = (*value * 10) + digit;
+    }
+    return !s.empty();
+}
+
+// Hashes what tree_digest() does before a file's content.
+void hash_name(sha1& sha, pn::string_view path, uint64_t size) {
+    sha.write<uint64_t>(path.size());
+    sha.write(as_bytes(path));
+    sha.write<uint64_t>(size);
+}
+
+bool is_zero(const uint8_t* header) {
+    return (header[0] == 0) && (memcmp(header, header + 1, kBlockSize - 1) == 0);
+}
+
+pn::string normalize_entry(pn::string_view path) {
+    pn::string result;
+    if (!normalize_relative(path, &result)) {
+        throw std::runtime_error(pn::format("tar: path outside archive: {0}", path).c_str());
+    }
+    return result;
+}
+
+}  // namespace
+
+tar_digester::tar_digester()
+        : _state{STATE_HEADER},
+          _header_size{0},
+          _type{0},
+          _remaining{0},
+          _padding{0},
+          _offset{0},
+          _next_size{-1},
+          _hashing{false},
+          _archive{nullptr},
+          _spills{true},
+          _spill_size{0} {}
+
+tar_digester::tar_digester(const mapped_file& archive)
+        : _state{STATE_HEADER},
+          _header_size{0},
+          _type{0},
+          _remaining{0},
+          _padding{0},
+          _offset{0},
+          _next_size{-1},
+          _hashing{false},
+          _archive{&archive},
+          _spills{false},
+          _spill_size{0} {}
+
+tar_digester::~tar_digester() {}
+
+void tar_digester::spill(pn::data_view body) {
+    if (!_spill) {
+        _spill_dir.reset(new TemporaryDirectory("tar-digest"));
+        _spill.reset(new pn::output{path::join(_spill_dir->path(), "content"), pn::binary});
+    }
+    _spill->write(body).check();
+    _spill_size += body.size();
+}
+
+void tar_digester::write(pn::data_view input) {
+    while (!input.empty()) {
+        switch (_state) {
+            case STATE_HEADER: {
+                int size = std::min(kBlockSize - _header_size, input.size());
+                memcpy(_header + _header_size, input.data(), size);
+                _header_size += size;
+                _offset += size;
+                input = shift(input, size);
+                if (_header_size == kBlockSize) {
+                    _header_size = 0;
+                    parse_header();
+                }
+                break;
+            }
+
+            case STATE_BODY: {
+                int           size = std::min<uint64_t>(_remaining, input.size());
+                pn::data_view body{input.data(), size};
+                switch (_type) {
+                    case '0':
+                        if (_hashing) {
+                            _sha.write(body);
+                        }
+                        if (_spills) {
+                            spill(body);
+                        }
+                        break;
+                    case 'x':
+                    case 'L':
+                    case 'K': _meta += body; break;
+                }
+                _remaining -= size;
+                _offset += size;
+                input = shift(input, size);
+                if (_remaining == 0) {
+                    end_body();
+                }
+                break;
+            }
+
+            case STATE_PADDING: {
+                int size = std::min<uint64_t>(_remaining, input.size());
+                _remaining -= size;
+                _offset += size;
+                input = shift(input, size);
+                if (_remaining == 0) {
+                    _state = STATE_HEADER;
+                }
+                break;
+            }
+
+            case STATE_END: return;  // Ignore the rest of the end-of-archive marker.
+        }
+    }
+}
+
+void tar_digester::parse_header() {
+    if (is_zero(_header)) {
+        _state = STATE_END;
+        if (_spill) {
+            _spill.reset();
+            _spilled.reset(new mapped_file(path::join(_spill_dir->path(), "content")));
+        }
+        return;
+    } else if (!checksum_ok(_header)) {
+        throw std::runtime_error("tar: bad header checksum");
+    }
+
+    _type           = _header[156];
+    const bool meta = (_type == 'x') || (_type == 'g') || (_type == 'L') || (_type == 'K');
+    uint64_t   size = number(_header, 124, 12);
+
+    if (!meta) {
+        // POSIX ustar headers split long names between the name and prefix fields.  GNU headers
+        // use the space of the prefix field for other purposes.
+        pn::string name;
+        if (!_next_path.empty()) {
+            name = std::move(_next_path);
+        } else {
+            bool posix = (memcmp(_header + 257, "ustar\0", 6) == 0);
+            if (posix && _header[345]) {
+                name = field(_header, 345, 155).copy();
+                name += "/";
+            }
+            name += field(_header, 0, 100);
+        }
+        pn::string target =
+                !_next_target.empty() ? std::move(_next_target) : field(_header, 157, 100).copy();
+        if (_next_size >= 0) {
+            size = _next_size;
+        }
+        _next_path   = pn::string{};
+        _next_target = pn::string{};
+        _next_size   = -1;
+
+        // Old archives mark directories as regular files with a trailing slash.
+        if (((_type == '0') || (_type == '\0')) && !name.empty() &&
+            (name.data()[name.size() - 1] == '/')) {
+            _type = '5';
+        }
+
+        switch (_type) {
+            case '1':
+                _entries.push_back(entry{
+                        ENTRY_HARDLINK, normalize_entry(name), normalize_entry(target), 0, 0});
+                break;
+            case '2':
+                _entries.push_back(
+                        entry{ENTRY_SYMLINK, normalize_entry(name), std::move(target), 0, 0});
+                break;
+            case '5': break;  // Directories are implied by their contents.
+            case '3':
+            case '4':
+            case '6':
+                throw std::runtime_error(pn::format("Found non-regular file: {0}", name).c_str());
+            case 'D':
+            case 'M':
+            case 'S':
+                // GNU dumpdirs, multivolume continuations, and sparse files can't be hashed as
+                // they're stored.
+                throw std::runtime_error(
+                        pn::format("tar: unsupported entry: {0}", name).c_str());
+            default: {
+                // Regular files; unknown types should also be extracted as regular files.
+                _type = '0';
+                entry e{ENTRY_FILE, normalize_entry(name), {}, _spills ? _spill_size : _offset,
+                        size};
+
+                // Hash the file as it streams past if it follows every entry so far in walk
+                // order, and they were all hashed the same way.
+                _hashing = (_checkpoints.size() == _entries.size()) &&
+                           (_entries.empty() || walk_less(_entries.back().path, e.path));
+                if (_hashing) {
+                    hash_name(_sha, e.path, size);
+                }
+                _entries.push_back(std::move(e));
+                break;
+            }
+        }
+        if (!_entries.empty() && _entries.back().path.empty()) {
+            throw std::runtime_error("tar: entry for the root of the archive");
+        }
+    }
+
+    _remaining = size;
+    _padding   = (kBlockSize - (size % kBlockSize)) % kBlockSize;
+    _state     = STATE_BODY;
+    if (size == 0) {
+        end_body();
+    }
+}
+
+void tar_digester::end_body() {
+    if (_hashing) {
+        _hashing = false;
+        _checkpoints.push_back(_sha.save());
+    }
+    switch (_type) {
+        case 'x': {
+            // Records are "<length> <key>=<value>\n", where <length> includes the whole record.
+            pn::string_view records = pn::data_view{_meta}.as_string();
+            while (!records.empty()) {
+                int      space = records.find(pn::rune{' '});
+                uint64_t length;
+                if ((space == pn::string_view::npos) ||
+                    !parse_decimal(records.substr(0, space), records.size(), &length) ||
+                    (length < static_cast<uint64_t>(space + 2)) ||
+                    (records.data()[length - 1] != '\n')) {
+                    throw std::runtime_error("tar: bad pax header");
+                }
+                pn::string_view record = records.substr(space + 1, length - space - 2);
+                records                = records.substr(length);
+                int equals             = record.find(pn::rune{'='});
+                if (equals == pn::string_view::npos) {
+                    throw std::runtime_error("tar: bad pax header");
+                }
+                pn::string_view key   = record.substr(0, equals);
+                pn::string_view value = record.substr(equals + 1);
+                if (key == "path") {
+                    _next_path = value.copy();
+                } else if (key == "linkpath") {
+                    _next_target = value.copy();
+                } else if (key == "size") {
+                    uint64_t size;
+                    if (!parse_decimal(value, INT64_MAX, &size)) {
+                        throw std::runtime_error("tar: bad pax header");
+                    }
+                    _next_size = size;
+                }
+            }
+            break;
+        }
+        case 'L': _next_path = field(_meta.data(), 0, _meta.size()).copy(); break;
+        case 'K': _next_target = field(_meta.data(), 0, _meta.size()).copy(); break;
+    }
+    _meta      = pn::data{};
+    _remaining = _padding;
+    _state     = (_remaining > 0) ? STATE_PADDING : STATE_HEADER;
+}
+
+sha1::digest tar_digester::compute() const {
+    if (_state != STATE_END) {
+        throw std::runtime_error("tar: unexpected end of archive");
+    }
+
+    // Sort entries into walk order.  If an archive has several entries for a path, the last one
+    // wins, as it would when extracting.
+    std::vector<const entry*> sorted;
+    for (const entry& e : _entries) {
+        sorted.push_back(&e);
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const entry* a, const entry* b) {
+        return walk_less(a->path, b->path);
+    });
+    std::vector<const entry*> unique;
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        if ((i + 1 == sorted.size()) ||
+            (pn::string_view{sorted[i]->path} != sorted[i + 1]->path)) {
+            unique.push_back(sorted[i]);
+        }
+    }
+    auto lower_bound = [&unique](pn::string_view path) {
+        return std::lower_bound(
+                unique.begin(), unique.end(), path,
+                [](const entry* e, pn::string_view p) { return walk_less(e->path, p); });
+    };
+
+    // Follows links to the regular file that holds an entry's content, or returns nullptr if
+    // the entry is a broken symlink.
+    auto resolve = [&unique, &lower_bound](const entry* e) -> const entry* {
+        for (int i = 0; i < kMaxLinks; ++i) {
+            pn::string target;
+            switch (e->type) {
+                case ENTRY_FILE: return e;
+                case ENTRY_HARDLINK: target = e->target.copy(); break;
+                case ENTRY_SYMLINK: {
+                    pn::string_view link     = e->target;
+                    int             dir      = pn::string_view{e->path}.rfind(pn::rune{'/'});
+                    bool            absolute = link.empty() || (link.data()[0] == '/');
+                    pn::string      joined;
+                    if (!absolute && (dir != pn::string_view::npos)) {
+                        joined = e->path.substr(0, dir + 1).copy();
+                    }
+                    joined += link;
+                    if (absolute || !normalize_relative(joined, &target)) {
+                        throw std::runtime_error(
+                                pn::format("tar: symlink outside archive: {0}", e->path).c_str());
+                    }
+                    break;
+                }
+            }
+
+            auto it = lower_bound(target);
+            if ((it != unique.end()) && ((*it)->path == target)) {
+                e = *it;
+                continue;
+            } else if (e->type == ENTRY_HARDLINK) {
+                throw std::runtime_error(
+                        pn::format("tar: hard link to missing file: {0}", e->path).c_str());
+            }
+
+            // Anything under `target` would follow it directly in walk order.
+            pn::string dir = target.copy();
+            dir += "/";
+            it = lower_bound(dir);
+            if ((it != unique.end()) && ((*it)->path.substr(0, dir.size()) == dir)) {
+                throw std::runtime_error(
+                        pn::format("tar: symlink to directory: {0}", e->path).c_str());
+            }
+            return nullptr;
+        }
+        throw std::runtime_error("tar: too many levels of symbolic links");
+    };
+
+    // Hash as tree_digest() does.  Files which were hashed as they streamed past needn't be
+    // hashed again, as long as they still come first in walk order.
+    size_t streamed = 0;
+    while ((streamed < _checkpoints.size()) && (unique[streamed] == &_entries[streamed])) {
+        ++streamed;
+    }
+    sha1 sha;
+    if (streamed > 0) {
+        sha.restore(_checkpoints[streamed - 1]);
+    }
+    for (size_t i = streamed; i < unique.size(); ++i) {
+        const entry* file = resolve(unique[i]);
+        if (file) {
+            hash(sha, *unique[i], *file);
+        }
+    }
+    return sha.compute();
+}
+
+void tar_digester::hash(sha1& sha, const entry& e, const entry& file) const {
+    hash_name(sha, e.path, file.size);
+    const mapped_file* content = _spilled ? _spilled.get() : _archive;
+    for (uint64_t offset = 0; offset < file.size;) {
+        uint64_t size = std::min(file.size - offset, kMaxPiece);
+        sha.write(content->data(file.offset + offset, static_cast<int>(size)));
+        offset += size;
+    }
+}
+
+sha1::digest tar_digest(pn::string_view path) {
+    mapped_file  file(path);
+    tar_digester digester(file);
+    for (uint64_t offset = 0; offset < file.size();) {
+        uint64_t size = std::min(file.size() - offset, kMaxPiece);
+        digester.write(file.data(offset, static_cast<int>(size)));
+        offset += size;
+    }
+    return digester.compute();
+}
+
+}  // namespace sfz
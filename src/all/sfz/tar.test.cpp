@@ -0,0 +1,290 @@
+// Copyright (c) 2026 The libsfz Authors
+//
+// This file is part of libsfz, a free software project.  You can redistribute it and/or modify it
+// under the terms of the MIT License.
+
+#include <sfz/tar.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
+#include <pn/output>
+#include <sfz/os.hpp>
+#include <sfz/range.hpp>
+#include <stdexcept>
+
+using testing::Eq;
+using testing::NotNull;
+
+namespace sfz {
+namespace {
+
+using TarTest = ::testing::Test;
+
+pn::data_view bytes(pn::string_view s) {
+    return pn::data_view{reinterpret_cast<const uint8_t*>(s.data()), s.size()};
+}
+
+// Builds an archive in memory.
+class archive {
+  public:
+    void file(pn::string_view name, pn::string_view content) {
+        header(name, '0', content.size(), "", "ustar\0" "00");
+        body(bytes(content));
+    }
+    void dir(pn::string_view name) { header(name, '5', 0, "", "ustar\0" "00"); }
+    void symlink(pn::string_view name, pn::string_view target) {
+        header(name, '2', 0, target, "ustar\0" "00");
+    }
+    void hardlink(pn::string_view name, pn::string_view target) {
+        header(name, '1', 0, target, "ustar\0" "00");
+    }
+
+    // An entry with any type and content.
+    void entry(pn::string_view name, char type, pn::string_view content) {
+        header(name, type, content.size(), "", "ustar\0" "00");
+        body(bytes(content));
+    }
+
+    // A name too long for the header, given in a pax extended header.
+    void pax_file(pn::string_view name, pn::string_view content) {
+        // The length of the record includes the digits of the length itself.
+        pn::string record = pn::format(" path={0}\n", name);
+        int        length = record.size() + 1;
+        while (pn::format("{0}", length).size() + record.size() != length) {
+            ++length;
+        }
+        record = pn::format("{0}{1}", length, record);
+        header("PaxHeaders/x", 'x', record.size(), "", "ustar\0" "00");
+        body(bytes(record));
+        file("truncated", content);
+    }
+
+    // A name too long for the header, given in a GNU long name entry.  GNU headers have a
+    // different magic number, and no prefix field.
+    void gnu_file(pn::string_view name, pn::string_view content) {
+        pn::string long_name = name.copy();
+        long_name += pn::rune{0};
+        header("././@LongLink", 'L', long_name.size(), "", "ustar  ");
+        body(bytes(long_name));
+        header("truncated", '0', content.size(), "", "ustar  ");
+        body(bytes(content));
+    }
+
+    pn::data finish() {
+        uint8_t zeroes[1024] = {};
+        _data += pn::data_view{zeroes, sizeof(zeroes)};
+        return std::move(_data);
+    }
+
+  private:
+    void header(
+            pn::string_view name, char type, int size, pn::string_view target, const char* magic) {
+        uint8_t h[512] = {};
+        memcpy(h, name.data(), std::min(name.size(), 100));
+        snprintf(reinterpret_cast<char*>(h + 100), 8, "%07o", 0644);
+        snprintf(reinterpret_cast<char*>(h + 124), 12, "%011o", size);
+        memset(h + 148, ' ', 8);
+        h[156] = type;
+        memcpy(h + 157, target.data(), std::min(target.size(), 100));
+        memcpy(h + 257, magic, 8);
+        int sum = 0;
+        for (uint8_t byte : h) {
+            sum += byte;
+        }
+        snprintf(reinterpret_cast<char*>(h + 148), 8, "%06o", sum);
+        _data += pn::data_view{h, sizeof(h)};
+    }
+
+    void body(pn::data_view data) {
+        _data += data;
+        uint8_t zeroes[512] = {};
+        _data += pn::data_view{zeroes, (512 - (data.size() % 512)) % 512};
+    }
+
+    pn::data _data;
+};
+
+void write_file(pn::string_view path, pn::string_view content) {
+    makedirs(path::dirname(path), 0700);
+    pn::output out{path, pn::binary};
+    ASSERT_THAT(out.c_obj(), NotNull());
+    ASSERT_THAT(out.write(bytes(content)), Eq(true));
+}
+
+sha1::digest digest(pn::data_view data, int chunk) {
+    tar_digester digester;
+    for (int i = 0; i < data.size(); i += chunk) {
+        digester.write(pn::data_view{data.data() + i, std::min(chunk, data.size() - i)});
+    }
+    return digester.compute();
+}
+
+#ifndef _WIN32
+// An archive, in no particular order, should have the same digest as its extracted tree.
+TEST_F(TarTest, Tree) {
+    pn::string long_name{"long/"};
+    for (int i : range(150)) {
+        static_cast<void>(i);
+        long_name += "n";
+    }
+
+    archive a;
+    a.dir("./");
+    a.file("./b/y", "two\n");
+    a.file("./a-c", "one\n");
+    a.dir("./a/");
+    a.file("./a/b", "three\n");
+    a.file("./zero", "");
+    a.file("./big", std::string(3000, 'z').c_str());
+    a.hardlink("./hard", "./big");
+    a.symlink("./lnk", "b/y");
+    a.symlink("./b/up", "../a-c");
+    a.symlink("./broken", "nowhere");
+    a.pax_file(pn::format("./{0}/pax", long_name), "pax\n");
+    a.gnu_file(pn::format("./{0}/gnu", long_name), "gnu\n");
+    a.file("./replaced", "old\n");
+    a.file("./replaced", "new\n");
+    a.dir("./empty/");
+    pn::data tar = a.finish();
+
+    TemporaryDirectory dir("tar-test");
+    write_file(path::join(dir.path(), "b/y"), "two\n");
+    write_file(path::join(dir.path(), "a-c"), "one\n");
+    write_file(path::join(dir.path(), "a/b"), "three\n");
+    write_file(path::join(dir.path(), "zero"), "");
+    write_file(path::join(dir.path(), "big"), std::string(3000, 'z').c_str());
+    write_file(path::join(dir.path(), "hard"), std::string(3000, 'z').c_str());
+    sfz::symlink("b/y", path::join(dir.path(), "lnk"));
+    sfz::symlink("../a-c", path::join(dir.path(), "b/up"));
+    sfz::symlink("nowhere", path::join(dir.path(), "broken"));
+    write_file(path::join(dir.path(), pn::string_view{long_name}, "pax"), "pax\n");
+    write_file(path::join(dir.path(), pn::string_view{long_name}, "gnu"), "gnu\n");
+    write_file(path::join(dir.path(), "replaced"), "new\n");
+    makedirs(path::join(dir.path(), "empty"), 0700);
+
+    const sha1::digest expected = tree_digest(dir.path());
+    for (int chunk : {1, 7, 512, 4096, 1 << 20}) {
+        EXPECT_THAT(digest(tar, chunk), Eq(expected)) << chunk;
+    }
+
+    pn::string path = path::join(dir.path(), "archive.tar");
+    pn::output{path, pn::binary}.write(tar).check();
+    EXPECT_THAT(tar_digest(path), Eq(expected));
+}
+#endif
+
+// Files hashed as they stream past must give the same digest as files hashed at the end, however
+// later entries reorder, replace, or link to them.
+TEST_F(TarTest, Order) {
+    sha1 expected;
+    for (pn::string_view name : {"a", "b/d", "b-c", "c"}) {
+        expected.write<uint64_t>(name.size());
+        expected.write(bytes(name));
+        expected.write<uint64_t>(name.size());
+        expected.write(bytes(name));
+    }
+    const sha1::digest digest_of_tree = expected.compute();
+
+    archive sorted;
+    for (pn::string_view name : {"a", "b/d", "b-c", "c"}) {
+        sorted.file(name, name);
+    }
+    EXPECT_THAT(digest(sorted.finish(), 7), Eq(digest_of_tree));
+
+    archive unsorted;
+    for (pn::string_view name : {"a", "b-c", "c", "b/d"}) {
+        unsorted.file(name, name);
+    }
+    EXPECT_THAT(digest(unsorted.finish(), 7), Eq(digest_of_tree));
+
+    archive replaced;
+    for (pn::string_view name : {"a", "b/d", "b-c", "c"}) {
+        replaced.file(name, (name == "b-c") ? "old" : name);
+    }
+    replaced.file("b-c", "b-c");
+    EXPECT_THAT(digest(replaced.finish(), 7), Eq(digest_of_tree));
+
+    archive linked;
+    linked.file("a", "a");
+    linked.file("b-c", "b-c");
+    linked.file("c", "c");
+    linked.file("d", "b/d");
+    linked.hardlink("b/d", "d");
+    sha1 with_link;
+    for (pn::string_view name : {"a", "b/d", "b-c", "c", "d"}) {
+        pn::string_view content = (name == "d") ? "b/d" : name;
+        with_link.write<uint64_t>(name.size());
+        with_link.write(bytes(name));
+        with_link.write<uint64_t>(content.size());
+        with_link.write(bytes(content));
+    }
+    EXPECT_THAT(digest(linked.finish(), 7), Eq(with_link.compute()));
+}
+
+TEST_F(TarTest, Empty) {
+    archive a;
+    EXPECT_THAT(digest(a.finish(), 512), Eq(sha1{}.compute()));
+
+    // Empty files, and links to them, have no content to hash.
+    archive b;
+    b.file("zero", "");
+    b.hardlink("hard", "zero");
+    sha1 expected;
+    for (pn::string_view name : {"hard", "zero"}) {
+        expected.write<uint64_t>(name.size());
+        expected.write(bytes(name));
+        expected.write<uint64_t>(0);
+    }
+    EXPECT_THAT(digest(b.finish(), 512), Eq(expected.compute()));
+}
+
+TEST_F(TarTest, Invalid) {
+    {
+        archive a;
+        a.file("file", "content");
+        pn::data tar = a.finish();
+        EXPECT_THROW(digest(pn::data_view{tar.data(), 700}, 512), std::runtime_error);
+        tar.data()[0] ^= 1;
+        EXPECT_THROW(digest(tar, 512), std::runtime_error);
+    }
+    {
+        archive a;
+        a.file("../escape", "content");
+        EXPECT_THROW(digest(a.finish(), 512), std::runtime_error);
+    }
+    {
+        archive a;
+        a.file("dir/file", "content");
+        a.symlink("link", "dir");
+        EXPECT_THROW(digest(a.finish(), 512), std::runtime_error);
+    }
+    {
+        archive a;
+        a.symlink("link", "/etc/passwd");
+        EXPECT_THROW(digest(a.finish(), 512), std::runtime_error);
+    }
+    {
+        archive a;
+        a.symlink("a", "b");
+        a.symlink("b", "a");
+        EXPECT_THROW(digest(a.finish(), 512), std::runtime_error);
+    }
+    for (char type : {'D', 'M', 'S'}) {
+        archive a;
+        a.entry("file", type, "content");
+        EXPECT_THROW(digest(a.finish(), 512), std::runtime_error) << type;
+    }
+    for (pn::string_view record : {"x path=a\n", "13 path=a\n", "99 path=a\n",
+                                   "99999999999999999999999 path=a\n", "10 path=ab\n",
+                                   "10 size=x\n"}) {
+        archive a;
+        a.entry("PaxHeaders/x", 'x', record);
+        a.file("file", "content");
+        EXPECT_THROW(digest(a.finish(), 512), std::runtime_error) << record;
+    }
+}
+
+}  // namespace
+}  // namespace sfz
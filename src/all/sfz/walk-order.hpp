@@ -0,0 +1,47 @@
+// Copyright (c) 2026 The libsfz Authors
+//
+// This file is part of libsfz, a free software project.  You can redistribute it and/or modify it
+// under the terms of the MIT License.
+
+#ifndef SFZ_WALK_ORDER_HPP_
+#define SFZ_WALK_ORDER_HPP_
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <pn/string>
+#include <sfz/relative-path.hpp>
+
+namespace sfz {
+
+// Returns the end of the path component of `path` that starts at `begin`.
+inline int component_end(pn::string_view path, int begin) {
+    while ((begin < path.size()) && !is_path_separator(path.data()[begin])) {
+        ++begin;
+    }
+    return begin;
+}
+
+// Orders paths as walk() visits files: siblings by name, bytewise, and each directory's contents
+// in place of the directory.  Paths are compared a component at a time, so that the order is the
+// same whichever separators the platform uses.
+inline bool walk_less(pn::string_view a, pn::string_view b) {
+    int i = 0, j = 0;
+    while ((i < a.size()) && (j < b.size())) {
+        const int a_size = component_end(a, i) - i;
+        const int b_size = component_end(b, j) - j;
+        const int c      = memcmp(a.data() + i, b.data() + j, std::min(a_size, b_size));
+        if (c != 0) {
+            return c < 0;
+        } else if (a_size != b_size) {
+            return a_size < b_size;
+        }
+        i += a_size + 1;
+        j += b_size + 1;
+    }
+    return (i >= a.size()) && (j < b.size());
+}
+
+}  // namespace sfz
+
+#endif  // SFZ_WALK_ORDER_HPP_
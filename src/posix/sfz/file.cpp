@@ -26,13 +26,54 @@ mapped_file::mapped_file(pn::string_view path) : _path(path.copy()), _fd(_path)
         throw std::runtime_error(pn::format("{0}: {1}", path, posix_strerror(EISDIR)).c_str());
     }
     _size = st.st_size;
+    if (_size == 0) {
+        // mmap(2) rejects empty mappings, and there would be nothing to map anyway.
+        _data = NULL;
+        return;
+    }
     _data = reinterpret_cast<uint8_t*>(mmap(NULL, _size, PROT_READ, MAP_PRIVATE, _fd.no, 0));
     if (_data == MAP_FAILED) {
         throw std::runtime_error(pn::format("{0}: {1}", path, posix_strerror()).c_str());
     }
 }
 
-mapped_file::~mapped_file() { munmap(_data, _size); }
+mapped_file::~mapped_file() {
+    if (_data) {
+        munmap(_data, _size);
+    }
+}
+
+std::vector<mapped_file::extent> mapped_file::data_extents() const {
+    std::vector<extent> extents;
+#ifdef SEEK_DATA
+    off_t end = _size;
+    for (off_t offset = 0; offset < end;) {
+        off_t data = lseek(_fd.no, offset, SEEK_DATA);
+        if (data < 0) {
+            if (errno == ENXIO) {
+                break;  // Only a hole remains.
+            }
+            // The filesystem doesn't support SEEK_DATA.
+            return {{0, _size}};
+        }
+        if (data >= end) {
+            break;  // The file grew after it was mapped.
+        }
+        off_t hole = lseek(_fd.no, data, SEEK_HOLE);
+        if (hole < 0) {
+            return {{0, _size}};
+        }
+        hole = (hole < end) ? hole : end;
+        extents.push_back({static_cast<uint64_t>(data), static_cast<uint64_t>(hole - data)});
+        offset = hole;
+    }
+#else
+    if (_size > 0) {
+        extents.push_back({0, _size});
+    }
+#endif
+    return extents;
+}
 
 mapped_file::fd::fd(const pn::string& path) : no{::open(path.c_str(), O_RDONLY)} {
     if (no < 0) {
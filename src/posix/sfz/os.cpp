@@ -6,16 +6,27 @@
 #include <sfz/os.hpp>
 
 #include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <fts.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <sys/param.h>
 #include <unistd.h>
 #include <pn/output>
 #include <sfz/encoding.hpp>
 #include <sfz/error.hpp>
 #include <stdexcept>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+#ifdef __APPLE__
+#include <sys/clonefile.h>
+#endif
 
 namespace sfz {
 
@@ -126,6 +137,21 @@ void symlink(pn::string_view content, pn::string_view container) {
     }
 }
 
+pn::string readlink(pn::string_view path) {
+    pn::string        path_copy = path.copy();
+    std::vector<char> buffer(256);
+    while (true) {
+        ssize_t size = ::readlink(path_copy.c_str(), buffer.data(), buffer.size());
+        if (size < 0) {
+            throw std::runtime_error(
+                    pn::format("readlink: {0}: {1}", path, posix_strerror()).c_str());
+        } else if (static_cast<size_t>(size) < buffer.size()) {
+            return pn::string_view{buffer.data(), static_cast<int>(size)}.copy();
+        }
+        buffer.resize(buffer.size() * 2);  // May have been truncated.
+    }
+}
+
 void mkdir(pn::string_view path, mode_t mode) {
     if (::mkdir(path.copy().c_str(), mode) != 0) {
         throw std::runtime_error(pn::format("mkdir: {0}: {1}", path, posix_strerror()).c_str());
@@ -157,6 +183,77 @@ void rmdir(pn::string_view path) {
     }
 }
 
+void link(pn::string_view existing, pn::string_view path) {
+    if (::link(existing.copy().c_str(), path.copy().c_str()) < 0) {
+        throw std::runtime_error(pn::format("link: {0}: {1}", path, posix_strerror()).c_str());
+    }
+}
+
+void rename(pn::string_view from, pn::string_view to) {
+    if (::rename(from.copy().c_str(), to.copy().c_str()) < 0) {
+        throw std::runtime_error(pn::format("rename: {0}: {1}", from, posix_strerror()).c_str());
+    }
+}
+
+namespace {
+
+// Errors indicating that cloning isn't possible here, rather than that something went wrong.
+bool clone_unsupported(int error) {
+    switch (error) {
+        case EINVAL:
+        case ENOSYS:
+        case ENOTSUP:
+        case ENOTTY:
+        case EXDEV: return true;
+        default: return false;
+    }
+}
+
+}  // namespace
+
+bool clonefile(pn::string_view from, pn::string_view to) {
+#if defined(__APPLE__)
+    if (::clonefile(from.copy().c_str(), to.copy().c_str(), 0) < 0) {
+        if (clone_unsupported(errno)) {
+            return false;
+        }
+        throw std::runtime_error(
+                pn::format("clonefile: {0}: {1}", to, posix_strerror()).c_str());
+    }
+    return true;
+#elif defined(__linux__) && defined(FICLONE)
+    int src = ::open(from.copy().c_str(), O_RDONLY);
+    if (src < 0) {
+        throw std::runtime_error(
+                pn::format("clonefile: {0}: {1}", from, posix_strerror()).c_str());
+    }
+    int dst = ::open(to.copy().c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (dst < 0) {
+        int error = errno;
+        close(src);
+        throw std::runtime_error(
+                pn::format("clonefile: {0}: {1}", to, posix_strerror(error)).c_str());
+    }
+    int result = ioctl(dst, FICLONE, src);
+    int error  = errno;
+    close(src);
+    close(dst);
+    if (result < 0) {
+        unlink(to);
+        if (clone_unsupported(error)) {
+            return false;
+        }
+        throw std::runtime_error(
+                pn::format("clonefile: {0}: {1}", to, posix_strerror(error)).c_str());
+    }
+    return true;
+#else
+    static_cast<void>(from);
+    static_cast<void>(to);
+    return false;
+#endif
+}
+
 void rmtree(pn::string_view path) {
     if (path::exists(path)) {
         class RmtreeVisitor : public TreeWalker {
@@ -11,6 +11,7 @@
 #include <fcntl.h>
 #include <memoryapi.h>
 #include <stdio.h>
+#include <winioctl.h>
 #include <pn/output>
 #include <sfz/error.hpp>
 #include <stdexcept>
@@ -31,8 +32,15 @@ mapped_file::mapped_file(pn::string_view path)
                                _path.cpp_wstr().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
                                OPEN_EXISTING, 0, nullptr)},
           _size{file_size(_path, _file.h)},
-          _file_mapping{_path, CreateFileMappingW(_file.h, NULL, PAGE_READONLY, 0, _size, NULL)},
-          _view_of_file{_path, MapViewOfFile(_file_mapping.h, FILE_MAP_READ, 0, 0, _size)} {}
+          // Empty files can't be mapped, and there would be nothing to map anyway.
+          _file_mapping{
+                  _path, (_size > 0)
+                                 ? CreateFileMappingW(_file.h, NULL, PAGE_READONLY, 0, _size, NULL)
+                                 : NULL},
+          _view_of_file{
+                  _path, (_size > 0) ? MapViewOfFile(_file_mapping.h, FILE_MAP_READ, 0, 0, _size)
+                                     : NULL,
+                  _size} {}
 
 mapped_file::~mapped_file() {}
 
@@ -41,6 +49,45 @@ pn::data_view mapped_file::data() const {
             reinterpret_cast<const uint8_t*>(_view_of_file.ptr), static_cast<int>(_size)};
 }
 
+pn::data_view mapped_file::data(uint64_t offset, int size) const {
+    return pn::data_view{reinterpret_cast<const uint8_t*>(_view_of_file.ptr) + offset, size};
+}
+
+std::vector<mapped_file::extent> mapped_file::data_extents() const {
+    std::vector<extent>         extents;
+    FILE_ALLOCATED_RANGE_BUFFER query;
+    FILE_ALLOCATED_RANGE_BUFFER ranges[64];
+    query.FileOffset.QuadPart = 0;
+    query.Length.QuadPart     = _size;
+    while (query.Length.QuadPart > 0) {
+        DWORD bytes;
+        BOOL  done = DeviceIoControl(
+                _file.h, FSCTL_QUERY_ALLOCATED_RANGES, &query, sizeof(query), ranges,
+                sizeof(ranges), &bytes, NULL);
+        if (!done && (GetLastError() != ERROR_MORE_DATA)) {
+            // The filesystem doesn't support sparse files.
+            return {{0, static_cast<uint64_t>(_size)}};
+        }
+        DWORD count = bytes / sizeof(ranges[0]);
+        for (DWORD i = 0; i < count; ++i) {
+            LONGLONG begin = ranges[i].FileOffset.QuadPart;
+            LONGLONG end   = begin + ranges[i].Length.QuadPart;
+            end            = (end < _size) ? end : _size;
+            if (begin < end) {
+                extents.push_back(
+                        {static_cast<uint64_t>(begin), static_cast<uint64_t>(end - begin)});
+            }
+        }
+        if (done || (count == 0)) {
+            break;
+        }
+        const FILE_ALLOCATED_RANGE_BUFFER& last = ranges[count - 1];
+        query.FileOffset.QuadPart = last.FileOffset.QuadPart + last.Length.QuadPart;
+        query.Length.QuadPart     = _size - query.FileOffset.QuadPart;
+    }
+    return extents;
+}
+
 mapped_file::handle::handle(pn::string_view path, HANDLE handle) : h{handle} {
     if (h == INVALID_HANDLE_VALUE) {
         throw std::runtime_error(pn::format("{0}: {1}", path, win_strerror()).c_str());
@@ -53,8 +100,8 @@ mapped_file::handle::~handle() {
     }
 }
 
-mapped_file::view_of_file::view_of_file(pn::string_view path, LPVOID p) : ptr{p} {
-    if (ptr == NULL) {
+mapped_file::view_of_file::view_of_file(pn::string_view path, LPVOID p, LONGLONG size) : ptr{p} {
+    if ((ptr == NULL) && (size > 0)) {
         throw std::runtime_error(pn::format("{0}: {1}", path, win_strerror()).c_str());
     }
 }
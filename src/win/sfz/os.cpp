@@ -216,6 +216,10 @@ void symlink(pn::string_view content, pn::string_view container) {
     }
 }
 
+pn::string readlink(pn::string_view path) {
+    throw std::runtime_error(pn::format("readlink: {0}: not supported", path).c_str());
+}
+
 void mkdir(pn::string_view path, mkdir_mode_t mode) {
     static_cast<void>(mode);
     if (!CreateDirectoryW(path.cpp_wstr().c_str(), nullptr)) {
@@ -247,6 +251,25 @@ void rmdir(pn::string_view path) {
     }
 }
 
+void link(pn::string_view existing, pn::string_view path) {
+    if (!CreateHardLinkW(path.cpp_wstr().c_str(), existing.cpp_wstr().c_str(), nullptr)) {
+        throw std::runtime_error(pn::format("link: {0}: {1}", path, win_strerror()).c_str());
+    }
+}
+
+void rename(pn::string_view from, pn::string_view to) {
+    if (!MoveFileExW(
+                from.cpp_wstr().c_str(), to.cpp_wstr().c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        throw std::runtime_error(pn::format("rename: {0}: {1}", from, win_strerror()).c_str());
+    }
+}
+
+bool clonefile(pn::string_view from, pn::string_view to) {
+    static_cast<void>(from);
+    static_cast<void>(to);
+    return false;
+}
+
 void rmtree(pn::string_view path) {
     if (path::exists(path)) {
         class RmtreeVisitor : public TreeWalker {